@@ -1,4 +1,12 @@
 mkdir out
-cl /Feout\basics.exe /Foout\ /DUNICODE /D_UNICODE src/basics.c src/GetMsgName.c
+cl /Feout\basics.exe /Foout\ /DUNICODE /D_UNICODE src/basics.c src/FramePacer.c src/GetMsgName.c src/HandlerProfile.c src/HitTest.c src/MpscQueue.c src/MsgFormat.c src/MsgNameCache.c src/MsgSequence.c src/PointerBatch.c src/Region.c src/SessionStats.c src/StartupProfile.c src/TaskScheduler.c src/TextBuffer.c src/TextEditor.c src/TimerWheel.c src/TraceFile.c src/TraceRing.c src/Workload.c
+@if %errorlevel% neq 0 (exit /b %errorlevel%)
+@rem the scenarios with the debug CRT, its allocation hook counts the allocations
+mkdir out\scenarios
+cl /Feout\scenarios.exe /Foout\scenarios\ /MTd /DUNICODE /D_UNICODE /DSCENARIOS=1 src/basics.c src/FramePacer.c src/GetMsgName.c src/HandlerProfile.c src/HitTest.c src/MpscQueue.c src/MsgFormat.c src/MsgNameCache.c src/MsgSequence.c src/PointerBatch.c src/Region.c src/SessionStats.c src/StartupProfile.c src/TaskScheduler.c src/TextBuffer.c src/TextEditor.c src/TimerWheel.c src/TraceFile.c src/TraceRing.c src/Workload.c
+@if %errorlevel% neq 0 (exit /b %errorlevel%)
+cl /Feout\monitor.exe /Foout\ src/monitor.c src/GetMsgName.c src/TraceRing.c
+@if %errorlevel% neq 0 (exit /b %errorlevel%)
+cl /Feout\tracediff.exe /Foout\ src/tracediff.c src/GetMsgName.c src/MsgFormat.c src/TraceDiff.c src/TraceFile.c
 @if %errorlevel% neq 0 (exit /b %errorlevel%)
 out\basics.exe
@@ -0,0 +1,5 @@
+mkdir -p out
+cc -O2 -pthread -o out/bench src/bench.c src/FramePacer.c src/GetMsgName.c src/HandlerProfile.c src/HitTest.c src/MpscQueue.c src/MsgFormat.c src/MsgNameCache.c src/MsgSequence.c src/PointerBatch.c src/Region.c src/SessionStats.c src/StartupProfile.c src/TaskScheduler.c src/TextBuffer.c src/TextEditor.c src/TimerWheel.c src/TraceDiff.c src/TraceFile.c src/TraceRing.c src/Workload.c || exit $?
+cc -O2 -o out/monitor src/monitor.c src/GetMsgName.c src/TraceRing.c || exit $?
+cc -O2 -o out/tracediff src/tracediff.c src/GetMsgName.c src/MsgFormat.c src/TraceDiff.c src/TraceFile.c || exit $?
+out/bench
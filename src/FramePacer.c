@@ -0,0 +1,50 @@
+#include <string.h>
+
+#include "FramePacer.h"
+
+void FramePacerInit(FramePacer* pacer, uint64_t interval_ns, uint64_t now_ns)
+{
+    memset(pacer, 0, sizeof(*pacer));
+    pacer->interval_ns = interval_ns;
+    pacer->deadline_ns = now_ns + interval_ns;
+    pacer->phase = FRAME_PHASE_DISPATCH;
+    pacer->phase_start_ns = now_ns;
+}
+
+void FramePacerEnterPhase(FramePacer* pacer, FramePhase phase, uint64_t now_ns)
+{
+    pacer->phase_ns[pacer->phase] += now_ns - pacer->phase_start_ns;
+    pacer->phase = phase;
+    pacer->phase_start_ns = now_ns;
+}
+
+bool FramePacerFrameDue(FramePacer* pacer, uint64_t now_ns, uint64_t* budget_ns)
+{
+    if (now_ns < pacer->deadline_ns) return false;
+
+    // If dispatch or a previous frame held us up past one or more whole
+    // intervals those ticks are dropped rather than run back to back,
+    // the next deadline stays aligned to the original schedule.
+    const uint64_t late = now_ns - pacer->deadline_ns;
+    const uint64_t skipped = late / pacer->interval_ns;
+    pacer->missed_deadlines += skipped;
+    pacer->deadline_ns += (skipped + 1) * pacer->interval_ns;
+
+    pacer->frame_start_ns = now_ns;
+    pacer->frame_budget_ns = pacer->deadline_ns - now_ns;
+    *budget_ns = pacer->frame_budget_ns;
+    return true;
+}
+
+void FramePacerFrameDone(FramePacer* pacer, uint64_t now_ns)
+{
+    pacer->frame_count++;
+    if (now_ns - pacer->frame_start_ns > pacer->frame_budget_ns) {
+        pacer->overruns++;
+    }
+}
+
+uint64_t FramePacerTimeout(const FramePacer* pacer, uint64_t now_ns)
+{
+    return (now_ns < pacer->deadline_ns) ? pacer->deadline_ns - now_ns : 0;
+}
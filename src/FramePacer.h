@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Decides when a frame-paced message loop should run its frame callback
+// and how long it may wait for messages.  All times are passed in by the
+// caller so the pacing doesn't depend on the platform's clock or pump.
+//
+// A loop iteration looks like:
+//
+//     FramePacerEnterPhase(&pacer, FRAME_PHASE_DISPATCH, now());
+//     ...dispatch pending messages until FramePacerTimeout(&pacer, now()) is 0...
+//     uint64_t budget_ns;
+//     if (FramePacerFrameDue(&pacer, now(), &budget_ns)) {
+//         FramePacerEnterPhase(&pacer, FRAME_PHASE_IDLE, now());
+//         ...frame/idle work, bounded by budget_ns...
+//         FramePacerFrameDone(&pacer, now());
+//     }
+//     FramePacerEnterPhase(&pacer, FRAME_PHASE_WAIT, now());
+//     ...wait for messages up to FramePacerTimeout(&pacer, now())...
+
+typedef enum {
+    FRAME_PHASE_DISPATCH,
+    FRAME_PHASE_IDLE,
+    FRAME_PHASE_WAIT,
+    FRAME_PHASE_COUNT,
+} FramePhase;
+
+typedef struct {
+    uint64_t interval_ns;
+    uint64_t deadline_ns; // when the next frame is due
+    uint64_t frame_start_ns;
+    uint64_t frame_budget_ns;
+
+    FramePhase phase;
+    uint64_t phase_start_ns;
+
+    // instrumentation
+    uint64_t frame_count;
+    uint64_t missed_deadlines; // frame ticks skipped because we fell behind
+    uint64_t overruns; // frames that ran past their budget
+    uint64_t phase_ns[FRAME_PHASE_COUNT];
+} FramePacer;
+
+void FramePacerInit(FramePacer*, uint64_t interval_ns, uint64_t now_ns);
+// Adds the time since the last phase change to the current phase
+void FramePacerEnterPhase(FramePacer*, FramePhase, uint64_t now_ns);
+// Returns true if a frame is due, budget_ns is the time left until the
+// following deadline
+bool FramePacerFrameDue(FramePacer*, uint64_t now_ns, uint64_t* budget_ns);
+void FramePacerFrameDone(FramePacer*, uint64_t now_ns);
+// How long the loop can wait for messages before the next frame is due
+uint64_t FramePacerTimeout(const FramePacer*, uint64_t now_ns);
@@ -0,0 +1,241 @@
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "HandlerProfile.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+// Messages below this (WM_USER) get a slot each, the first OTHER_SLOTS
+// messages above it too and the rest share the last slot
+#define DIRECT_SLOTS 0x400
+#define OTHER_SLOTS 64
+#define CALIBRATION_ROUNDS 1000
+
+typedef struct {
+    uint32_t msg;
+    uint64_t calls;
+    uint64_t counters[HANDLER_COUNTER_COUNT];
+} HandlerCost;
+
+struct HandlerProfile {
+    int fds[HANDLER_COUNTER_COUNT]; // fds[0] leads the perf group, -1 without
+    uint32_t counter_count;
+    uint64_t overhead[HANDLER_COUNTER_COUNT];
+    HandlerSample* current;
+    HandlerCost direct[DIRECT_SLOTS];
+    HandlerCost other[OTHER_SLOTS + 1];
+    uint32_t other_count;
+};
+
+static uint64_t read_tsc(void)
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+#ifdef __linux__
+static int open_counter(uint64_t config, int group)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    // only the handler's own code, that's also what an unprivileged
+    // process is allowed to count
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+static void open_counters(HandlerProfile* profile)
+{
+    static const uint64_t configs[HANDLER_COUNTER_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+    };
+    for (uint32_t i = 0; i < HANDLER_COUNTER_COUNT; i++) {
+        profile->fds[i] = open_counter(configs[i], i ? profile->fds[0] : -1);
+        if (profile->fds[i] >= 0) continue;
+        // all or nothing, a partial group would mix counted and missing columns
+        for (uint32_t j = 0; j < i; j++) close(profile->fds[j]);
+        for (uint32_t j = 0; j < HANDLER_COUNTER_COUNT; j++) profile->fds[j] = -1;
+        return;
+    }
+    profile->counter_count = HANDLER_COUNTER_COUNT;
+}
+
+static void close_counters(HandlerProfile* profile)
+{
+    for (uint32_t i = 0; i < HANDLER_COUNTER_COUNT; i++) {
+        if (profile->fds[i] >= 0) close(profile->fds[i]);
+    }
+}
+#else
+static void open_counters(HandlerProfile* profile) { (void)profile; }
+static void close_counters(HandlerProfile* profile) { (void)profile; }
+#endif
+
+static void read_counters(const HandlerProfile* profile, uint64_t* out)
+{
+#ifdef __linux__
+    if (profile->counter_count > 1) {
+        // one read for the whole group: the count, then each value
+        uint64_t values[1 + HANDLER_COUNTER_COUNT];
+        if (read(profile->fds[0], values, sizeof(values)) != (ssize_t)sizeof(values)) abort();
+        memcpy(out, values + 1, HANDLER_COUNTER_COUNT * sizeof(uint64_t));
+        return;
+    }
+#endif
+    (void)profile;
+    out[HANDLER_CYCLES] = read_tsc();
+}
+
+static HandlerCost* cost_of(HandlerProfile* profile, uint32_t msg)
+{
+    if (msg < DIRECT_SLOTS) return &profile->direct[msg];
+    for (uint32_t i = 0; i < profile->other_count; i++) {
+        if (profile->other[i].msg == msg) return &profile->other[i];
+    }
+    if (profile->other_count == OTHER_SLOTS) return &profile->other[OTHER_SLOTS];
+    HandlerCost* cost = &profile->other[profile->other_count++];
+    cost->msg = msg;
+    return cost;
+}
+
+HandlerProfile* HandlerProfileCreate(void)
+{
+    HandlerProfile* profile = calloc(1, sizeof(HandlerProfile));
+    if (!profile) abort();
+    for (uint32_t i = 0; i < HANDLER_COUNTER_COUNT; i++) profile->fds[i] = -1;
+    profile->counter_count = 1;
+    open_counters(profile);
+    for (uint32_t i = 0; i < DIRECT_SLOTS; i++) profile->direct[i].msg = i;
+    profile->other[OTHER_SLOTS].msg = UINT32_MAX;
+
+    // the cheapest of many empty samples is what reading costs
+    for (uint32_t i = 0; i < HANDLER_COUNTER_COUNT; i++) profile->overhead[i] = UINT64_MAX;
+    for (uint32_t round = 0; round < CALIBRATION_ROUNDS; round++) {
+        uint64_t start[HANDLER_COUNTER_COUNT], end[HANDLER_COUNTER_COUNT];
+        read_counters(profile, start);
+        read_counters(profile, end);
+        for (uint32_t i = 0; i < profile->counter_count; i++) {
+            if (end[i] - start[i] < profile->overhead[i]) profile->overhead[i] = end[i] - start[i];
+        }
+    }
+    return profile;
+}
+
+void HandlerProfileDestroy(HandlerProfile* profile)
+{
+    if (!profile) return;
+    close_counters(profile);
+    free(profile);
+}
+
+uint32_t HandlerProfileCounterCount(const HandlerProfile* profile)
+{
+    return profile->counter_count;
+}
+
+void HandlerProfileBegin(HandlerProfile* profile, HandlerSample* sample)
+{
+    sample->parent = profile->current;
+    profile->current = sample;
+    memset(sample->children, 0, sizeof(sample->children));
+    read_counters(profile, sample->start);
+}
+
+void HandlerProfileEnd(HandlerProfile* profile, HandlerSample* sample, uint32_t msg)
+{
+    uint64_t end[HANDLER_COUNTER_COUNT];
+    read_counters(profile, end);
+    HandlerCost* cost = cost_of(profile, msg);
+    cost->calls++;
+    for (uint32_t i = 0; i < profile->counter_count; i++) {
+        const uint64_t total = end[i] - sample->start[i];
+        // counters can be a little off at these lengths, clamp instead of
+        // wrapping around
+        const uint64_t spent = sample->children[i] + profile->overhead[i];
+        if (total > spent) cost->counters[i] += total - spent;
+        if (sample->parent) sample->parent->children[i] += total;
+    }
+    profile->current = sample->parent;
+}
+
+static int compare_cycles(const void* a, const void* b)
+{
+    const uint64_t x = (*(const HandlerCost* const*)a)->counters[HANDLER_CYCLES];
+    const uint64_t y = (*(const HandlerCost* const*)b)->counters[HANDLER_CYCLES];
+    return (x < y) - (x > y);
+}
+
+static void append(char* out, size_t size, size_t* len, const char* fmt, ...)
+{
+    // once out is full vsnprintf only counts
+    char* at = (*len < size) ? out + *len : NULL;
+    va_list args;
+    va_start(args, fmt);
+    const int n = vsnprintf(at, at ? size - *len : 0, fmt, args);
+    va_end(args);
+    if (n > 0) *len += (size_t)n;
+}
+
+size_t HandlerProfileReport(const HandlerProfile* profile, const char* (*name)(uint32_t msg), char* out, size_t size)
+{
+    const HandlerCost* costs[DIRECT_SLOTS + OTHER_SLOTS + 1];
+    uint32_t count = 0;
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < DIRECT_SLOTS; i++) {
+        if (profile->direct[i].calls) costs[count++] = &profile->direct[i];
+    }
+    for (uint32_t i = 0; i <= OTHER_SLOTS; i++) {
+        if (profile->other[i].calls) costs[count++] = &profile->other[i];
+    }
+    for (uint32_t i = 0; i < count; i++) total += costs[i]->counters[HANDLER_CYCLES];
+    qsort(costs, count, sizeof(costs[0]), compare_cycles);
+
+    size_t len = 0;
+    if (size) out[0] = 0;
+    const bool perf = (profile->counter_count == HANDLER_COUNTER_COUNT);
+    append(out, size, &len, "%-28s %10s %7s %12s", "message", "calls", "share", perf ? "cycles/call" : "ticks/call");
+    if (perf) append(out, size, &len, " %6s %12s %12s", "IPC", "cache-miss", "branch-miss");
+    for (uint32_t i = 0; i < count; i++) {
+        const HandlerCost* cost = costs[i];
+        const double calls = (double)cost->calls;
+        const uint64_t cycles = cost->counters[HANDLER_CYCLES];
+        append(out, size, &len, "\n%-28s %10llu %6.1f%% %12.0f",
+            (cost->msg == UINT32_MAX) ? "(other)" : name(cost->msg), (unsigned long long)cost->calls,
+            total ? 100.0 * cycles / total : 0.0, cycles / calls);
+        if (perf) {
+            append(out, size, &len, " %6.2f %12.2f %12.2f",
+                cycles ? (double)cost->counters[HANDLER_INSTRUCTIONS] / cycles : 0.0,
+                cost->counters[HANDLER_CACHE_MISSES] / calls, cost->counters[HANDLER_BRANCH_MISSES] / calls);
+        }
+    }
+    return len;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Per message CPU cost of the window procedure.  On Linux every handler
+// is bracketed with hardware counters read through perf_event_open, so a
+// slow handler shows whether it's cache misses, mispredicted branches or
+// just a lot of instructions.  Where the counters can't be opened (Windows,
+// containers, perf_event_paranoid) only cycles are counted, with rdtsc.
+//
+// Costs are exclusive: a message sent from inside another handler is
+// charged to its own message, not the outer one.  The cost of reading the
+// counters is measured once and subtracted from every sample.
+typedef enum {
+    HANDLER_CYCLES,
+    HANDLER_INSTRUCTIONS,
+    HANDLER_CACHE_MISSES,
+    HANDLER_BRANCH_MISSES,
+    HANDLER_COUNTER_COUNT,
+} HandlerCounter;
+
+// One per handler call in progress, on the caller's stack
+typedef struct HandlerSample {
+    struct HandlerSample* parent;
+    uint64_t start[HANDLER_COUNTER_COUNT];
+    uint64_t children[HANDLER_COUNTER_COUNT]; // spent in nested handlers
+} HandlerSample;
+
+typedef struct HandlerProfile HandlerProfile;
+
+HandlerProfile* HandlerProfileCreate(void);
+void HandlerProfileDestroy(HandlerProfile*);
+// The number of counters read, HANDLER_COUNTER_COUNT or 1 for the rdtsc
+// fallback (then HANDLER_CYCLES counts TSC ticks)
+uint32_t HandlerProfileCounterCount(const HandlerProfile*);
+void HandlerProfileBegin(HandlerProfile*, HandlerSample*);
+void HandlerProfileEnd(HandlerProfile*, HandlerSample*, uint32_t msg);
+// A table of every message handled, most cycles first.  name returns a
+// message's name, like GetMsgName.  Returns the length written, like
+// snprintf.
+size_t HandlerProfileReport(const HandlerProfile*, const char* (*name)(uint32_t msg), char* out, size_t size);
@@ -0,0 +1,147 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "HitTest.h"
+
+static void* xrealloc(void* ptr, size_t size)
+{
+    void* result = realloc(ptr, size);
+    if (!result) abort();
+    return result;
+}
+
+void HitTestInit(HitTestGrid* grid)
+{
+    memset(grid, 0, sizeof(*grid));
+}
+
+void HitTestFree(HitTestGrid* grid)
+{
+    free(grid->regions);
+    free(grid->resolved);
+    free(grid->cell_start);
+    free(grid->cell_items);
+    memset(grid, 0, sizeof(*grid));
+}
+
+void HitTestAddRegion(HitTestGrid* grid, const HitRegion* region)
+{
+    if (grid->region_count == grid->region_capacity) {
+        grid->region_capacity = grid->region_capacity ? grid->region_capacity * 2 : 16;
+        grid->regions = xrealloc(grid->regions, grid->region_capacity * sizeof(grid->regions[0]));
+        grid->resolved = xrealloc(grid->resolved, grid->region_capacity * sizeof(grid->resolved[0]));
+    }
+    grid->regions[grid->region_count] = *region;
+    grid->region_count += 1;
+    grid->dirty = true;
+}
+
+void HitTestClear(HitTestGrid* grid)
+{
+    grid->region_count = 0;
+    grid->dirty = true;
+}
+
+void HitTestResize(HitTestGrid* grid, int32_t width, int32_t height)
+{
+    if (width == grid->width && height == grid->height) return;
+    grid->width = width;
+    grid->height = height;
+    grid->dirty = true;
+}
+
+static int32_t clamp(int32_t value, int32_t min, int32_t max)
+{
+    if (value < min) return min;
+    if (value > max) return max;
+    return value;
+}
+
+static void resolve(const HitTestGrid* grid, const HitRegion* region, HitRect* out)
+{
+    out->left = (region->anchor & HIT_ANCHOR_LEFT_FAR) ? grid->width + region->left : region->left;
+    out->top = (region->anchor & HIT_ANCHOR_TOP_FAR) ? grid->height + region->top : region->top;
+    out->right = (region->anchor & HIT_ANCHOR_RIGHT_FAR) ? grid->width + region->right : region->right;
+    out->bottom = (region->anchor & HIT_ANCHOR_BOTTOM_FAR) ? grid->height + region->bottom : region->bottom;
+    out->left = clamp(out->left, 0, grid->width);
+    out->top = clamp(out->top, 0, grid->height);
+    out->right = clamp(out->right, 0, grid->width);
+    out->bottom = clamp(out->bottom, 0, grid->height);
+}
+
+// Returns false if the rect is empty and overlaps no cells
+static bool cell_range(const HitRect* rect, uint32_t* col0, uint32_t* row0, uint32_t* col1, uint32_t* row1)
+{
+    if (rect->left >= rect->right || rect->top >= rect->bottom) return false;
+    *col0 = (uint32_t)rect->left >> HIT_TEST_CELL_SHIFT;
+    *row0 = (uint32_t)rect->top >> HIT_TEST_CELL_SHIFT;
+    *col1 = (uint32_t)(rect->right - 1) >> HIT_TEST_CELL_SHIFT;
+    *row1 = (uint32_t)(rect->bottom - 1) >> HIT_TEST_CELL_SHIFT;
+    return true;
+}
+
+static void rebuild(HitTestGrid* grid)
+{
+    grid->dirty = false;
+    const uint32_t cell_size = 1 << HIT_TEST_CELL_SHIFT;
+    grid->cols = (grid->width > 0) ? ((uint32_t)grid->width + cell_size - 1) >> HIT_TEST_CELL_SHIFT : 0;
+    grid->rows = (grid->height > 0) ? ((uint32_t)grid->height + cell_size - 1) >> HIT_TEST_CELL_SHIFT : 0;
+    const uint32_t cell_count = grid->cols * grid->rows;
+    grid->cell_start = xrealloc(grid->cell_start, (cell_count + 1) * sizeof(uint32_t));
+    memset(grid->cell_start, 0, (cell_count + 1) * sizeof(uint32_t));
+
+    // first pass counts the regions per cell (offset by one so the prefix
+    // sum below leaves cell_start[i] at the start of cell i)
+    for (uint32_t i = 0; i < grid->region_count; i++) {
+        HitRect* rect = &grid->resolved[i];
+        resolve(grid, &grid->regions[i], rect);
+        uint32_t col0, row0, col1, row1;
+        if (!cell_range(rect, &col0, &row0, &col1, &row1)) continue;
+        for (uint32_t row = row0; row <= row1; row++) {
+            for (uint32_t col = col0; col <= col1; col++) {
+                grid->cell_start[row * grid->cols + col + 1]++;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < cell_count; i++) {
+        grid->cell_start[i + 1] += grid->cell_start[i];
+    }
+    const uint32_t item_count = grid->cell_start[cell_count];
+    if (item_count > grid->cell_items_capacity) {
+        grid->cell_items_capacity = item_count;
+        grid->cell_items = xrealloc(grid->cell_items, item_count * sizeof(uint32_t));
+    }
+
+    // second pass fills the cells, cell_start[i] is used as the write
+    // cursor for cell i and ends up at the start of cell i+1
+    for (uint32_t i = 0; i < grid->region_count; i++) {
+        uint32_t col0, row0, col1, row1;
+        if (!cell_range(&grid->resolved[i], &col0, &row0, &col1, &row1)) continue;
+        for (uint32_t row = row0; row <= row1; row++) {
+            for (uint32_t col = col0; col <= col1; col++) {
+                grid->cell_items[grid->cell_start[row * grid->cols + col]++] = i;
+            }
+        }
+    }
+    memmove(grid->cell_start + 1, grid->cell_start, cell_count * sizeof(uint32_t));
+    grid->cell_start[0] = 0;
+}
+
+bool HitTestLookup(HitTestGrid* grid, int32_t x, int32_t y, int32_t* code)
+{
+    if (grid->dirty) rebuild(grid);
+    if (x < 0 || y < 0 || x >= grid->width || y >= grid->height) return false;
+
+    const uint32_t cell = ((uint32_t)y >> HIT_TEST_CELL_SHIFT) * grid->cols + ((uint32_t)x >> HIT_TEST_CELL_SHIFT);
+    const uint32_t start = grid->cell_start[cell];
+    // later regions win, so scan the cell backwards
+    for (uint32_t i = grid->cell_start[cell + 1]; i > start; i--) {
+        const uint32_t index = grid->cell_items[i - 1];
+        const HitRect* rect = &grid->resolved[index];
+        if (x >= rect->left && x < rect->right && y >= rect->top && y < rect->bottom) {
+            *code = grid->regions[index].code;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Each edge of a region is either an offset from the window's left/top
+// (the default) or, with the matching HIT_ANCHOR_* flag, an offset from
+// the window's right/bottom.  This lets caption buttons and resize grips
+// follow the window edges without re-registering them on every resize.
+#define HIT_ANCHOR_LEFT_FAR   0x1
+#define HIT_ANCHOR_TOP_FAR    0x2
+#define HIT_ANCHOR_RIGHT_FAR  0x4
+#define HIT_ANCHOR_BOTTOM_FAR 0x8
+
+// Grid cells are (1 << HIT_TEST_CELL_SHIFT) pixels square
+#define HIT_TEST_CELL_SHIFT 4
+
+typedef struct {
+    int32_t left, top, right, bottom;
+    uint32_t anchor;
+    int32_t code; // an HT* value, returned from WM_NCHITTEST
+} HitRegion;
+
+typedef struct {
+    int32_t left, top, right, bottom;
+} HitRect;
+
+typedef struct {
+    HitRegion* regions;
+    HitRect* resolved; // regions in window coordinates for the current size
+    uint32_t region_count;
+    uint32_t region_capacity;
+
+    // window size the grid was last built for
+    int32_t width, height;
+    bool dirty;
+
+    // The grid is stored as a compressed row: the regions overlapping
+    // cell i are cell_items[cell_start[i] .. cell_start[i+1]], in
+    // registration order.
+    uint32_t cols, rows;
+    uint32_t* cell_start;
+    uint32_t* cell_items;
+    uint32_t cell_items_capacity;
+} HitTestGrid;
+
+void HitTestInit(HitTestGrid*);
+void HitTestFree(HitTestGrid*);
+// Regions added later take priority over earlier regions they overlap.
+void HitTestAddRegion(HitTestGrid*, const HitRegion*);
+void HitTestClear(HitTestGrid*);
+// Call when the window size changes, the grid is rebuilt lazily on the
+// next lookup and only if the size actually changed.
+void HitTestResize(HitTestGrid*, int32_t width, int32_t height);
+// x/y are relative to the window's top-left corner.  Returns false if no
+// region contains the point.
+bool HitTestLookup(HitTestGrid*, int32_t x, int32_t y, int32_t* code);
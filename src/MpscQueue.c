@@ -0,0 +1,69 @@
+#include <stddef.h>
+
+#include "MpscQueue.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+// the Interlocked intrinsics are full barriers
+static MpscNode* load(MpscNode* volatile* target)
+{
+    return *target;
+}
+static MpscNode* compare_exchange(MpscNode* volatile* target, MpscNode* expected, MpscNode* desired)
+{
+    return (MpscNode*)_InterlockedCompareExchangePointer((void* volatile*)target, desired, expected);
+}
+static MpscNode* exchange(MpscNode* volatile* target, MpscNode* value)
+{
+    return (MpscNode*)_InterlockedExchangePointer((void* volatile*)target, value);
+}
+#else
+// Release on push publishes the node's contents, acquire on take makes
+// them visible to the consumer.  A failed CAS doesn't dereference the
+// head it read so it can be relaxed.
+static MpscNode* load(MpscNode* volatile* target)
+{
+    return __atomic_load_n(target, __ATOMIC_RELAXED);
+}
+static MpscNode* compare_exchange(MpscNode* volatile* target, MpscNode* expected, MpscNode* desired)
+{
+    __atomic_compare_exchange_n(target, &expected, desired, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+    return expected;
+}
+static MpscNode* exchange(MpscNode* volatile* target, MpscNode* value)
+{
+    return __atomic_exchange_n(target, value, __ATOMIC_ACQUIRE);
+}
+#endif
+
+void MpscQueueInit(MpscQueue* queue)
+{
+    queue->head = NULL;
+}
+
+bool MpscQueuePush(MpscQueue* queue, MpscNode* node)
+{
+    // A stale read is fine, the CAS hands back the real head on failure.
+    // Nodes are only ever removed all at once so there's no ABA problem.
+    MpscNode* head = load(&queue->head);
+    while (true) {
+        node->next = head;
+        MpscNode* previous = compare_exchange(&queue->head, head, node);
+        if (previous == head) return head == NULL;
+        head = previous;
+    }
+}
+
+MpscNode* MpscQueueTakeAll(MpscQueue* queue)
+{
+    MpscNode* node = exchange(&queue->head, NULL);
+    // the list is newest first, reverse it
+    MpscNode* reversed = NULL;
+    while (node) {
+        MpscNode* next = node->next;
+        node->next = reversed;
+        reversed = node;
+        node = next;
+    }
+    return reversed;
+}
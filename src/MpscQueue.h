@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Lock-free multi-producer/single-consumer queue.  Nodes are intrusive,
+// embed an MpscNode in the item and recover the item from the node.
+//
+// Producers push with a CAS, the consumer takes the whole queue at once
+// with a single exchange.  A push that finds the queue empty returns
+// true, that producer (and only that one) must wake the consumer, so
+// there is exactly one wakeup per batch the consumer drains.
+typedef struct MpscNode {
+    struct MpscNode* next;
+} MpscNode;
+
+typedef struct {
+    MpscNode* volatile head; // most recently pushed node
+    // keep the contended head on its own cache line
+    char pad[64 - sizeof(MpscNode*)];
+} MpscQueue;
+
+void MpscQueueInit(MpscQueue*);
+// Safe to call from any thread.  Returns true if the queue was empty and
+// the consumer needs a wakeup.
+bool MpscQueuePush(MpscQueue*, MpscNode*);
+// Consumer only.  Takes every queued node and returns them oldest first
+// (per producer), or NULL if the queue is empty.
+MpscNode* MpscQueueTakeAll(MpscQueue*);
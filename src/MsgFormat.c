@@ -0,0 +1,312 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "MsgFormat.h"
+
+// The values from the Windows headers
+#define WS_TABSTOP      0x00010000
+#define WS_MINIMIZEBOX  0x00020000
+#define WS_SIZEBOX      0x00040000
+#define WS_SYSMENU      0x00080000
+#define WS_HSCROLL      0x00100000
+#define WS_VSCROLL      0x00200000
+#define WS_DLGFRAME     0x00400000
+#define WS_BORDER       0x00800000
+#define WS_MAXIMIZE     0x01000000
+#define WS_CLIPCHILDREN 0x02000000
+#define WS_CLIPSIBLINGS 0x04000000
+#define WS_DISABLED     0x08000000
+#define WS_VISIBLE      0x10000000
+#define WS_MINIMIZE     0x20000000
+#define WS_CHILD        0x40000000
+#define WS_POPUP        0x80000000
+
+#define WS_EX_DLGMODALFRAME       0x00000001
+#define WS_EX_NOPARENTNOTIFY      0x00000004
+#define WS_EX_TOPMOST             0x00000008
+#define WS_EX_ACCEPTFILES         0x00000010
+#define WS_EX_TRANSPARENT         0x00000020
+#define WS_EX_MDICHILD            0x00000040
+#define WS_EX_TOOLWINDOW          0x00000080
+#define WS_EX_WINDOWEDGE          0x00000100
+#define WS_EX_CLIENTEDGE          0x00000200
+#define WS_EX_CONTEXTHELP         0x00000400
+#define WS_EX_RIGHT               0x00001000
+#define WS_EX_RTLREADING          0x00002000
+#define WS_EX_LEFTSCROLLBAR       0x00004000
+#define WS_EX_CONTROLPARENT       0x00010000
+#define WS_EX_STATICEDGE          0x00020000
+#define WS_EX_APPWINDOW           0x00040000
+#define WS_EX_LAYERED             0x00080000
+#define WS_EX_NOINHERITLAYOUT     0x00100000
+#define WS_EX_NOREDIRECTIONBITMAP 0x00200000
+#define WS_EX_LAYOUTRTL           0x00400000
+#define WS_EX_COMPOSITED          0x02000000
+#define WS_EX_NOACTIVATE          0x08000000
+
+#define SWP_NOSIZE         0x0001
+#define SWP_NOMOVE         0x0002
+#define SWP_NOZORDER       0x0004
+#define SWP_NOREDRAW       0x0008
+#define SWP_NOACTIVATE     0x0010
+#define SWP_FRAMECHANGED   0x0020
+#define SWP_SHOWWINDOW     0x0040
+#define SWP_HIDEWINDOW     0x0080
+#define SWP_NOCOPYBITS     0x0100
+#define SWP_NOOWNERZORDER  0x0200
+#define SWP_NOSENDCHANGING 0x0400
+#define SWP_DEFERERASE     0x2000
+#define SWP_ASYNCWINDOWPOS 0x4000
+
+#define SW_PARENTCLOSING 1
+#define SW_OTHERZOOM     2
+#define SW_PARENTOPENING 3
+#define SW_OTHERUNZOOM   4
+
+#define IMN_CLOSESTATUSWINDOW    0x0001
+#define IMN_OPENSTATUSWINDOW     0x0002
+#define IMN_CHANGECANDIDATE      0x0003
+#define IMN_CLOSECANDIDATE       0x0004
+#define IMN_OPENCANDIDATE        0x0005
+#define IMN_SETCONVERSIONMODE    0x0006
+#define IMN_SETSENTENCEMODE      0x0007
+#define IMN_SETOPENSTATUS        0x0008
+#define IMN_SETCANDIDATEPOS      0x0009
+#define IMN_SETCOMPOSITIONFONT   0x000A
+#define IMN_SETCOMPOSITIONWINDOW 0x000B
+#define IMN_GUIDELINE            0x000D
+#define IMN_PRIVATE              0x000E
+
+#define SIZE_RESTORED  0
+#define SIZE_MINIMIZED 1
+#define SIZE_MAXIMIZED 2
+#define SIZE_MAXSHOW   3
+#define SIZE_MAXHIDE   4
+
+#define HTERROR       (-2)
+#define HTNOWHERE     0
+#define HTCLIENT      1
+#define HTCAPTION     2
+#define HTSYSMENU     3
+#define HTGROWBOX     4
+#define HTMENU        5
+#define HTHSCROLL     6
+#define HTVSCROLL     7
+#define HTMINBUTTON   8
+#define HTMAXBUTTON   9
+#define HTLEFT        10
+#define HTRIGHT       11
+#define HTTOP         12
+#define HTTOPLEFT     13
+#define HTTOPRIGHT    14
+#define HTBOTTOM      15
+#define HTBOTTOMLEFT  16
+#define HTBOTTOMRIGHT 17
+#define HTBORDER      18
+#define HTCLOSE       20
+#define HTHELP        21
+
+
+
+static void append_str(char* s, size_t* offset, const char sep, const char* append_str)
+{
+    const size_t append_len = strlen(append_str);
+    if (*offset > 0) {
+        s[*offset] = sep;
+        *offset += 1;
+    }
+    memcpy(s + *offset, append_str, append_len);
+    *offset += append_len;
+}
+static bool consume_flag(uint32_t* flags, uint32_t flag)
+{
+    if (*flags & flag) {
+        *flags &= ~flag;
+        return true;
+    }
+    return false;
+}
+
+
+size_t FormatWndStyle(char* out, uint32_t style)
+{
+    uint32_t remaining = style;
+    size_t offset = 0;
+    if (consume_flag(&remaining, WS_TABSTOP)) append_str(out, &offset, ',', "TABSTOP");
+    if (consume_flag(&remaining, WS_MINIMIZEBOX)) append_str(out, &offset, ',', "MINBOX");
+    if (consume_flag(&remaining, WS_SIZEBOX)) append_str(out, &offset, ',', "SIZEBOX");
+    if (consume_flag(&remaining, WS_SYSMENU)) append_str(out, &offset, ',', "SYSMENU");
+    if (consume_flag(&remaining, WS_HSCROLL)) append_str(out, &offset, ',', "HSCROLL");
+    if (consume_flag(&remaining, WS_VSCROLL)) append_str(out, &offset, ',', "VSCROLL");
+    if (consume_flag(&remaining, WS_DLGFRAME)) append_str(out, &offset, ',', "DLGFRAME");
+    if (consume_flag(&remaining, WS_BORDER)) append_str(out, &offset, ',', "BORDER");
+    if (consume_flag(&remaining, WS_MAXIMIZE)) append_str(out, &offset, ',', "MAXIMIZE");
+    if (consume_flag(&remaining, WS_CLIPCHILDREN)) append_str(out, &offset, ',', "CLIPCHILDREN");
+    if (consume_flag(&remaining, WS_CLIPSIBLINGS)) append_str(out, &offset, ',', "CLIPSIBLINGS");
+    if (consume_flag(&remaining, WS_DISABLED)) append_str(out, &offset, ',', "DISABLED");
+    if (consume_flag(&remaining, WS_VISIBLE)) append_str(out, &offset, ',', "VISIBLE");
+    if (consume_flag(&remaining, WS_MINIMIZE)) append_str(out, &offset, ',', "MINIMIZE");
+    if (consume_flag(&remaining, WS_CHILD)) append_str(out, &offset, ',', "CHILD");
+    if (consume_flag(&remaining, WS_POPUP)) append_str(out, &offset, ',', "POPUP");
+    if (remaining) {
+        if (offset > 0) {
+            out[offset] = ',';
+            offset += 1;
+        }
+        offset += sprintf(out + offset, "0x%08x", remaining);
+    }
+    out[offset] = 0;
+
+    return offset;
+}
+
+
+size_t FormatWndExStyle(char* out, uint32_t ex_style)
+{
+    uint32_t remaining = ex_style;
+    size_t offset = 0;
+    if (consume_flag(&remaining, WS_EX_DLGMODALFRAME)) append_str(out, &offset, ',', "DLGMODALFRAME");
+    // No 0x2 flag
+    if (consume_flag(&remaining, WS_EX_NOPARENTNOTIFY)) append_str(out, &offset, ',', "NOPARENTNOTIFY");
+    if (consume_flag(&remaining, WS_EX_TOPMOST)) append_str(out, &offset, ',', "TOPMOST");
+    if (consume_flag(&remaining, WS_EX_ACCEPTFILES)) append_str(out, &offset, ',', "ACCEPTFILES");
+    if (consume_flag(&remaining, WS_EX_TRANSPARENT)) append_str(out, &offset, ',', "TRANSPARENT");
+    if (consume_flag(&remaining, WS_EX_MDICHILD)) append_str(out, &offset, ',', "MDICHILD");
+    if (consume_flag(&remaining, WS_EX_TOOLWINDOW)) append_str(out, &offset, ',', "TOOLWINDOW");
+    if (consume_flag(&remaining, WS_EX_WINDOWEDGE)) append_str(out, &offset, ',', "WINDOWEDGE");
+    if (consume_flag(&remaining, WS_EX_CLIENTEDGE)) append_str(out, &offset, ',', "CLIENTEDGE");
+    if (consume_flag(&remaining, WS_EX_CONTEXTHELP)) append_str(out, &offset, ',', "CONTEXTHELP");
+    // no 0x800 flag
+    if (consume_flag(&remaining, WS_EX_RIGHT)) append_str(out, &offset, ',', "RIGHT");
+    if (consume_flag(&remaining, WS_EX_RTLREADING)) append_str(out, &offset, ',', "RTLREADING");
+    if (consume_flag(&remaining, WS_EX_LEFTSCROLLBAR)) append_str(out, &offset, ',', "LEFTSCROLLBAR");
+    // no 0x8000 flag
+    if (consume_flag(&remaining, WS_EX_CONTROLPARENT)) append_str(out, &offset, ',', "CONTROLPARENT");
+    if (consume_flag(&remaining, WS_EX_STATICEDGE)) append_str(out, &offset, ',', "STATICEDGE");
+    if (consume_flag(&remaining, WS_EX_APPWINDOW)) append_str(out, &offset, ',', "APPWINDOW");
+    if (consume_flag(&remaining, WS_EX_LAYERED)) append_str(out, &offset, ',', "LAYERED");
+    if (consume_flag(&remaining, WS_EX_NOINHERITLAYOUT)) append_str(out, &offset, ',', "NOINHERITLAYOUT");
+    if (consume_flag(&remaining, WS_EX_NOREDIRECTIONBITMAP)) append_str(out, &offset, ',', "NOREDIRECTIONBITMAP");
+    if (consume_flag(&remaining, WS_EX_LAYOUTRTL)) append_str(out, &offset, ',', "LAYOUTRTL");
+    // no 0x0080000 flag
+    // no 0x0100000 flag
+    if (consume_flag(&remaining, WS_EX_COMPOSITED)) append_str(out, &offset, ',', "COMPOSITED");
+    // no 0x0400000 flag
+    if (consume_flag(&remaining, WS_EX_NOACTIVATE)) append_str(out, &offset, ',', "NOACTIVATE");
+    // no 0x1000000 flag
+    // no 0x2000000 flag
+    // no 0x4000000 flag
+    // no 0x8000000 flag
+
+    if (remaining) {
+        if (offset > 0) {
+            out[offset] = ',';
+            offset += 1;
+        }
+        offset += sprintf(out + offset, "0x%08x", remaining);
+    }
+    out[offset] = 0;
+    return offset;
+}
+
+const char* ShowWindowStatusStr(uint64_t status)
+{
+    switch (status) {
+    case 0: return "ShowWindow";
+    case SW_PARENTCLOSING: return "PARENTCLOSING";
+    case SW_OTHERZOOM: return "OTHERZOOM";
+    case SW_OTHERUNZOOM: return "OTHERUNZOOM";
+    case SW_PARENTOPENING: return "PARENTOPENING";
+    default: return "?";
+    }
+}
+
+size_t FormatSwpFlags(char* out, uint32_t flags)
+{
+    uint32_t remaining = flags;
+    size_t offset = 0;
+    if (consume_flag(&remaining, SWP_NOSIZE)) append_str(out, &offset, ',', "NOSIZE");
+    if (consume_flag(&remaining, SWP_NOMOVE)) append_str(out, &offset, ',', "NOMOVE");
+    if (consume_flag(&remaining, SWP_NOZORDER)) append_str(out, &offset, ',', "NOZORDER");
+    if (consume_flag(&remaining, SWP_NOREDRAW)) append_str(out, &offset, ',', "NOREDRAW");
+    if (consume_flag(&remaining, SWP_NOACTIVATE)) append_str(out, &offset, ',', "NOACTIVATE");
+    if (consume_flag(&remaining, SWP_FRAMECHANGED)) append_str(out, &offset, ',', "FRAMECHANGED");
+    if (consume_flag(&remaining, SWP_SHOWWINDOW)) append_str(out, &offset, ',', "SHOWWINDOW");
+    if (consume_flag(&remaining, SWP_HIDEWINDOW)) append_str(out, &offset, ',', "HIDEWINDOW");
+    if (consume_flag(&remaining, SWP_NOCOPYBITS)) append_str(out, &offset, ',', "NOCOPYBITS");
+    if (consume_flag(&remaining, SWP_NOOWNERZORDER)) append_str(out, &offset, ',', "NOOWNERZORDER");
+    if (consume_flag(&remaining, SWP_NOSENDCHANGING)) append_str(out, &offset, ',', "NOSENDCHANGING");
+    if (consume_flag(&remaining, SWP_DEFERERASE)) append_str(out, &offset, ',', "DEFERERASE");
+    if (consume_flag(&remaining, SWP_ASYNCWINDOWPOS)) append_str(out, &offset, ',', "ASYNCWINDOWPOS");
+    if (remaining) {
+        if (offset > 0) {
+            out[offset] = ',';
+            offset += 1;
+        }
+        offset += sprintf(out + offset, "0x%08x", remaining);
+    }
+    out[offset] = 0;
+    return offset;
+}
+
+const char* ImeNotifyCodeStr(uint64_t code)
+{
+    switch (code) {
+    case IMN_CLOSESTATUSWINDOW: return "CLOSESTATUSWINDOW";
+    case IMN_OPENSTATUSWINDOW: return "OPENSTATUSWINDOW";
+    case IMN_CHANGECANDIDATE: return "CHANGECANDIDATE";
+    case IMN_CLOSECANDIDATE: return "CLOSECANDIDATE";
+    case IMN_OPENCANDIDATE: return "OPENCANDIDATE";
+    case IMN_SETCONVERSIONMODE: return "SETCONVERSIONMODE";
+    case IMN_SETSENTENCEMODE: return "SETSENTENCEMODE";
+    case IMN_SETOPENSTATUS: return "SETOPENSTATUS";
+    case IMN_SETCANDIDATEPOS: return "SETCANDIDATEPOS";
+    case IMN_SETCOMPOSITIONFONT: return "SETCOMPOSITIONFONT";
+    case IMN_SETCOMPOSITIONWINDOW: return "SETCOMPOSITIONWINDOW";
+    case IMN_GUIDELINE: return "GUIDELINE";
+    case IMN_PRIVATE: return "PRIVATE";
+    default: return "?";
+    }
+}
+
+const char* SizeTypeStr(uint64_t type)
+{
+    switch (type) {
+    case SIZE_MAXIMIZED: return "MAXIMIZED";
+    case SIZE_MINIMIZED: return "MINIMIZED";
+    case SIZE_RESTORED: return "RESTORED";
+    case SIZE_MAXHIDE: return "MAXHIDE";
+    case SIZE_MAXSHOW: return "MAXSHOW";
+    default: return "UNKNOWN";
+    }
+}
+
+const char* GetHitStr(int64_t hit_test_area)
+{
+    switch (hit_test_area) {
+    case HTBORDER: return "BORDER";
+    case HTBOTTOM: return "BOTTOM";
+    case HTBOTTOMLEFT: return "BOTTOMLEFT";
+    case HTBOTTOMRIGHT: return "BOTTOMRIGHT";
+    case HTCAPTION: return "CAPTION";
+    case HTCLIENT: return "CLIENT";
+    case HTCLOSE: return "CLOSE";
+    case HTERROR: return "ERROR";
+    case HTGROWBOX: return "GROWBOX";
+    case HTHELP: return "HELP";
+    case HTHSCROLL: return "HSCROLL";
+    case HTLEFT: return "LEFT";
+    case HTMENU: return "MENU";
+    case HTMAXBUTTON: return "MAXBUTTON";
+    case HTMINBUTTON: return "MINBUTTON";
+    case HTNOWHERE: return "NOWHERE";
+    case HTRIGHT: return "RIGHT";
+    case HTSYSMENU: return "SYSMENU";
+    case HTTOP: return "TOP";
+    case HTTOPLEFT: return "TOPLEFT";
+    case HTTOPRIGHT: return "TOPRIGHT";
+    case HTVSCROLL: return "VSCROLL";
+    default: return "?";
+    }
+}
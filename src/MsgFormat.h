@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Decoders for the flag and code fields of window messages.  They only
+// need the values from the Windows headers, not the headers themselves,
+// so tools and benchmarks that read recorded traces on other platforms
+// print fields the same way the window's own log does.
+
+// This is calcualted by calling FormatWndStyle with 0xffffffff and adding 1
+#define FORMAT_WND_STYLE_BUF_LEN ((size_t)147)
+// This is calcualted by calling FormatWndExStyle with 0xffffffff and adding 1
+#define FORMAT_WND_EX_STYLE_BUF_LEN ((size_t)268)
+// This is calcualted by calling FormatSwpFlags with 0xffffffff and adding 1
+#define FORMAT_SWP_FLAGS_BUF_LEN ((size_t)155)
+
+// The flags comma separated, with any bits left over in hex at the end.
+// Returns the length, out needs room for the matching *_BUF_LEN.
+size_t FormatWndStyle(char* out, uint32_t style);
+size_t FormatWndExStyle(char* out, uint32_t ex_style);
+size_t FormatSwpFlags(char* out, uint32_t flags);
+
+// Unknown values are "?", except SizeTypeStr's "UNKNOWN"
+const char* ShowWindowStatusStr(uint64_t status);
+const char* ImeNotifyCodeStr(uint64_t code);
+const char* SizeTypeStr(uint64_t type);
+// An HT* value, as returned from WM_NCHITTEST
+const char* GetHitStr(int64_t hit_test_area);
@@ -0,0 +1,94 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "MsgNameCache.h"
+
+static void* xrealloc(void* ptr, size_t size)
+{
+    void* result = realloc(ptr, size);
+    if (!result) abort();
+    return result;
+}
+
+// shared by every message the backend couldn't name
+static const char UNRESOLVED[] = "?";
+
+static uint32_t slot_of(const MsgNameCache* cache, uint32_t msg)
+{
+    // Fibonacci hashing, registered ids are handed out consecutively and
+    // the top bits of the product spread them over the table, the low ones
+    // only depend on the low bits of msg
+    return (msg * 0x9e3779b1u) >> cache->shift;
+}
+
+static void insert(MsgNameCache* cache, uint32_t msg, const char* name)
+{
+    uint32_t slot = slot_of(cache, msg);
+    while (cache->entries[slot].msg) slot = (slot + 1) & (cache->capacity - 1);
+    cache->entries[slot].msg = msg;
+    cache->entries[slot].name = name;
+    cache->count++;
+}
+
+static void grow(MsgNameCache* cache)
+{
+    MsgNameEntry* old = cache->entries;
+    const uint32_t old_capacity = cache->capacity;
+    cache->capacity = old_capacity ? old_capacity * 2 : 64;
+    cache->shift = old_capacity ? cache->shift - 1 : 26;
+    cache->entries = xrealloc(NULL, cache->capacity * sizeof(MsgNameEntry));
+    memset(cache->entries, 0, cache->capacity * sizeof(MsgNameEntry));
+    cache->count = 0;
+    for (uint32_t i = 0; i < old_capacity; i++) {
+        if (old[i].msg) insert(cache, old[i].msg, old[i].name);
+    }
+    free(old);
+}
+
+void MsgNameCacheInit(MsgNameCache* cache, MsgNameResolver resolve, void* context)
+{
+    memset(cache, 0, sizeof(*cache));
+    cache->resolve = resolve;
+    cache->context = context;
+    grow(cache);
+}
+
+void MsgNameCacheFree(MsgNameCache* cache)
+{
+    for (uint32_t i = 0; i < cache->capacity; i++) {
+        if (cache->entries[i].msg && cache->entries[i].name != UNRESOLVED) free((char*)cache->entries[i].name);
+    }
+    free(cache->entries);
+    memset(cache, 0, sizeof(*cache));
+}
+
+const char* MsgNameCacheGet(MsgNameCache* cache, uint32_t msg)
+{
+    if (msg < MSG_REGISTERED_FIRST || msg > MSG_REGISTERED_LAST) return NULL;
+    for (uint32_t slot = slot_of(cache, msg);; slot = (slot + 1) & (cache->capacity - 1)) {
+        const MsgNameEntry* entry = &cache->entries[slot];
+        if (entry->msg == msg) {
+            cache->hits++;
+            return entry->name;
+        }
+        if (!entry->msg) break;
+    }
+
+    cache->misses++;
+    // atom names are at most 255 characters
+    char buf[256];
+    size_t len = cache->resolve(cache->context, msg, buf, sizeof(buf));
+    if (len >= sizeof(buf)) len = sizeof(buf) - 1;
+    const char* name = UNRESOLVED;
+    if (len) {
+        char* copy = xrealloc(NULL, len + 1);
+        memcpy(copy, buf, len);
+        copy[len] = 0;
+        name = copy;
+    } else {
+        cache->unresolved++;
+    }
+    if ((cache->count + 1) * 2 > cache->capacity) grow(cache);
+    insert(cache, msg, name);
+    return name;
+}
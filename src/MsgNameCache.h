@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Names for registered window messages, the 0xC000-0xFFFF range handed out
+// by RegisterWindowMessage.  The ids differ from run to run so they can't
+// be in GetMsgName's table; each one is resolved once through the backend
+// and kept in an open-addressed table, after that a lookup is a hash and
+// usually a single probe.
+#define MSG_REGISTERED_FIRST 0xc000
+#define MSG_REGISTERED_LAST 0xffff
+
+// Writes msg's name to out (size bytes, including the terminator) and
+// returns its length, 0 if the backend doesn't know msg.  On Windows this
+// is GetClipboardFormatNameA, elsewhere a stub.
+typedef size_t (*MsgNameResolver)(void* context, uint32_t msg, char* out, size_t size);
+
+typedef struct {
+    uint32_t msg; // 0 for an empty slot, never a registered message
+    const char* name;
+} MsgNameEntry;
+
+typedef struct {
+    MsgNameResolver resolve;
+    void* context;
+    MsgNameEntry* entries;
+    uint32_t capacity; // a power of two, at most half full
+    uint32_t shift; // 32 - log2(capacity), slots are the top bits of the hash
+    uint32_t count;
+    uint64_t hits;
+    uint64_t misses; // each one is a call to resolve
+    uint64_t unresolved; // misses the backend didn't know
+} MsgNameCache;
+
+void MsgNameCacheInit(MsgNameCache*, MsgNameResolver, void* context);
+void MsgNameCacheFree(MsgNameCache*);
+// The name of a registered message, "?" if the backend doesn't know it
+// (that's cached too, the backend is asked once per message).  NULL for
+// messages outside the registered range.  The string lives until
+// MsgNameCacheFree.
+const char* MsgNameCacheGet(MsgNameCache*, uint32_t msg);
@@ -0,0 +1,540 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "MsgSequence.h"
+
+static void* xrealloc(void* ptr, size_t size)
+{
+    void* result = realloc(ptr, size);
+    if (!result) abort();
+    return result;
+}
+
+// --------------------------------------------------------------------------------
+// Patterns
+// --------------------------------------------------------------------------------
+
+typedef enum {
+    TOKEN_END,
+    TOKEN_MSG,
+    TOKEN_ANY,
+    TOKEN_SET,
+    TOKEN_NOT_SET,
+    TOKEN_SET_END,
+    TOKEN_GROUP,
+    TOKEN_GROUP_END,
+    TOKEN_OR,
+    TOKEN_STAR,
+    TOKEN_PLUS,
+    TOKEN_QUESTION,
+} TokenKind;
+
+typedef struct {
+    const MsgSeqRule* rule;
+    MsgSeqLookup lookup;
+    const char* pos;
+    const char* token_start;
+    TokenKind token;
+    uint32_t msg;
+    char* error;
+    size_t error_len;
+    bool failed;
+} Parser;
+
+static void parse_error(Parser* parser, const char* fmt, ...)
+{
+    if (parser->failed) return;
+    parser->failed = true;
+    int written = snprintf(parser->error, parser->error_len, "rule \"%s\" offset %d: ",
+        parser->rule->name, (int)(parser->token_start - parser->rule->pattern));
+    if (written < 0 || (size_t)written >= parser->error_len) return;
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(parser->error + written, parser->error_len - written, fmt, args);
+    va_end(args);
+}
+
+static bool is_name_char(char c)
+{
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static void next_token(Parser* parser)
+{
+    const char* p = parser->pos;
+    while (*p == ' ' || *p == '\t' || *p == '\n') p++;
+    parser->token_start = p;
+    switch (*p) {
+    case 0: parser->token = TOKEN_END; parser->pos = p; return;
+    case '.': parser->token = TOKEN_ANY; break;
+    case '[':
+        if (p[1] == '^') {
+            parser->token = TOKEN_NOT_SET;
+            p++;
+        } else {
+            parser->token = TOKEN_SET;
+        }
+        break;
+    case ']': parser->token = TOKEN_SET_END; break;
+    case '(': parser->token = TOKEN_GROUP; break;
+    case ')': parser->token = TOKEN_GROUP_END; break;
+    case '|': parser->token = TOKEN_OR; break;
+    case '*': parser->token = TOKEN_STAR; break;
+    case '+': parser->token = TOKEN_PLUS; break;
+    case '?': parser->token = TOKEN_QUESTION; break;
+    default: {
+        const char* end = p;
+        while (is_name_char(*end)) end++;
+        if (end == p) {
+            parser->token = TOKEN_END;
+            parse_error(parser, "unexpected '%c'", *p);
+            return;
+        }
+        parser->token = TOKEN_MSG;
+        parser->pos = end;
+        if (*p >= '0' && *p <= '9') {
+            char* number_end;
+            const unsigned long msg = strtoul(p, &number_end, 0);
+            if (number_end != end || msg > UINT32_MAX) {
+                parse_error(parser, "bad number \"%.*s\"", (int)(end - p), p);
+                return;
+            }
+            parser->msg = (uint32_t)msg;
+        } else if (!parser->lookup(p, end - p, &parser->msg)) {
+            parse_error(parser, "unknown message \"%.*s\"", (int)(end - p), p);
+        }
+        return;
+    }
+    }
+    parser->pos = p + 1;
+}
+
+// --------------------------------------------------------------------------------
+// Classes
+// --------------------------------------------------------------------------------
+
+static uint32_t class_of(const MsgSeqSpec* spec, uint32_t msg)
+{
+    if (msg < MSG_SEQ_DIRECT_IDS) return spec->direct[msg];
+    uint32_t lo = 0, hi = spec->high_count;
+    while (lo < hi) {
+        const uint32_t mid = (lo + hi) / 2;
+        if (spec->high_ids[mid] < msg) lo = mid + 1;
+        else hi = mid;
+    }
+    return (lo < spec->high_count && spec->high_ids[lo] == msg) ? spec->high_classes[lo] : 0;
+}
+
+static int compare_ids(const void* a, const void* b)
+{
+    const uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Gives every message named in the rules its own class
+static bool assign_classes(MsgSeqSpec* spec, const MsgSeqRule* rules, uint32_t rule_count, Parser* parser)
+{
+    uint32_t ids[MSG_SEQ_MAX_MESSAGES];
+    uint32_t id_count = 0;
+    for (uint32_t r = 0; r < rule_count; r++) {
+        parser->rule = &rules[r];
+        parser->pos = rules[r].pattern;
+        for (next_token(parser); parser->token != TOKEN_END; next_token(parser)) {
+            if (parser->token != TOKEN_MSG) continue;
+            uint32_t i = 0;
+            while (i < id_count && ids[i] != parser->msg) i++;
+            if (i < id_count) continue;
+            if (id_count == MSG_SEQ_MAX_MESSAGES) {
+                parse_error(parser, "more than %d distinct messages", MSG_SEQ_MAX_MESSAGES);
+                break;
+            }
+            ids[id_count++] = parser->msg;
+        }
+        if (parser->failed) return false;
+    }
+
+    spec->class_count = id_count + 1;
+    memset(spec->direct, 0, sizeof(spec->direct));
+    spec->high_count = 0;
+    qsort(ids, id_count, sizeof(ids[0]), compare_ids);
+    for (uint32_t i = 0; i < id_count; i++) {
+        if (ids[i] < MSG_SEQ_DIRECT_IDS) {
+            spec->direct[ids[i]] = (uint8_t)(i + 1);
+        } else {
+            spec->high_ids[spec->high_count] = ids[i];
+            spec->high_classes[spec->high_count] = (uint8_t)(i + 1);
+            spec->high_count++;
+        }
+    }
+    return true;
+}
+
+// --------------------------------------------------------------------------------
+// NFA
+// --------------------------------------------------------------------------------
+
+// A node either consumes one message in set and moves to out, or has an
+// empty set and moves to out and out1 (when not -1) without consuming
+typedef struct {
+    uint64_t set; // bit per class
+    int32_t out;
+    int32_t out1;
+} NfaNode;
+
+typedef struct {
+    NfaNode* nodes;
+    uint32_t count;
+    uint32_t capacity;
+} Nfa;
+
+// Every fragment ends in an empty node whose out is still -1
+typedef struct {
+    int32_t start;
+    int32_t end;
+} Fragment;
+
+static int32_t add_node(Nfa* nfa, uint64_t set, int32_t out, int32_t out1)
+{
+    if (nfa->count == nfa->capacity) {
+        nfa->capacity = nfa->capacity ? nfa->capacity * 2 : 64;
+        nfa->nodes = xrealloc(nfa->nodes, nfa->capacity * sizeof(NfaNode));
+    }
+    nfa->nodes[nfa->count].set = set;
+    nfa->nodes[nfa->count].out = out;
+    nfa->nodes[nfa->count].out1 = out1;
+    return (int32_t)nfa->count++;
+}
+
+static Fragment empty_fragment(Nfa* nfa)
+{
+    const int32_t node = add_node(nfa, 0, -1, -1);
+    Fragment fragment = {node, node};
+    return fragment;
+}
+
+static uint64_t all_classes(const MsgSeqSpec* spec)
+{
+    return (spec->class_count == 64) ? UINT64_MAX : (UINT64_C(1) << spec->class_count) - 1;
+}
+
+static Fragment parse_alternation(Parser* parser, const MsgSeqSpec* spec, Nfa* nfa);
+
+static Fragment parse_atom(Parser* parser, const MsgSeqSpec* spec, Nfa* nfa)
+{
+    uint64_t set = 0;
+    switch (parser->token) {
+    case TOKEN_MSG:
+        set = UINT64_C(1) << class_of(spec, parser->msg);
+        next_token(parser);
+        break;
+    case TOKEN_ANY:
+        set = all_classes(spec);
+        next_token(parser);
+        break;
+    case TOKEN_SET:
+    case TOKEN_NOT_SET: {
+        const bool negate = (parser->token == TOKEN_NOT_SET);
+        for (next_token(parser); parser->token == TOKEN_MSG; next_token(parser)) {
+            set |= UINT64_C(1) << class_of(spec, parser->msg);
+        }
+        if (parser->token != TOKEN_SET_END) {
+            parse_error(parser, "expected a message or ']'");
+            return empty_fragment(nfa);
+        }
+        if (!set) {
+            parse_error(parser, "empty set");
+            return empty_fragment(nfa);
+        }
+        next_token(parser);
+        // never empty, the negation always includes the class of every
+        // message no rule names
+        if (negate) set = all_classes(spec) & ~set;
+        break;
+    }
+    case TOKEN_GROUP: {
+        next_token(parser);
+        Fragment fragment = parse_alternation(parser, spec, nfa);
+        if (parser->token != TOKEN_GROUP_END) {
+            parse_error(parser, "expected ')'");
+            return fragment;
+        }
+        next_token(parser);
+        return fragment;
+    }
+    default:
+        parse_error(parser, "expected a message, '.', '[' or '('");
+        return empty_fragment(nfa);
+    }
+    const int32_t end = add_node(nfa, 0, -1, -1);
+    Fragment fragment = {add_node(nfa, set, end, -1), end};
+    return fragment;
+}
+
+static Fragment parse_repeat(Parser* parser, const MsgSeqSpec* spec, Nfa* nfa)
+{
+    Fragment fragment = parse_atom(parser, spec, nfa);
+    while (!parser->failed) {
+        const TokenKind token = parser->token;
+        if (token != TOKEN_STAR && token != TOKEN_PLUS && token != TOKEN_QUESTION) break;
+        next_token(parser);
+        const int32_t end = add_node(nfa, 0, -1, -1);
+        if (token == TOKEN_PLUS) {
+            nfa->nodes[fragment.end].out = fragment.start;
+            nfa->nodes[fragment.end].out1 = end;
+        } else {
+            // star loops back through the split, question just skips
+            const int32_t split = add_node(nfa, 0, fragment.start, end);
+            nfa->nodes[fragment.end].out = (token == TOKEN_STAR) ? split : end;
+            fragment.start = split;
+        }
+        fragment.end = end;
+    }
+    return fragment;
+}
+
+static Fragment parse_sequence(Parser* parser, const MsgSeqSpec* spec, Nfa* nfa)
+{
+    Fragment fragment = empty_fragment(nfa);
+    while (!parser->failed && parser->token != TOKEN_END && parser->token != TOKEN_OR && parser->token != TOKEN_GROUP_END) {
+        Fragment next = parse_repeat(parser, spec, nfa);
+        nfa->nodes[fragment.end].out = next.start;
+        fragment.end = next.end;
+    }
+    return fragment;
+}
+
+static Fragment parse_alternation(Parser* parser, const MsgSeqSpec* spec, Nfa* nfa)
+{
+    Fragment fragment = parse_sequence(parser, spec, nfa);
+    while (!parser->failed && parser->token == TOKEN_OR) {
+        next_token(parser);
+        Fragment other = parse_sequence(parser, spec, nfa);
+        const int32_t end = add_node(nfa, 0, -1, -1);
+        fragment.start = add_node(nfa, 0, fragment.start, other.start);
+        nfa->nodes[fragment.end].out = end;
+        nfa->nodes[other.end].out = end;
+        fragment.end = end;
+    }
+    return fragment;
+}
+
+// --------------------------------------------------------------------------------
+// DFA
+// --------------------------------------------------------------------------------
+
+static void set_bit(uint64_t* bits, int32_t i) { bits[i / 64] |= UINT64_C(1) << (i % 64); }
+static bool get_bit(const uint64_t* bits, int32_t i) { return (bits[i / 64] >> (i % 64)) & 1; }
+
+// Adds every node reachable through empty nodes
+static void closure(const Nfa* nfa, uint64_t* bits, int32_t* stack)
+{
+    uint32_t top = 0;
+    for (uint32_t i = 0; i < nfa->count; i++) {
+        if (get_bit(bits, i)) stack[top++] = i;
+    }
+    while (top) {
+        const NfaNode* node = &nfa->nodes[stack[--top]];
+        if (node->set) continue;
+        const int32_t outs[2] = {node->out, node->out1};
+        for (int j = 0; j < 2; j++) {
+            if (outs[j] >= 0 && !get_bit(bits, outs[j])) {
+                set_bit(bits, outs[j]);
+                stack[top++] = outs[j];
+            }
+        }
+    }
+}
+
+// Subset construction, then every state that can no longer reach a match
+// is merged into the violation state 0
+static bool build_dfa(Parser* parser, const MsgSeqSpec* spec, const Nfa* nfa, int32_t start, int32_t match, MsgSeqDfa* dfa)
+{
+    const uint32_t words = (nfa->count + 63) / 64;
+    const uint32_t classes = spec->class_count;
+    int32_t* stack = xrealloc(NULL, nfa->count * sizeof(int32_t));
+    uint64_t* scratch = xrealloc(NULL, words * sizeof(uint64_t));
+    // sets[state * words] holds the NFA nodes the DFA state stands for
+    uint32_t capacity = 16;
+    uint64_t* sets = xrealloc(NULL, capacity * words * sizeof(uint64_t));
+    uint32_t* next = xrealloc(NULL, capacity * classes * sizeof(uint32_t));
+    memset(sets, 0, words * sizeof(uint64_t));
+    set_bit(sets, start);
+    closure(nfa, sets, stack);
+    uint32_t count = 1;
+
+    bool ok = true;
+    for (uint32_t state = 0; state < count && ok; state++) {
+        for (uint32_t c = 0; c < classes; c++) {
+            memset(scratch, 0, words * sizeof(uint64_t));
+            for (uint32_t i = 0; i < nfa->count; i++) {
+                const NfaNode* node = &nfa->nodes[i];
+                if (get_bit(&sets[state * words], i) && ((node->set >> c) & 1)) set_bit(scratch, node->out);
+            }
+            closure(nfa, scratch, stack);
+            uint32_t found = 0;
+            while (found < count && memcmp(&sets[found * words], scratch, words * sizeof(uint64_t))) found++;
+            if (found == count) {
+                if (count == UINT16_MAX) {
+                    parse_error(parser, "more than %d DFA states", UINT16_MAX - 1);
+                    ok = false;
+                    break;
+                }
+                if (count == capacity) {
+                    capacity *= 2;
+                    sets = xrealloc(sets, capacity * words * sizeof(uint64_t));
+                    next = xrealloc(next, capacity * classes * sizeof(uint32_t));
+                }
+                memcpy(&sets[count * words], scratch, words * sizeof(uint64_t));
+                count++;
+            }
+            next[state * classes + c] = found;
+        }
+    }
+
+    if (ok) {
+        bool* live = xrealloc(NULL, count * sizeof(bool));
+        for (uint32_t state = 0; state < count; state++) {
+            live[state] = get_bit(&sets[state * words], match);
+        }
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (uint32_t state = 0; state < count; state++) {
+                if (live[state]) continue;
+                for (uint32_t c = 0; c < classes; c++) {
+                    if (live[next[state * classes + c]]) {
+                        live[state] = true;
+                        changed = true;
+                        break;
+                    }
+                }
+            }
+        }
+        if (!live[0]) {
+            parse_error(parser, "the pattern matches nothing");
+            ok = false;
+        } else {
+            uint32_t* renumber = xrealloc(NULL, count * sizeof(uint32_t));
+            uint32_t live_count = 1;
+            for (uint32_t state = 0; state < count; state++) {
+                renumber[state] = live[state] ? live_count++ : 0;
+            }
+            dfa->name = parser->rule->name;
+            dfa->state_count = live_count;
+            dfa->start = renumber[0];
+            dfa->next = xrealloc(NULL, live_count * classes * sizeof(uint16_t));
+            memset(dfa->next, 0, classes * sizeof(uint16_t));
+            for (uint32_t state = 0; state < count; state++) {
+                if (!live[state]) continue;
+                for (uint32_t c = 0; c < classes; c++) {
+                    dfa->next[renumber[state] * classes + c] = (uint16_t)renumber[next[state * classes + c]];
+                }
+            }
+            free(renumber);
+        }
+        free(live);
+    }
+    free(scratch);
+    free(next);
+    free(sets);
+    free(stack);
+    return ok;
+}
+
+bool MsgSeqCompile(MsgSeqSpec* spec, const MsgSeqRule* rules, uint32_t rule_count, MsgSeqLookup lookup, char* error, size_t error_len)
+{
+    memset(spec, 0, sizeof(*spec));
+    Parser parser;
+    memset(&parser, 0, sizeof(parser));
+    parser.lookup = lookup;
+    parser.error = error;
+    parser.error_len = error_len;
+    if (error_len) error[0] = 0;
+    if (!assign_classes(spec, rules, rule_count, &parser)) return false;
+
+    spec->dfas = xrealloc(NULL, (rule_count ? rule_count : 1) * sizeof(MsgSeqDfa));
+    Nfa nfa = {NULL, 0, 0};
+    for (uint32_t r = 0; r < rule_count; r++) {
+        parser.rule = &rules[r];
+        parser.pos = rules[r].pattern;
+        nfa.count = 0;
+        next_token(&parser);
+        Fragment fragment = parse_alternation(&parser, spec, &nfa);
+        if (!parser.failed && parser.token != TOKEN_END) {
+            parse_error(&parser, "unbalanced ')'");
+        }
+        if (parser.failed || !build_dfa(&parser, spec, &nfa, fragment.start, fragment.end, &spec->dfas[r])) {
+            free(nfa.nodes);
+            MsgSeqSpecFree(spec);
+            return false;
+        }
+        spec->rule_count++;
+    }
+    free(nfa.nodes);
+    return true;
+}
+
+void MsgSeqSpecFree(MsgSeqSpec* spec)
+{
+    for (uint32_t r = 0; r < spec->rule_count; r++) {
+        free(spec->dfas[r].next);
+    }
+    free(spec->dfas);
+    spec->dfas = NULL;
+    spec->rule_count = 0;
+}
+
+// --------------------------------------------------------------------------------
+// Verifier
+// --------------------------------------------------------------------------------
+
+void MsgSeqVerifierInit(MsgSeqVerifier* verifier, const MsgSeqSpec* spec)
+{
+    verifier->spec = spec;
+    verifier->states = xrealloc(NULL, (spec->rule_count ? spec->rule_count : 1) * sizeof(uint16_t));
+    for (uint32_t r = 0; r < spec->rule_count; r++) {
+        verifier->states[r] = (uint16_t)spec->dfas[r].start;
+    }
+    verifier->msg_count = 0;
+}
+
+void MsgSeqVerifierFree(MsgSeqVerifier* verifier)
+{
+    free(verifier->states);
+    verifier->states = NULL;
+}
+
+int32_t MsgSeqStep(MsgSeqVerifier* verifier, uint32_t msg)
+{
+    const MsgSeqSpec* spec = verifier->spec;
+    const uint32_t c = class_of(spec, msg);
+    verifier->history[verifier->msg_count % MSG_SEQ_HISTORY] = msg;
+    verifier->msg_count++;
+    int32_t violated = -1;
+    for (uint32_t r = 0; r < spec->rule_count; r++) {
+        const uint16_t state = verifier->states[r];
+        if (state == 0) continue;
+        const uint16_t next = spec->dfas[r].next[state * spec->class_count + c];
+        verifier->states[r] = next;
+        if (next == 0 && violated < 0) violated = (int32_t)r;
+    }
+    return violated;
+}
+
+size_t MsgSeqFormatViolation(const MsgSeqVerifier* verifier, int32_t rule, const char* (*msg_name)(uint32_t), char* buf, size_t len)
+{
+    size_t used = 0;
+    const uint64_t count = verifier->msg_count;
+    const uint32_t last = verifier->history[(count + MSG_SEQ_HISTORY - 1) % MSG_SEQ_HISTORY];
+    int written = snprintf(buf, len, "rule \"%s\" violated by %s (%u), message %llu, recent:",
+        verifier->spec->dfas[rule].name, msg_name(last), last, (unsigned long long)count);
+    if (written > 0) used += written;
+    const uint64_t first = (count > MSG_SEQ_HISTORY) ? count - MSG_SEQ_HISTORY : 0;
+    for (uint64_t i = first; i < count; i++) {
+        const uint32_t msg = verifier->history[i % MSG_SEQ_HISTORY];
+        written = snprintf(buf + (used < len ? used : len), used < len ? len - used : 0, " %s(%u)", msg_name(msg), msg);
+        if (written > 0) used += written;
+    }
+    return used;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Checks a window's message stream against protocol rules.  Each rule is
+// a regular expression over message ids and the stream must always stay a
+// prefix of some sequence the rule matches.  Rules are compiled into DFAs
+// once, after that every message costs one table lookup per rule.
+//
+// Pattern syntax, tokens are separated by whitespace:
+//   WM_CREATE      a message by name, names are resolved by the caller
+//   0x8001, 32     a message by number
+//   .              any message
+//   [A B]          any of the listed messages
+//   [^A B]         any message except the listed ones
+//   ( ) | * + ?    grouping, alternation and repetition as usual
+//
+// For example "WM_GETMINMAXINFO WM_NCCREATE .*" only allows streams that
+// start with those two messages and "[^WM_DESTROY]*" rejects WM_DESTROY.
+typedef struct {
+    const char* name; // shown in the violation report
+    const char* pattern;
+} MsgSeqRule;
+
+// Resolves a message name, name isn't null terminated
+typedef bool (*MsgSeqLookup)(const char* name, size_t len, uint32_t* msg);
+
+// At most this many distinct messages can be named across all rules
+#define MSG_SEQ_MAX_MESSAGES 63
+// Messages below this map to their class with a direct table lookup
+#define MSG_SEQ_DIRECT_IDS 1024
+
+typedef struct {
+    const char* name;
+    uint32_t state_count;
+    uint32_t start;
+    // next[state * class_count + class], state 0 means the rule is violated
+    uint16_t* next;
+} MsgSeqDfa;
+
+typedef struct {
+    MsgSeqDfa* dfas;
+    uint32_t rule_count;
+    // Every named message gets its own class, all other messages share
+    // class 0
+    uint32_t class_count;
+    uint8_t direct[MSG_SEQ_DIRECT_IDS];
+    uint32_t high_count;
+    uint32_t high_ids[MSG_SEQ_MAX_MESSAGES]; // sorted, ids >= MSG_SEQ_DIRECT_IDS
+    uint8_t high_classes[MSG_SEQ_MAX_MESSAGES];
+} MsgSeqSpec;
+
+// Returns false and describes the problem in error if a pattern doesn't
+// parse.  The spec keeps pointers to the rule names.
+bool MsgSeqCompile(MsgSeqSpec*, const MsgSeqRule* rules, uint32_t rule_count, MsgSeqLookup, char* error, size_t error_len);
+void MsgSeqSpecFree(MsgSeqSpec*);
+
+#define MSG_SEQ_HISTORY 32
+
+typedef struct {
+    const MsgSeqSpec* spec;
+    uint16_t* states;
+    uint64_t msg_count;
+    uint32_t history[MSG_SEQ_HISTORY]; // ring, the last MSG_SEQ_HISTORY messages
+} MsgSeqVerifier;
+
+void MsgSeqVerifierInit(MsgSeqVerifier*, const MsgSeqSpec*);
+void MsgSeqVerifierFree(MsgSeqVerifier*);
+// Returns the index of a rule that msg violates, or -1.  A violated rule
+// is reported once and ignores the rest of the stream.
+int32_t MsgSeqStep(MsgSeqVerifier*, uint32_t msg);
+// Describes the violation of rule along with the recent history, always
+// null terminates and returns the length it would have needed like snprintf
+size_t MsgSeqFormatViolation(const MsgSeqVerifier*, int32_t rule, const char* (*msg_name)(uint32_t), char* buf, size_t len);
@@ -0,0 +1,76 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "PointerBatch.h"
+
+static void* xrealloc(void* ptr, size_t size)
+{
+    void* result = realloc(ptr, size);
+    if (!result) abort();
+    return result;
+}
+
+void PointerBatchInit(PointerBatch* batch)
+{
+    memset(batch, 0, sizeof(*batch));
+}
+
+void PointerBatchFree(PointerBatch* batch)
+{
+    free(batch->x);
+    free(batch->y);
+    free(batch->buttons);
+    free(batch->modifiers);
+    free(batch->time);
+    memset(batch, 0, sizeof(*batch));
+}
+
+static void grow(PointerBatch* batch)
+{
+    // a frame at 1000Hz holds about 17 samples at 60Hz
+    const uint32_t capacity = batch->capacity ? batch->capacity * 2 : 64;
+    batch->x = xrealloc(batch->x, capacity * sizeof(int32_t));
+    batch->y = xrealloc(batch->y, capacity * sizeof(int32_t));
+    batch->buttons = xrealloc(batch->buttons, capacity * sizeof(uint16_t));
+    batch->modifiers = xrealloc(batch->modifiers, capacity * sizeof(uint16_t));
+    batch->time = xrealloc(batch->time, capacity * sizeof(uint64_t));
+    batch->capacity = capacity;
+}
+
+void PointerBatchAdd(PointerBatch* batch, int32_t x, int32_t y, uint16_t buttons, uint16_t modifiers, uint64_t time)
+{
+    if (batch->count == batch->capacity) grow(batch);
+    const uint32_t i = batch->count++;
+    batch->x[i] = x;
+    batch->y[i] = y;
+    batch->buttons[i] = buttons;
+    batch->modifiers[i] = modifiers;
+    batch->time[i] = time;
+
+    PointerState* state = &batch->state;
+    if (state->valid) {
+        state->dx += x - state->x;
+        state->dy += y - state->y;
+        state->pressed |= buttons & ~state->buttons;
+        state->released |= state->buttons & ~buttons;
+    } else {
+        state->pressed = buttons;
+    }
+    state->valid = true;
+    state->x = x;
+    state->y = y;
+    state->buttons = buttons;
+    state->modifiers = modifiers;
+    state->time = time;
+    state->samples++;
+}
+
+void PointerBatchClear(PointerBatch* batch)
+{
+    batch->count = 0;
+    batch->state.samples = 0;
+    batch->state.dx = 0;
+    batch->state.dy = 0;
+    batch->state.pressed = 0;
+    batch->state.released = 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Pointer samples collected over one frame so drawing and dragging code
+// sees every point but runs once per frame.  Samples are stored as
+// separate arrays, a handler that only needs positions only touches x and
+// y.  Timestamps are in caller-defined units, the app uses the message
+// time in milliseconds.
+//
+// The button and modifier bits have the same values as the Win32 MK_*
+// flags so WM_MOUSEMOVE's wparam converts with a mask.
+#define POINTER_BUTTON_LEFT 0x0001
+#define POINTER_BUTTON_RIGHT 0x0002
+#define POINTER_BUTTON_MIDDLE 0x0010
+#define POINTER_BUTTON_X1 0x0020
+#define POINTER_BUTTON_X2 0x0040
+#define POINTER_BUTTONS (POINTER_BUTTON_LEFT | POINTER_BUTTON_RIGHT | POINTER_BUTTON_MIDDLE | POINTER_BUTTON_X1 | POINTER_BUTTON_X2)
+#define POINTER_MOD_SHIFT 0x0004
+#define POINTER_MOD_CONTROL 0x0008
+#define POINTER_MODS (POINTER_MOD_SHIFT | POINTER_MOD_CONTROL)
+
+// The latest state coalesced from every sample so far, for handlers that
+// only care where the pointer ended up
+typedef struct {
+    bool valid; // false until the first sample
+    int32_t x, y;
+    uint16_t buttons;
+    uint16_t modifiers;
+    uint64_t time;
+    // since the last PointerBatchClear
+    uint32_t samples;
+    int32_t dx, dy;
+    uint16_t pressed; // buttons that went down at some point
+    uint16_t released; // buttons that went up at some point
+} PointerState;
+
+typedef struct {
+    int32_t* x;
+    int32_t* y;
+    uint16_t* buttons;
+    uint16_t* modifiers;
+    uint64_t* time;
+    uint32_t count;
+    uint32_t capacity;
+    PointerState state;
+} PointerBatch;
+
+void PointerBatchInit(PointerBatch*);
+void PointerBatchFree(PointerBatch*);
+void PointerBatchAdd(PointerBatch*, int32_t x, int32_t y, uint16_t buttons, uint16_t modifiers, uint64_t time);
+// Starts the next frame's batch.  Keeps the storage and the latest
+// position, buttons and modifiers.
+void PointerBatchClear(PointerBatch*);
@@ -0,0 +1,333 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "Region.h"
+
+static void* xrealloc(void* ptr, size_t size)
+{
+    void* result = realloc(ptr, size);
+    if (!result) abort();
+    return result;
+}
+
+void RegionInit(Region* region)
+{
+    memset(region, 0, sizeof(*region));
+}
+
+void RegionFree(Region* region)
+{
+    free(region->bands);
+    free(region->spans);
+    memset(region, 0, sizeof(*region));
+}
+
+void RegionClear(Region* region)
+{
+    region->band_count = 0;
+    region->span_count = 0;
+}
+
+static void reserve_bands(Region* region, uint32_t count)
+{
+    if (count <= region->band_capacity) return;
+    uint32_t capacity = region->band_capacity ? region->band_capacity : 8;
+    while (capacity < count) capacity *= 2;
+    region->bands = xrealloc(region->bands, capacity * sizeof(RegionBand));
+    region->band_capacity = capacity;
+}
+static void reserve_spans(Region* region, uint32_t count)
+{
+    if (count <= region->span_capacity) return;
+    uint32_t capacity = region->span_capacity ? region->span_capacity : 8;
+    while (capacity < count) capacity *= 2;
+    region->spans = xrealloc(region->spans, capacity * sizeof(RegionSpan));
+    region->span_capacity = capacity;
+}
+
+void RegionSetRect(Region* region, int32_t left, int32_t top, int32_t right, int32_t bottom)
+{
+    RegionClear(region);
+    if (left >= right || top >= bottom) return;
+    reserve_bands(region, 1);
+    reserve_spans(region, 1);
+    region->spans[0].left = left;
+    region->spans[0].right = right;
+    region->span_count = 1;
+    region->bands[0].top = top;
+    region->bands[0].bottom = bottom;
+    region->bands[0].span_start = 0;
+    region->bands[0].span_count = 1;
+    region->band_count = 1;
+}
+
+void RegionCopy(Region* dst, const Region* src)
+{
+    if (dst == src) return;
+    RegionClear(dst);
+    if (src->band_count == 0) return;
+    reserve_bands(dst, src->band_count);
+    reserve_spans(dst, src->span_count);
+    memcpy(dst->bands, src->bands, src->band_count * sizeof(RegionBand));
+    memcpy(dst->spans, src->spans, src->span_count * sizeof(RegionSpan));
+    dst->band_count = src->band_count;
+    dst->span_count = src->span_count;
+}
+
+static bool op_inside(RegionOp op, bool in_a, bool in_b)
+{
+    switch (op) {
+    case REGION_OP_UNION: return in_a || in_b;
+    case REGION_OP_INTERSECT: return in_a && in_b;
+    case REGION_OP_SUBTRACT: return in_a && !in_b;
+    case REGION_OP_XOR: return in_a != in_b;
+    }
+    abort();
+}
+
+static int32_t span_edge(const RegionSpan* spans, uint32_t edge_index)
+{
+    const RegionSpan* span = &spans[edge_index >> 1];
+    return (edge_index & 1) ? span->right : span->left;
+}
+
+// Combines two sorted span lists by sweeping over their edges, appends
+// the result to out->spans and returns how many spans were appended.
+static uint32_t combine_spans(
+    Region* out,
+    const RegionSpan* a, uint32_t a_count,
+    const RegionSpan* b, uint32_t b_count,
+    RegionOp op
+) {
+    const uint32_t start_count = out->span_count;
+    reserve_spans(out, out->span_count + a_count + b_count);
+    const uint32_t a_edges = a_count * 2;
+    const uint32_t b_edges = b_count * 2;
+    uint32_t ia = 0, ib = 0;
+    bool in_a = false, in_b = false, inside = false;
+    int32_t span_left = 0;
+    while (ia < a_edges || ib < b_edges) {
+        const int32_t xa = (ia < a_edges) ? span_edge(a, ia) : INT32_MAX;
+        const int32_t xb = (ib < b_edges) ? span_edge(b, ib) : INT32_MAX;
+        const int32_t x = (xa < xb) ? xa : xb;
+        if (xa == x) { in_a = !in_a; ia++; }
+        if (xb == x) { in_b = !in_b; ib++; }
+        const bool now_inside = op_inside(op, in_a, in_b);
+        if (now_inside && !inside) {
+            span_left = x;
+        } else if (!now_inside && inside) {
+            out->spans[out->span_count].left = span_left;
+            out->spans[out->span_count].right = x;
+            out->span_count++;
+        }
+        inside = now_inside;
+    }
+    return out->span_count - start_count;
+}
+
+// Adds a band whose spans were just appended to out->spans, merging it
+// into the previous band when they touch and have identical spans.
+static void finish_band(Region* out, int32_t top, int32_t bottom, uint32_t span_count)
+{
+    if (span_count == 0) return;
+    const uint32_t span_start = out->span_count - span_count;
+    if (out->band_count > 0) {
+        RegionBand* prev = &out->bands[out->band_count - 1];
+        if (prev->bottom == top && prev->span_count == span_count &&
+            !memcmp(&out->spans[prev->span_start], &out->spans[span_start], span_count * sizeof(RegionSpan))) {
+            prev->bottom = bottom;
+            out->span_count = span_start;
+            return;
+        }
+    }
+    reserve_bands(out, out->band_count + 1);
+    RegionBand* band = &out->bands[out->band_count++];
+    band->top = top;
+    band->bottom = bottom;
+    band->span_start = span_start;
+    band->span_count = span_count;
+}
+
+static void combine(Region* out, const Region* a, const Region* b, RegionOp op)
+{
+    RegionClear(out);
+    int32_t y = INT32_MAX;
+    if (a->band_count > 0) y = a->bands[0].top;
+    if (b->band_count > 0 && b->bands[0].top < y) y = b->bands[0].top;
+
+    // sweep down over every y where either region starts or ends a band
+    uint32_t ia = 0, ib = 0;
+    while (true) {
+        while (ia < a->band_count && a->bands[ia].bottom <= y) ia++;
+        while (ib < b->band_count && b->bands[ib].bottom <= y) ib++;
+        if (ia == a->band_count && ib == b->band_count) break;
+        if (op == REGION_OP_INTERSECT && (ia == a->band_count || ib == b->band_count)) break;
+        if (op == REGION_OP_SUBTRACT && ia == a->band_count) break;
+
+        const RegionBand* band_a = (ia < a->band_count && a->bands[ia].top <= y) ? &a->bands[ia] : NULL;
+        const RegionBand* band_b = (ib < b->band_count && b->bands[ib].top <= y) ? &b->bands[ib] : NULL;
+        const int32_t next_a = (ia == a->band_count) ? INT32_MAX : band_a ? band_a->bottom : a->bands[ia].top;
+        const int32_t next_b = (ib == b->band_count) ? INT32_MAX : band_b ? band_b->bottom : b->bands[ib].top;
+        const int32_t next_y = (next_a < next_b) ? next_a : next_b;
+
+        if (band_a || band_b) {
+            const uint32_t count = combine_spans(
+                out,
+                band_a ? &a->spans[band_a->span_start] : NULL, band_a ? band_a->span_count : 0,
+                band_b ? &b->spans[band_b->span_start] : NULL, band_b ? band_b->span_count : 0,
+                op
+            );
+            finish_band(out, y, next_y, count);
+        }
+        y = next_y;
+    }
+}
+
+void RegionCombine(Region* dst, const Region* a, const Region* b, RegionOp op)
+{
+    if (dst != a && dst != b) {
+        combine(dst, a, b, op);
+        return;
+    }
+    Region result;
+    RegionInit(&result);
+    combine(&result, a, b, op);
+    RegionFree(dst);
+    *dst = result;
+}
+
+void RegionUnionRect(Region* region, int32_t left, int32_t top, int32_t right, int32_t bottom)
+{
+    if (left >= right || top >= bottom) return;
+    RegionSpan span = { left, right };
+    RegionBand band = { top, bottom, 0, 1 };
+    const Region rect = { &band, 1, 1, &span, 1, 1 };
+    RegionCombine(region, region, &rect, REGION_OP_UNION);
+}
+
+// Merges the last band into the one before it if they touch and have
+// the same spans
+static void merge_last_band(Region* region)
+{
+    if (region->band_count < 2) return;
+    RegionBand* prev = &region->bands[region->band_count - 2];
+    const RegionBand* last = &region->bands[region->band_count - 1];
+    if (prev->bottom == last->top && prev->span_count == last->span_count &&
+        !memcmp(&region->spans[prev->span_start], &region->spans[last->span_start], last->span_count * sizeof(RegionSpan))) {
+        prev->bottom = last->bottom;
+        region->span_count = last->span_start;
+        region->band_count--;
+    }
+}
+
+void RegionAppendRect(Region* region, int32_t left, int32_t top, int32_t right, int32_t bottom)
+{
+    if (left >= right || top >= bottom) return;
+    RegionBand* last = region->band_count ? &region->bands[region->band_count - 1] : NULL;
+    if (last && last->top == top) {
+        if (last->bottom != bottom) abort();
+        RegionSpan* span = &region->spans[region->span_count - 1];
+        if (left < span->right) abort();
+        if (left == span->right) {
+            span->right = right;
+            return;
+        }
+        reserve_spans(region, region->span_count + 1);
+        region->spans[region->span_count].left = left;
+        region->spans[region->span_count].right = right;
+        region->span_count++;
+        last->span_count++;
+        return;
+    }
+    if (last && top < last->bottom) abort();
+    merge_last_band(region);
+    reserve_bands(region, region->band_count + 1);
+    reserve_spans(region, region->span_count + 1);
+    RegionBand* band = &region->bands[region->band_count++];
+    band->top = top;
+    band->bottom = bottom;
+    band->span_start = region->span_count;
+    band->span_count = 1;
+    region->spans[region->span_count].left = left;
+    region->spans[region->span_count].right = right;
+    region->span_count++;
+}
+
+void RegionAppendEnd(Region* region)
+{
+    merge_last_band(region);
+}
+
+bool RegionIsEmpty(const Region* region)
+{
+    return region->band_count == 0;
+}
+
+bool RegionEqual(const Region* a, const Region* b)
+{
+    if (a->band_count != b->band_count || a->span_count != b->span_count) return false;
+    if (a->band_count == 0) return true;
+    // span_start is derived from the order bands were built in so it's the
+    // same for equal regions, both arrays can be compared directly
+    return !memcmp(a->bands, b->bands, a->band_count * sizeof(RegionBand)) &&
+        !memcmp(a->spans, b->spans, a->span_count * sizeof(RegionSpan));
+}
+
+bool RegionContains(const Region* region, int32_t x, int32_t y)
+{
+    // binary search for the band, then for the span
+    uint32_t lo = 0, hi = region->band_count;
+    while (lo < hi) {
+        const uint32_t mid = (lo + hi) / 2;
+        if (region->bands[mid].bottom <= y) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == region->band_count || region->bands[lo].top > y) return false;
+    const RegionBand* band = &region->bands[lo];
+    const RegionSpan* spans = &region->spans[band->span_start];
+    lo = 0;
+    hi = band->span_count;
+    while (lo < hi) {
+        const uint32_t mid = (lo + hi) / 2;
+        if (spans[mid].right <= x) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < band->span_count && spans[lo].left <= x;
+}
+
+bool RegionGetBox(const Region* region, int32_t* left, int32_t* top, int32_t* right, int32_t* bottom)
+{
+    if (region->band_count == 0) return false;
+    *top = region->bands[0].top;
+    *bottom = region->bands[region->band_count - 1].bottom;
+    *left = INT32_MAX;
+    *right = INT32_MIN;
+    for (uint32_t i = 0; i < region->band_count; i++) {
+        const RegionBand* band = &region->bands[i];
+        if (region->spans[band->span_start].left < *left) *left = region->spans[band->span_start].left;
+        if (region->spans[band->span_start + band->span_count - 1].right > *right) {
+            *right = region->spans[band->span_start + band->span_count - 1].right;
+        }
+    }
+    return true;
+}
+
+uint32_t RegionRectCount(const Region* region)
+{
+    return region->span_count;
+}
+
+int64_t RegionArea(const Region* region)
+{
+    int64_t area = 0;
+    for (uint32_t i = 0; i < region->band_count; i++) {
+        const RegionBand* band = &region->bands[i];
+        int64_t width = 0;
+        for (uint32_t j = 0; j < band->span_count; j++) {
+            const RegionSpan* span = &region->spans[band->span_start + j];
+            width += span->right - span->left;
+        }
+        area += width * (band->bottom - band->top);
+    }
+    return area;
+}
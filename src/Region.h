@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// A region is a list of horizontal bands sorted top to bottom, each band
+// holding a sorted list of disjoint spans.  This is the same "y-x banded"
+// layout GetRegionData returns, so an HRGN converts without sorting.
+// Bands never overlap and adjacent bands with identical spans are merged,
+// so two equal regions always have the same representation.
+typedef struct {
+    int32_t left, right;
+} RegionSpan;
+
+typedef struct {
+    int32_t top, bottom;
+    uint32_t span_start; // index into Region.spans
+    uint32_t span_count;
+} RegionBand;
+
+typedef struct {
+    RegionBand* bands;
+    uint32_t band_count;
+    uint32_t band_capacity;
+    RegionSpan* spans;
+    uint32_t span_count;
+    uint32_t span_capacity;
+} Region;
+
+typedef enum {
+    REGION_OP_UNION,
+    REGION_OP_INTERSECT,
+    REGION_OP_SUBTRACT, // a - b
+    REGION_OP_XOR,
+} RegionOp;
+
+void RegionInit(Region*);
+void RegionFree(Region*);
+void RegionClear(Region*);
+void RegionSetRect(Region*, int32_t left, int32_t top, int32_t right, int32_t bottom);
+void RegionCopy(Region* dst, const Region* src);
+// dst may be the same region as a or b
+void RegionCombine(Region* dst, const Region* a, const Region* b, RegionOp op);
+// Combines with a region of one rect, O(n) and an allocation per call
+void RegionUnionRect(Region*, int32_t left, int32_t top, int32_t right, int32_t bottom);
+// Builds a region from rects that are already y-x banded, like the ones
+// GetRegionData returns: each rect either continues the last band to the
+// right of its last span, or starts a new band at or below it.  Aborts on
+// rects out of that order.  Touching spans and identical adjacent bands
+// are merged, the last band when RegionAppendEnd is called.
+void RegionAppendRect(Region*, int32_t left, int32_t top, int32_t right, int32_t bottom);
+void RegionAppendEnd(Region*);
+
+bool RegionIsEmpty(const Region*);
+bool RegionEqual(const Region*, const Region*);
+bool RegionContains(const Region*, int32_t x, int32_t y);
+// Returns false if the region is empty
+bool RegionGetBox(const Region*, int32_t* left, int32_t* top, int32_t* right, int32_t* bottom);
+uint32_t RegionRectCount(const Region*);
+int64_t RegionArea(const Region*);
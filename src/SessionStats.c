@@ -0,0 +1,221 @@
+#include <string.h>
+
+#include "SessionStats.h"
+
+static const char* const HISTOGRAM_NAMES[STATS_HISTOGRAM_COUNT] = {
+    "message", "hit_test", "swp_flags", "size_type", "ime_notify",
+};
+
+// --------------------------------------------------------------------------------
+// Counting
+// --------------------------------------------------------------------------------
+
+static uint32_t histogram_slot(uint32_t key)
+{
+    return (key * 0x9e3779b1u) >> 26; // top 6 bits, STATS_HISTOGRAM_SLOTS == 64
+}
+
+static void histogram_add(StatsHistogram* histogram, uint32_t key)
+{
+    uint32_t slot = histogram_slot(key);
+    for (uint32_t i = 0; i < STATS_HISTOGRAM_SLOTS; i++) {
+        if (!histogram->counts[slot]) histogram->keys[slot] = key;
+        if (histogram->keys[slot] == key) {
+            histogram->counts[slot]++;
+            return;
+        }
+        slot = (slot + 1) % STATS_HISTOGRAM_SLOTS;
+    }
+    histogram->overflow++;
+}
+
+static uint32_t histogram_count(const StatsHistogram* histogram, uint32_t key)
+{
+    uint32_t slot = histogram_slot(key);
+    for (uint32_t i = 0; i < STATS_HISTOGRAM_SLOTS && histogram->counts[slot]; i++) {
+        if (histogram->keys[slot] == key) return histogram->counts[slot];
+        slot = (slot + 1) % STATS_HISTOGRAM_SLOTS;
+    }
+    return 0;
+}
+
+// Moves the rate window to the second now_ms is in, each second skipped
+// over had no messages
+static void advance(SessionStats* stats, uint64_t now_ms)
+{
+    // the common case, without a division
+    if (now_ms < stats->second_end_ms) return;
+    const uint64_t second = (now_ms - stats->start_ms) / 1000;
+    const uint32_t finished = stats->per_second[stats->second % STATS_RATE_SECONDS];
+    if (finished > stats->peak_per_second) stats->peak_per_second = finished;
+    const uint64_t skipped = second - stats->second;
+    for (uint64_t i = 1; i <= skipped && i <= STATS_RATE_SECONDS; i++) {
+        stats->per_second[(stats->second + i) % STATS_RATE_SECONDS] = 0;
+    }
+    stats->second = second;
+    stats->second_end_ms = stats->start_ms + (second + 1) * 1000;
+}
+
+void SessionStatsInit(SessionStats* stats, uint64_t now_ms)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->start_ms = now_ms;
+    stats->second_end_ms = now_ms + 1000;
+}
+
+void SessionStatsMessage(SessionStats* stats, uint32_t msg, uint64_t now_ms)
+{
+    stats->messages++;
+    if (msg < STATS_DIRECT_MSGS) stats->direct[msg]++;
+    else histogram_add(&stats->histograms[STATS_HIGH_MSGS], msg);
+    advance(stats, now_ms);
+    stats->per_second[stats->second % STATS_RATE_SECONDS]++;
+}
+
+void SessionStatsAdd(SessionStats* stats, StatsHistogramId id, uint32_t key)
+{
+    histogram_add(&stats->histograms[id], key);
+}
+
+uint32_t SessionStatsCount(const SessionStats* stats, StatsHistogramId id, uint32_t key)
+{
+    return histogram_count(&stats->histograms[id], key);
+}
+
+uint32_t SessionStatsMsgCount(const SessionStats* stats, uint32_t msg)
+{
+    if (msg < STATS_DIRECT_MSGS) return stats->direct[msg];
+    return histogram_count(&stats->histograms[STATS_HIGH_MSGS], msg);
+}
+
+static double window_rate(const SessionStats* stats, uint32_t seconds)
+{
+    // only whole seconds, and not more than the session has had
+    if (seconds > stats->second) seconds = (uint32_t)stats->second;
+    if (!seconds) return 0.0;
+    uint64_t total = 0;
+    for (uint32_t i = 1; i <= seconds; i++) total += stats->per_second[(stats->second - i) % STATS_RATE_SECONDS];
+    return (double)total / seconds;
+}
+
+void SessionStatsRates(SessionStats* stats, uint64_t now_ms, StatsRates* rates)
+{
+    advance(stats, now_ms);
+    rates->last_1s = window_rate(stats, 1);
+    rates->last_10s = window_rate(stats, 10);
+    rates->last_60s = window_rate(stats, 60);
+    rates->peak_1s = stats->peak_per_second;
+    const uint64_t elapsed = now_ms - stats->start_ms;
+    rates->mean = elapsed ? stats->messages * 1000.0 / elapsed : 0.0;
+}
+
+// --------------------------------------------------------------------------------
+// Export
+// --------------------------------------------------------------------------------
+
+// Calls emit for every counted key in order: messages by id, then each
+// distribution in slot order.  Keys are written signed, hit-test codes go
+// down to HTERROR (-2); a distribution's overflow has no key.
+typedef void (*EmitFn)(FILE*, bool first, const char* section, const int32_t* key, const char* name, uint64_t count);
+
+static void emit_all(const SessionStats* stats, const StatsNames* names, FILE* file, EmitFn emit)
+{
+    bool first = true;
+    for (uint32_t msg = 0; msg < STATS_DIRECT_MSGS; msg++) {
+        if (!stats->direct[msg]) continue;
+        const int32_t key = (int32_t)msg;
+        emit(file, first, "message", &key, names->msg(msg), stats->direct[msg]);
+        first = false;
+    }
+    for (uint32_t id = 0; id < STATS_HISTOGRAM_COUNT; id++) {
+        const StatsHistogram* histogram = &stats->histograms[id];
+        for (uint32_t slot = 0; slot < STATS_HISTOGRAM_SLOTS; slot++) {
+            if (!histogram->counts[slot]) continue;
+            const uint32_t key = histogram->keys[slot];
+            char buf[256];
+            const char* name = buf;
+            if (id == STATS_HIGH_MSGS) name = names->msg(key);
+            else names->key((StatsHistogramId)id, key, buf, sizeof(buf));
+            const int32_t signed_key = (int32_t)key;
+            emit(file, first, HISTOGRAM_NAMES[id], &signed_key, name, histogram->counts[slot]);
+            first = false;
+        }
+        if (histogram->overflow) {
+            emit(file, first, HISTOGRAM_NAMES[id], NULL, "(other)", histogram->overflow);
+            first = false;
+        }
+    }
+}
+
+static void csv_string(FILE* file, const char* s)
+{
+    // quoted, with quotes doubled, names like "NOSIZE,NOMOVE" have commas
+    fputc('"', file);
+    for (; *s; s++) {
+        if (*s == '"') fputc('"', file);
+        fputc(*s, file);
+    }
+    fputc('"', file);
+}
+
+static void csv_row(FILE* file, bool first, const char* section, const int32_t* key, const char* name, uint64_t count)
+{
+    (void)first;
+    fprintf(file, "%s,", section);
+    if (key) fprintf(file, "%d", *key);
+    fputc(',', file);
+    csv_string(file, name);
+    fprintf(file, ",%llu\n", (unsigned long long)count);
+}
+
+bool SessionStatsWriteCsv(SessionStats* stats, const StatsNames* names, uint64_t now_ms, FILE* file)
+{
+    StatsRates rates;
+    SessionStatsRates(stats, now_ms, &rates);
+    fprintf(file, "section,key,name,value\n");
+    fprintf(file, "session,0,\"duration_ms\",%llu\n", (unsigned long long)(now_ms - stats->start_ms));
+    fprintf(file, "session,0,\"messages\",%llu\n", (unsigned long long)stats->messages);
+    fprintf(file, "rate,1,\"last_1s\",%.1f\n", rates.last_1s);
+    fprintf(file, "rate,10,\"last_10s\",%.1f\n", rates.last_10s);
+    fprintf(file, "rate,60,\"last_60s\",%.1f\n", rates.last_60s);
+    fprintf(file, "rate,1,\"peak_1s\",%.1f\n", rates.peak_1s);
+    fprintf(file, "rate,0,\"mean\",%.1f\n", rates.mean);
+    emit_all(stats, names, file, csv_row);
+    return !ferror(file);
+}
+
+static void json_string(FILE* file, const char* s)
+{
+    fputc('"', file);
+    for (; *s; s++) {
+        const unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(file, "\\%c", c);
+        else if (c < 0x20) fprintf(file, "\\u%04x", c);
+        else fputc(c, file);
+    }
+    fputc('"', file);
+}
+
+static void json_row(FILE* file, bool first, const char* section, const int32_t* key, const char* name, uint64_t count)
+{
+    fprintf(file, "%s\n    {\"section\": \"%s\", \"key\": ", first ? "" : ",", section);
+    if (key) fprintf(file, "%d", *key);
+    else fprintf(file, "null");
+    fprintf(file, ", \"name\": ");
+    json_string(file, name);
+    fprintf(file, ", \"count\": %llu}", (unsigned long long)count);
+}
+
+bool SessionStatsWriteJson(SessionStats* stats, const StatsNames* names, uint64_t now_ms, FILE* file)
+{
+    StatsRates rates;
+    SessionStatsRates(stats, now_ms, &rates);
+    fprintf(file, "{\n  \"duration_ms\": %llu,\n  \"messages\": %llu,\n",
+        (unsigned long long)(now_ms - stats->start_ms), (unsigned long long)stats->messages);
+    fprintf(file, "  \"rate\": {\"last_1s\": %.1f, \"last_10s\": %.1f, \"last_60s\": %.1f, \"peak_1s\": %.1f, \"mean\": %.1f},\n",
+        rates.last_1s, rates.last_10s, rates.last_60s, rates.peak_1s, rates.mean);
+    fprintf(file, "  \"counts\": [");
+    emit_all(stats, names, file, json_row);
+    fprintf(file, "\n  ]\n}\n");
+    return !ferror(file);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Aggregate counters for one window's session, small enough to stay in
+// cache: a count per message, a few distributions of message parameters
+// and the message rate per second over the last minute.  Exported as CSV
+// or JSON so sessions can be compared without collecting full traces.
+//
+// Times are milliseconds on a clock of the caller's choice.
+
+// messages below this (WM_USER) are counted in a flat array
+#define STATS_DIRECT_MSGS 0x400
+// distinct keys per distribution, the rest only count as overflow
+#define STATS_HISTOGRAM_SLOTS 64
+// the rate is kept per second for this many seconds
+#define STATS_RATE_SECONDS 64
+
+typedef enum {
+    STATS_HIGH_MSGS, // messages from STATS_DIRECT_MSGS up
+    STATS_HIT_TEST,
+    STATS_SWP_FLAGS,
+    STATS_SIZE_TYPE,
+    STATS_IME_NOTIFY,
+    STATS_HISTOGRAM_COUNT,
+} StatsHistogramId;
+
+// A small open-addressed count per key, a slot is taken once its count
+// is non-zero
+typedef struct {
+    uint32_t keys[STATS_HISTOGRAM_SLOTS];
+    uint32_t counts[STATS_HISTOGRAM_SLOTS];
+    uint32_t overflow;
+} StatsHistogram;
+
+typedef struct {
+    uint64_t start_ms;
+    uint64_t messages;
+    uint32_t direct[STATS_DIRECT_MSGS];
+    StatsHistogram histograms[STATS_HISTOGRAM_COUNT];
+    // messages in each of the last seconds, ring indexed by second
+    uint32_t per_second[STATS_RATE_SECONDS];
+    uint64_t second; // the one being counted
+    uint64_t second_end_ms;
+    uint32_t peak_per_second;
+} SessionStats;
+
+typedef struct {
+    double last_1s, last_10s, last_60s; // over whole seconds, the current one excluded
+    double peak_1s;
+    double mean; // over the whole session
+} StatsRates;
+
+// How export names what it counted.  msg names a message; key writes the
+// name of a key in one of the distributions other than STATS_HIGH_MSGS.
+typedef struct {
+    const char* (*msg)(uint32_t msg);
+    void (*key)(StatsHistogramId, uint32_t key, char* out, size_t size);
+} StatsNames;
+
+void SessionStatsInit(SessionStats*, uint64_t now_ms);
+void SessionStatsMessage(SessionStats*, uint32_t msg, uint64_t now_ms);
+void SessionStatsAdd(SessionStats*, StatsHistogramId, uint32_t key);
+uint32_t SessionStatsCount(const SessionStats*, StatsHistogramId, uint32_t key);
+uint32_t SessionStatsMsgCount(const SessionStats*, uint32_t msg);
+// Brings the rate window up to now first, so idle time counts
+void SessionStatsRates(SessionStats*, uint64_t now_ms, StatsRates*);
+// Both return false if writing failed
+bool SessionStatsWriteCsv(SessionStats*, const StatsNames*, uint64_t now_ms, FILE*);
+bool SessionStatsWriteJson(SessionStats*, const StatsNames*, uint64_t now_ms, FILE*);
@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "StartupProfile.h"
+
+void StartupProfileInit(StartupProfile* profile, uint64_t start_ns)
+{
+    memset(profile, 0, sizeof(*profile));
+    profile->start_ns = start_ns;
+}
+
+void StartupProfileMark(StartupProfile* profile, const char* name, uint64_t now_ns)
+{
+    if (profile->done || profile->mark_count == STARTUP_MAX_MARKS) return;
+    StartupMark* mark = &profile->marks[profile->mark_count++];
+    mark->name = name;
+    mark->ns = now_ns;
+}
+
+bool StartupProfileFirst(StartupProfile* profile, uint32_t id, const char* name, uint64_t now_ns)
+{
+    const uint32_t bit = 1u << id;
+    if (profile->done || (profile->seen & bit)) return false;
+    profile->seen |= bit;
+    StartupProfileMark(profile, name, now_ns);
+    return true;
+}
+
+uint64_t StartupProfileFinish(StartupProfile* profile, const char* name, uint64_t now_ns)
+{
+    StartupProfileMark(profile, name, now_ns);
+    profile->done = true;
+    return now_ns - profile->start_ns;
+}
+
+size_t StartupProfileFormat(const StartupProfile* profile, char* out, size_t size)
+{
+    size_t len = 0;
+    uint64_t previous = profile->start_ns;
+    for (uint32_t i = 0; i < profile->mark_count; i++) {
+        const StartupMark* mark = &profile->marks[i];
+        // once out is full snprintf only counts
+        char* at = (len < size) ? out + len : NULL;
+        const int n = snprintf(at, at ? size - len : 0, "%s%9.3f ms  %+9.3f ms  %s",
+            i ? "\n" : "", (mark->ns - profile->start_ns) / 1e6, (mark->ns - previous) / 1e6, mark->name);
+        if (n > 0) len += (size_t)n;
+        previous = mark->ns;
+    }
+    if (!profile->mark_count && size) out[0] = 0;
+    return len;
+}
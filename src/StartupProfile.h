@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A timeline of startup.  Each mark ends the phase that ran since the
+// previous one, so the report reads as a breakdown of where the time from
+// process start to the first frame went.  Timestamps are in nanoseconds on
+// a clock of the caller's choice.
+#define STARTUP_MAX_MARKS 32
+
+typedef struct {
+    const char* name; // not copied, use literals
+    uint64_t ns;
+} StartupMark;
+
+typedef struct {
+    uint64_t start_ns;
+    StartupMark marks[STARTUP_MAX_MARKS];
+    uint32_t mark_count;
+    uint32_t seen; // a bit per id passed to StartupProfileFirst
+    bool done;
+} StartupProfile;
+
+void StartupProfileInit(StartupProfile*, uint64_t start_ns);
+// Marks beyond STARTUP_MAX_MARKS and after StartupProfileFinish are dropped
+void StartupProfileMark(StartupProfile*, const char* name, uint64_t now_ns);
+// Marks only the first call for each id (0-31), for things like the first
+// WM_PAINT.  Returns whether this was it.
+bool StartupProfileFirst(StartupProfile*, uint32_t id, const char* name, uint64_t now_ns);
+// Adds a final mark and stops recording, returns the total
+uint64_t StartupProfileFinish(StartupProfile*, const char* name, uint64_t now_ns);
+// One line per mark: the time since start and the length of the phase it
+// ends.  Returns the length written, like snprintf.
+size_t StartupProfileFormat(const StartupProfile*, char* out, size_t size);
@@ -0,0 +1,417 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "TaskScheduler.h"
+
+#ifdef _WIN32
+#include <windows.h>
+typedef SRWLOCK Mutex;
+typedef CONDITION_VARIABLE Cond;
+typedef HANDLE Thread;
+#define THREAD_LOCAL __declspec(thread)
+static void mutex_init(Mutex* mutex) { InitializeSRWLock(mutex); }
+static void mutex_destroy(Mutex* mutex) { (void)mutex; }
+static void mutex_lock(Mutex* mutex) { AcquireSRWLockExclusive(mutex); }
+static void mutex_unlock(Mutex* mutex) { ReleaseSRWLockExclusive(mutex); }
+static void cond_init(Cond* cond) { InitializeConditionVariable(cond); }
+static void cond_destroy(Cond* cond) { (void)cond; }
+static void cond_wait(Cond* cond, Mutex* mutex) { SleepConditionVariableSRW(cond, mutex, INFINITE, 0); }
+static void cond_broadcast(Cond* cond) { WakeAllConditionVariable(cond); }
+static void cond_signal(Cond* cond) { WakeConditionVariable(cond); }
+static void set_throttled(bool throttled)
+{
+    SetThreadPriority(GetCurrentThread(), throttled ? THREAD_PRIORITY_BELOW_NORMAL : THREAD_PRIORITY_NORMAL);
+}
+// the Interlocked functions are full barriers, and volatile loads can't
+// move before them
+static long atomic_load(volatile long* target) { return *target; }
+static void atomic_store(volatile long* target, long value) { InterlockedExchange(target, value); }
+static long atomic_add(volatile long* target, long value) { return InterlockedExchangeAdd(target, value) + value; }
+static long atomic_cas(volatile long* target, long expected, long desired)
+{
+    return InterlockedCompareExchange(target, desired, expected);
+}
+static void counter_add(volatile uint64_t* counter) { InterlockedIncrement64((volatile LONG64*)counter); }
+static uint64_t counter_load(volatile uint64_t* counter) { return *counter; }
+#else
+#include <pthread.h>
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t Cond;
+typedef pthread_t Thread;
+#define THREAD_LOCAL __thread
+static void mutex_init(Mutex* mutex) { pthread_mutex_init(mutex, NULL); }
+static void mutex_destroy(Mutex* mutex) { pthread_mutex_destroy(mutex); }
+static void mutex_lock(Mutex* mutex) { pthread_mutex_lock(mutex); }
+static void mutex_unlock(Mutex* mutex) { pthread_mutex_unlock(mutex); }
+static void cond_init(Cond* cond) { pthread_cond_init(cond, NULL); }
+static void cond_destroy(Cond* cond) { pthread_cond_destroy(cond); }
+static void cond_wait(Cond* cond, Mutex* mutex) { pthread_cond_wait(cond, mutex); }
+static void cond_broadcast(Cond* cond) { pthread_cond_broadcast(cond); }
+static void cond_signal(Cond* cond) { pthread_cond_signal(cond); }
+// Raising a thread's priority back up needs privileges on Linux, so
+// throttling only limits concurrency there
+static void set_throttled(bool throttled) { (void)throttled; }
+// Sequentially consistent, a worker going to sleep and a thread handing
+// it work each write one counter and then read the other's
+static long atomic_load(volatile long* target) { return __atomic_load_n(target, __ATOMIC_SEQ_CST); }
+static void atomic_store(volatile long* target, long value) { __atomic_store_n(target, value, __ATOMIC_SEQ_CST); }
+static long atomic_add(volatile long* target, long value) { return __atomic_add_fetch(target, value, __ATOMIC_SEQ_CST); }
+static long atomic_cas(volatile long* target, long expected, long desired)
+{
+    __atomic_compare_exchange_n(target, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return expected;
+}
+// only the owning worker writes its counters, others just read them
+static void counter_add(volatile uint64_t* counter) { __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED); }
+static uint64_t counter_load(volatile uint64_t* counter) { return __atomic_load_n(counter, __ATOMIC_RELAXED); }
+#endif
+
+typedef struct {
+    Mutex lock;
+    Task** tasks; // ring buffer
+    uint32_t capacity;
+    uint32_t head;
+    uint32_t count;
+} TaskDeque;
+
+struct TaskWorker {
+    TaskScheduler* scheduler;
+    uint32_t index;
+    Thread thread;
+    TaskDeque deque;
+    volatile uint64_t tasks_run[TASK_STATE_COUNT];
+    volatile uint64_t steals;
+    // keep workers' deques off each other's cache lines
+    char pad[64];
+};
+
+// Workers claim and finish tasks with atomics alone.  The lock is only
+// taken to sleep and wake, to hold back or release render tasks and for
+// the state's bookkeeping.
+struct TaskScheduler {
+    volatile long state; // a TaskState, written under lock
+    volatile long generation; // bumped on every state change
+    volatile long allowed; // how many workers may run tasks in this state
+    volatile long running; // workers holding one of the allowed slots
+    volatile long pending; // tasks in the deques not yet taken, can briefly be off by the ones being pushed or taken
+    volatile long sleepers; // workers waiting on wake
+    volatile long next_worker;
+    volatile long shutdown;
+    uint32_t worker_count;
+    uint32_t throttled_workers;
+    TaskWorker* workers;
+    // protected by lock
+    Mutex lock;
+    Cond wake;
+    Task* held_head;
+    Task* held_tail;
+    uint64_t state_start_ns;
+    uint64_t state_ns[TASK_STATE_COUNT];
+    uint64_t tasks_held;
+};
+
+static THREAD_LOCAL TaskWorker* thread_worker = NULL;
+
+static void deque_push(TaskDeque* deque, Task* task)
+{
+    mutex_lock(&deque->lock);
+    if (deque->count == deque->capacity) {
+        const uint32_t capacity = deque->capacity ? deque->capacity * 2 : 64;
+        Task** tasks = malloc(capacity * sizeof(Task*));
+        if (!tasks) abort();
+        for (uint32_t i = 0; i < deque->count; i++) {
+            tasks[i] = deque->tasks[(deque->head + i) % deque->capacity];
+        }
+        free(deque->tasks);
+        deque->tasks = tasks;
+        deque->capacity = capacity;
+        deque->head = 0;
+    }
+    deque->tasks[(deque->head + deque->count) % deque->capacity] = task;
+    deque->count++;
+    mutex_unlock(&deque->lock);
+}
+
+// the owner takes the newest task, it's the most likely to be in cache
+static Task* deque_pop_newest(TaskDeque* deque)
+{
+    Task* task = NULL;
+    mutex_lock(&deque->lock);
+    if (deque->count > 0) {
+        deque->count--;
+        task = deque->tasks[(deque->head + deque->count) % deque->capacity];
+    }
+    mutex_unlock(&deque->lock);
+    return task;
+}
+
+// thieves take the oldest task, away from where the owner is working
+static Task* deque_pop_oldest(TaskDeque* deque)
+{
+    Task* task = NULL;
+    mutex_lock(&deque->lock);
+    if (deque->count > 0) {
+        task = deque->tasks[deque->head];
+        deque->head = (deque->head + 1) % deque->capacity;
+        deque->count--;
+    }
+    mutex_unlock(&deque->lock);
+    return task;
+}
+
+static void push_task(TaskScheduler* scheduler, Task* task)
+{
+    TaskWorker* target = thread_worker;
+    if (!target || target->scheduler != scheduler) {
+        const uint32_t next = (uint32_t)atomic_add(&scheduler->next_worker, 1);
+        target = &scheduler->workers[next % scheduler->worker_count];
+    }
+    deque_push(&target->deque, task);
+    atomic_add(&scheduler->pending, 1);
+}
+
+// A sleeping worker registers in sleepers under the lock and then checks
+// pending and running again before it waits.  Whoever changes those
+// checks sleepers after, so one of the two always sees the other.
+static void wake_sleeper(TaskScheduler* scheduler)
+{
+    if (atomic_load(&scheduler->sleepers) == 0 || atomic_load(&scheduler->pending) <= 0) return;
+    mutex_lock(&scheduler->lock);
+    cond_signal(&scheduler->wake);
+    mutex_unlock(&scheduler->lock);
+}
+
+// Must hold scheduler->lock
+static void hold_locked(TaskScheduler* scheduler, Task* task)
+{
+    task->next = NULL;
+    if (scheduler->held_tail) scheduler->held_tail->next = task;
+    else scheduler->held_head = task;
+    scheduler->held_tail = task;
+    scheduler->tasks_held++;
+}
+
+// Holds a render task back if the window is still minimized, the state
+// may have changed since the caller looked
+static bool hold_if_minimized(TaskScheduler* scheduler, Task* task)
+{
+    mutex_lock(&scheduler->lock);
+    const bool hold = (atomic_load(&scheduler->state) == TASK_STATE_MINIMIZED);
+    if (hold) hold_locked(scheduler, task);
+    mutex_unlock(&scheduler->lock);
+    return hold;
+}
+
+static bool claim_slot(TaskScheduler* scheduler)
+{
+    long running = atomic_load(&scheduler->running);
+    while (running < atomic_load(&scheduler->allowed)) {
+        const long previous = atomic_cas(&scheduler->running, running, running + 1);
+        if (previous == running) return true;
+        running = previous;
+    }
+    return false;
+}
+
+static void release_slot(TaskScheduler* scheduler)
+{
+    atomic_add(&scheduler->running, -1);
+    wake_sleeper(scheduler);
+}
+
+// The worker's own newest task, else the oldest task of the first other
+// worker that has one.  NULL if every deque is empty.
+static Task* take_task(TaskWorker* worker, bool* stole)
+{
+    TaskScheduler* scheduler = worker->scheduler;
+    Task* task = deque_pop_newest(&worker->deque);
+    *stole = false;
+    for (uint32_t i = 1; !task && i < scheduler->worker_count; i++) {
+        task = deque_pop_oldest(&scheduler->workers[(worker->index + i) % scheduler->worker_count].deque);
+        *stole = true;
+    }
+    return task;
+}
+
+static void worker_main(TaskWorker* worker)
+{
+    TaskScheduler* scheduler = worker->scheduler;
+    thread_worker = worker;
+
+    // start out different so the first task sets the thread priority
+    long generation = atomic_load(&scheduler->generation) - 1;
+    while (!atomic_load(&scheduler->shutdown)) {
+        if (atomic_load(&scheduler->pending) > 0 && claim_slot(scheduler)) {
+            bool stole;
+            Task* task = take_task(worker, &stole);
+            if (task) {
+                atomic_add(&scheduler->pending, -1);
+                if (stole) counter_add(&worker->steals);
+                const long current = atomic_load(&scheduler->generation);
+                const TaskState state = (TaskState)atomic_load(&scheduler->state);
+                if (current != generation) {
+                    generation = current;
+                    set_throttled(state != TASK_STATE_ACTIVE);
+                }
+                const bool held = (task->kind == TASK_KIND_RENDER && state == TASK_STATE_MINIMIZED &&
+                    hold_if_minimized(scheduler, task));
+                if (!held) {
+                    task->run(task);
+                    counter_add(&worker->tasks_run[state]);
+                }
+                release_slot(scheduler);
+                continue;
+            }
+            // taken by another worker between the check and the claim
+            release_slot(scheduler);
+        }
+
+        mutex_lock(&scheduler->lock);
+        atomic_add(&scheduler->sleepers, 1);
+        while (!atomic_load(&scheduler->shutdown) && (atomic_load(&scheduler->pending) <= 0 ||
+            atomic_load(&scheduler->running) >= atomic_load(&scheduler->allowed))) {
+            cond_wait(&scheduler->wake, &scheduler->lock);
+        }
+        atomic_add(&scheduler->sleepers, -1);
+        mutex_unlock(&scheduler->lock);
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker_entry(void* param)
+{
+    worker_main((TaskWorker*)param);
+    return 0;
+}
+static void thread_start(TaskWorker* worker)
+{
+    worker->thread = CreateThread(NULL, 0, worker_entry, worker, 0, NULL);
+    if (!worker->thread) abort();
+}
+static void thread_join(TaskWorker* worker)
+{
+    WaitForSingleObject(worker->thread, INFINITE);
+    CloseHandle(worker->thread);
+}
+#else
+static void* worker_entry(void* param)
+{
+    worker_main((TaskWorker*)param);
+    return NULL;
+}
+static void thread_start(TaskWorker* worker)
+{
+    if (pthread_create(&worker->thread, NULL, worker_entry, worker) != 0) abort();
+}
+static void thread_join(TaskWorker* worker)
+{
+    pthread_join(worker->thread, NULL);
+}
+#endif
+
+TaskScheduler* TaskSchedulerCreate(uint32_t worker_count, uint32_t throttled_workers, uint64_t now_ns)
+{
+    if (worker_count == 0) worker_count = 1;
+    if (throttled_workers == 0) throttled_workers = 1;
+    if (throttled_workers > worker_count) throttled_workers = worker_count;
+
+    TaskScheduler* scheduler = calloc(1, sizeof(TaskScheduler));
+    TaskWorker* workers = calloc(worker_count, sizeof(TaskWorker));
+    if (!scheduler || !workers) abort();
+    mutex_init(&scheduler->lock);
+    cond_init(&scheduler->wake);
+    scheduler->state = TASK_STATE_INACTIVE;
+    scheduler->worker_count = worker_count;
+    scheduler->throttled_workers = throttled_workers;
+    scheduler->allowed = (long)throttled_workers;
+    scheduler->state_start_ns = now_ns;
+    scheduler->workers = workers;
+    for (uint32_t i = 0; i < worker_count; i++) {
+        workers[i].scheduler = scheduler;
+        workers[i].index = i;
+        mutex_init(&workers[i].deque.lock);
+    }
+    for (uint32_t i = 0; i < worker_count; i++) {
+        thread_start(&workers[i]);
+    }
+    return scheduler;
+}
+
+void TaskSchedulerDestroy(TaskScheduler* scheduler)
+{
+    mutex_lock(&scheduler->lock);
+    atomic_store(&scheduler->shutdown, 1);
+    cond_broadcast(&scheduler->wake);
+    mutex_unlock(&scheduler->lock);
+    for (uint32_t i = 0; i < scheduler->worker_count; i++) {
+        thread_join(&scheduler->workers[i]);
+        free(scheduler->workers[i].deque.tasks);
+        mutex_destroy(&scheduler->workers[i].deque.lock);
+    }
+    cond_destroy(&scheduler->wake);
+    mutex_destroy(&scheduler->lock);
+    free(scheduler->workers);
+    free(scheduler);
+}
+
+void TaskSchedulerSubmit(TaskScheduler* scheduler, Task* task)
+{
+    if (task->kind == TASK_KIND_RENDER && atomic_load(&scheduler->state) == TASK_STATE_MINIMIZED &&
+        hold_if_minimized(scheduler, task)) {
+        return;
+    }
+    // a worker that takes it while minimized holds it then
+    push_task(scheduler, task);
+    wake_sleeper(scheduler);
+}
+
+void TaskSchedulerSetState(TaskScheduler* scheduler, TaskState state, uint64_t now_ns)
+{
+    mutex_lock(&scheduler->lock);
+    const TaskState previous = (TaskState)scheduler->state;
+    if (state != previous) {
+        scheduler->state_ns[previous] += now_ns - scheduler->state_start_ns;
+        scheduler->state_start_ns = now_ns;
+        atomic_store(&scheduler->state, state);
+        atomic_add(&scheduler->generation, 1);
+        atomic_store(&scheduler->allowed,
+            (long)((state == TASK_STATE_ACTIVE) ? scheduler->worker_count : scheduler->throttled_workers));
+        if (state != TASK_STATE_MINIMIZED) {
+            while (scheduler->held_head) {
+                Task* task = scheduler->held_head;
+                scheduler->held_head = task->next;
+                push_task(scheduler, task);
+            }
+            scheduler->held_tail = NULL;
+        }
+        cond_broadcast(&scheduler->wake);
+    }
+    mutex_unlock(&scheduler->lock);
+}
+
+void TaskSchedulerGetStats(TaskScheduler* scheduler, uint64_t now_ns, TaskSchedulerStats* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    mutex_lock(&scheduler->lock);
+    for (uint32_t state = 0; state < TASK_STATE_COUNT; state++) stats->state_ns[state] = scheduler->state_ns[state];
+    stats->state_ns[scheduler->state] += now_ns - scheduler->state_start_ns;
+    stats->tasks_held = scheduler->tasks_held;
+    mutex_unlock(&scheduler->lock);
+    for (uint32_t i = 0; i < scheduler->worker_count; i++) {
+        TaskWorker* worker = &scheduler->workers[i];
+        for (uint32_t state = 0; state < TASK_STATE_COUNT; state++) {
+            stats->tasks_run[state] += counter_load(&worker->tasks_run[state]);
+        }
+        stats->steals += counter_load(&worker->steals);
+    }
+}
+
+const char* TaskStateName(TaskState state)
+{
+    switch (state) {
+    case TASK_STATE_ACTIVE: return "ACTIVE";
+    case TASK_STATE_INACTIVE: return "INACTIVE";
+    case TASK_STATE_MINIMIZED: return "MINIMIZED";
+    default: return "?";
+    }
+}
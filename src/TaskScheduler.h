@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Background task pool that reacts to the window's activation state.
+// Each worker has its own deque, it runs its own tasks newest first and
+// steals the oldest task from another worker when it runs out.
+//
+// How many workers may run tasks at once depends on the state:
+//   ACTIVE     every worker
+//   INACTIVE   throttled_workers, at a lower thread priority
+//   MINIMIZED  throttled_workers, TASK_KIND_RENDER tasks are held back
+//              until the window is restored
+typedef enum {
+    TASK_STATE_ACTIVE,
+    TASK_STATE_INACTIVE,
+    TASK_STATE_MINIMIZED,
+    TASK_STATE_COUNT,
+} TaskState;
+
+typedef enum {
+    TASK_KIND_BACKGROUND,
+    TASK_KIND_RENDER,
+} TaskKind;
+
+typedef struct Task {
+    struct Task* next; // used while the task is held back
+    TaskKind kind;
+    void (*run)(struct Task*);
+} Task;
+
+typedef struct {
+    uint64_t state_ns[TASK_STATE_COUNT];
+    uint64_t tasks_run[TASK_STATE_COUNT]; // by the state when the task started
+    uint64_t tasks_held; // render tasks held back while minimized
+    uint64_t steals;
+} TaskSchedulerStats;
+
+typedef struct TaskWorker TaskWorker;
+typedef struct TaskScheduler TaskScheduler;
+
+// Starts the workers.  The scheduler starts out INACTIVE.
+TaskScheduler* TaskSchedulerCreate(uint32_t worker_count, uint32_t throttled_workers, uint64_t now_ns);
+// Stops the workers once they finish the task they're running, queued
+// tasks are dropped
+void TaskSchedulerDestroy(TaskScheduler*);
+// Can be called from any thread, including from inside a task
+void TaskSchedulerSubmit(TaskScheduler*, Task*);
+void TaskSchedulerSetState(TaskScheduler*, TaskState, uint64_t now_ns);
+// state_ns includes the time spent in the current state up to now_ns
+void TaskSchedulerGetStats(TaskScheduler*, uint64_t now_ns, TaskSchedulerStats*);
+const char* TaskStateName(TaskState);
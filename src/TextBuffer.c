@@ -0,0 +1,329 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "TextBuffer.h"
+
+static void* xrealloc(void* ptr, size_t size)
+{
+    void* result = realloc(ptr, size);
+    if (!result) abort();
+    return result;
+}
+
+struct TextPiece {
+    TextPiece* left;
+    TextPiece* right;
+    uint32_t priority; // max-heap, random so the tree stays balanced
+    uint32_t store;
+    size_t start;
+    size_t length;
+    size_t newlines;
+    // this piece and everything below it
+    size_t total_length;
+    size_t total_newlines;
+};
+
+// --------------------------------------------------------------------------------
+// Stores
+// --------------------------------------------------------------------------------
+
+static void store_append(TextStore* store, const TextChar* text, size_t length)
+{
+    if (store->length + length > store->capacity) {
+        size_t capacity = store->capacity ? store->capacity * 2 : 4096;
+        while (capacity < store->length + length) capacity *= 2;
+        store->text = xrealloc(store->text, capacity * sizeof(TextChar));
+        store->capacity = capacity;
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] != '\n') continue;
+        if (store->newline_count == store->newline_capacity) {
+            store->newline_capacity = store->newline_capacity ? store->newline_capacity * 2 : 256;
+            store->newlines = xrealloc(store->newlines, store->newline_capacity * sizeof(size_t));
+        }
+        store->newlines[store->newline_count++] = store->length + i;
+    }
+    memcpy(store->text + store->length, text, length * sizeof(TextChar));
+    store->length += length;
+}
+
+// the index of the first newline at or after offset
+static size_t newline_index(const TextStore* store, size_t offset)
+{
+    size_t lo = 0, hi = store->newline_count;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (store->newlines[mid] < offset) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static size_t count_newlines(const TextStore* store, size_t start, size_t end)
+{
+    return newline_index(store, end) - newline_index(store, start);
+}
+
+// --------------------------------------------------------------------------------
+// Treap
+// --------------------------------------------------------------------------------
+
+static size_t total_length(const TextPiece* piece) { return piece ? piece->total_length : 0; }
+static size_t total_newlines(const TextPiece* piece) { return piece ? piece->total_newlines : 0; }
+
+static void update(TextPiece* piece)
+{
+    piece->total_length = total_length(piece->left) + piece->length + total_length(piece->right);
+    piece->total_newlines = total_newlines(piece->left) + piece->newlines + total_newlines(piece->right);
+}
+
+static uint32_t next_priority(TextBuffer* buffer)
+{
+    buffer->rng ^= buffer->rng << 13;
+    buffer->rng ^= buffer->rng >> 17;
+    buffer->rng ^= buffer->rng << 5;
+    return buffer->rng;
+}
+
+static TextPiece* new_piece(TextBuffer* buffer, uint32_t store, size_t start, size_t length, uint32_t priority)
+{
+    TextPiece* piece = xrealloc(NULL, sizeof(TextPiece));
+    piece->left = NULL;
+    piece->right = NULL;
+    piece->priority = priority;
+    piece->store = store;
+    piece->start = start;
+    piece->length = length;
+    piece->newlines = count_newlines(&buffer->stores[store], start, start + length);
+    update(piece);
+    return piece;
+}
+
+static void free_tree(TextPiece* piece)
+{
+    if (!piece) return;
+    free_tree(piece->left);
+    free_tree(piece->right);
+    free(piece);
+}
+
+// Splits off the first offset code units into *left and the rest into
+// *right, cutting the piece that straddles offset in two
+static void split(TextBuffer* buffer, TextPiece* piece, size_t offset, TextPiece** left, TextPiece** right)
+{
+    if (!piece) {
+        *left = NULL;
+        *right = NULL;
+        return;
+    }
+    const size_t left_length = total_length(piece->left);
+    if (offset <= left_length) {
+        split(buffer, piece->left, offset, left, &piece->left);
+        update(piece);
+        *right = piece;
+    } else if (offset >= left_length + piece->length) {
+        split(buffer, piece->right, offset - left_length - piece->length, &piece->right, right);
+        update(piece);
+        *left = piece;
+    } else {
+        // the tail takes over the right subtree, with the same priority it
+        // is still above everything in it
+        const size_t cut = offset - left_length;
+        TextPiece* tail = new_piece(buffer, piece->store, piece->start + cut, piece->length - cut, piece->priority);
+        tail->right = piece->right;
+        update(tail);
+        piece->length = cut;
+        piece->newlines -= tail->newlines;
+        piece->right = NULL;
+        update(piece);
+        *left = piece;
+        *right = tail;
+    }
+}
+
+static TextPiece* merge(TextPiece* left, TextPiece* right)
+{
+    if (!left) return right;
+    if (!right) return left;
+    if (left->priority > right->priority) {
+        left->right = merge(left->right, right);
+        update(left);
+        return left;
+    }
+    right->left = merge(left, right->left);
+    update(right);
+    return right;
+}
+
+// --------------------------------------------------------------------------------
+// Buffer
+// --------------------------------------------------------------------------------
+
+void TextBufferInit(TextBuffer* buffer, const TextChar* text, size_t length)
+{
+    memset(buffer, 0, sizeof(*buffer));
+    buffer->rng = 0x9e3779b9;
+    if (length) {
+        store_append(&buffer->stores[0], text, length);
+        buffer->root = new_piece(buffer, 0, 0, length, next_priority(buffer));
+    }
+}
+
+void TextBufferFree(TextBuffer* buffer)
+{
+    free_tree(buffer->root);
+    for (int i = 0; i < 2; i++) {
+        free(buffer->stores[i].text);
+        free(buffer->stores[i].newlines);
+    }
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+size_t TextBufferLength(const TextBuffer* buffer)
+{
+    return total_length(buffer->root);
+}
+
+size_t TextBufferLineCount(const TextBuffer* buffer)
+{
+    return total_newlines(buffer->root) + 1;
+}
+
+void TextBufferInsert(TextBuffer* buffer, size_t offset, const TextChar* text, size_t length)
+{
+    if (!length) return;
+    TextStore* store = &buffer->stores[1];
+    const size_t start = store->length;
+    store_append(store, text, length);
+
+    TextPiece *left, *right;
+    split(buffer, buffer->root, offset, &left, &right);
+    // Typing appends to the store right where the previous insert ended, so
+    // the piece before the caret just grows.  It's the last piece in left,
+    // every node on the way down the right spine gets the new text.
+    TextPiece* last = left;
+    while (last && last->right) last = last->right;
+    if (last && last->store == 1 && last->start + last->length == start) {
+        const size_t newlines = count_newlines(store, start, start + length);
+        last->length += length;
+        last->newlines += newlines;
+        for (TextPiece* piece = left; piece; piece = piece->right) {
+            piece->total_length += length;
+            piece->total_newlines += newlines;
+        }
+    } else {
+        left = merge(left, new_piece(buffer, 1, start, length, next_priority(buffer)));
+    }
+    buffer->root = merge(left, right);
+}
+
+void TextBufferDelete(TextBuffer* buffer, size_t offset, size_t length)
+{
+    if (!length) return;
+    TextPiece *left, *middle, *right;
+    split(buffer, buffer->root, offset, &left, &right);
+    split(buffer, right, length, &middle, &right);
+    free_tree(middle);
+    buffer->root = merge(left, right);
+}
+
+TextChar TextBufferCharAt(const TextBuffer* buffer, size_t offset)
+{
+    const TextPiece* piece = buffer->root;
+    while (piece) {
+        const size_t left_length = total_length(piece->left);
+        if (offset < left_length) {
+            piece = piece->left;
+            continue;
+        }
+        offset -= left_length;
+        if (offset < piece->length) return buffer->stores[piece->store].text[piece->start + offset];
+        offset -= piece->length;
+        piece = piece->right;
+    }
+    return 0;
+}
+
+static size_t copy_range(const TextBuffer* buffer, const TextPiece* piece, size_t offset, size_t length, TextChar* out)
+{
+    if (!piece || !length) return 0;
+    size_t copied = 0;
+    const size_t left_length = total_length(piece->left);
+    if (offset < left_length) {
+        copied = copy_range(buffer, piece->left, offset, length, out);
+        offset = left_length;
+    }
+    offset -= left_length;
+    if (copied < length && offset < piece->length) {
+        size_t count = piece->length - offset;
+        if (count > length - copied) count = length - copied;
+        memcpy(out + copied, buffer->stores[piece->store].text + piece->start + offset, count * sizeof(TextChar));
+        copied += count;
+    }
+    if (copied < length) {
+        const size_t right_offset = (offset > piece->length) ? offset - piece->length : 0;
+        copied += copy_range(buffer, piece->right, right_offset, length - copied, out + copied);
+    }
+    return copied;
+}
+
+size_t TextBufferCopy(const TextBuffer* buffer, size_t offset, size_t length, TextChar* out)
+{
+    return copy_range(buffer, buffer->root, offset, length, out);
+}
+
+size_t TextBufferLineStart(const TextBuffer* buffer, size_t line)
+{
+    if (line == 0) return 0;
+    // find the line-th newline, the line starts right after it
+    size_t offset = 0;
+    const TextPiece* piece = buffer->root;
+    while (piece) {
+        const size_t left_newlines = total_newlines(piece->left);
+        if (line <= left_newlines) {
+            piece = piece->left;
+            continue;
+        }
+        line -= left_newlines;
+        offset += total_length(piece->left);
+        if (line <= piece->newlines) {
+            const TextStore* store = &buffer->stores[piece->store];
+            const size_t newline = store->newlines[newline_index(store, piece->start) + line - 1];
+            return offset + (newline - piece->start) + 1;
+        }
+        line -= piece->newlines;
+        offset += piece->length;
+        piece = piece->right;
+    }
+    return offset;
+}
+
+size_t TextBufferLineLength(const TextBuffer* buffer, size_t line)
+{
+    const size_t start = TextBufferLineStart(buffer, line);
+    if (line + 1 >= TextBufferLineCount(buffer)) return TextBufferLength(buffer) - start;
+    return TextBufferLineStart(buffer, line + 1) - 1 - start;
+}
+
+size_t TextBufferLineOf(const TextBuffer* buffer, size_t offset)
+{
+    // count the newlines before offset
+    size_t line = 0;
+    const TextPiece* piece = buffer->root;
+    while (piece) {
+        const size_t left_length = total_length(piece->left);
+        if (offset < left_length) {
+            piece = piece->left;
+            continue;
+        }
+        offset -= left_length;
+        line += total_newlines(piece->left);
+        if (offset < piece->length) {
+            return line + count_newlines(&buffer->stores[piece->store], piece->start, piece->start + offset);
+        }
+        offset -= piece->length;
+        line += piece->newlines;
+        piece = piece->right;
+    }
+    return line;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Piece table.  The text is never moved once stored: the original text and
+// everything inserted since live in two append-only stores and the document
+// is a sequence of pieces pointing into them.  The pieces are kept in a
+// treap ordered by document position, each node also holds the length and
+// newline count of its subtree, so edits and offset/line lookups are
+// O(log pieces) no matter how large the document is.
+//
+// Text is UTF-16 code units, lines are separated by '\n'.
+typedef uint16_t TextChar;
+
+typedef struct {
+    TextChar* text;
+    size_t length;
+    size_t capacity;
+    // the offset of every '\n' in text, ascending.  Kept up to date as text
+    // is appended so a piece's newlines are counted by binary search.
+    size_t* newlines;
+    size_t newline_count;
+    size_t newline_capacity;
+} TextStore;
+
+typedef struct TextPiece TextPiece;
+
+typedef struct {
+    TextStore stores[2]; // the original text, then everything inserted
+    TextPiece* root;
+    uint32_t rng;
+} TextBuffer;
+
+void TextBufferInit(TextBuffer*, const TextChar* text, size_t length);
+void TextBufferFree(TextBuffer*);
+size_t TextBufferLength(const TextBuffer*);
+size_t TextBufferLineCount(const TextBuffer*);
+void TextBufferInsert(TextBuffer*, size_t offset, const TextChar* text, size_t length);
+void TextBufferDelete(TextBuffer*, size_t offset, size_t length);
+TextChar TextBufferCharAt(const TextBuffer*, size_t offset);
+// Copies up to length code units starting at offset, returns how many
+size_t TextBufferCopy(const TextBuffer*, size_t offset, size_t length, TextChar* out);
+// The offset the line starts at, the length for lines past the end
+size_t TextBufferLineStart(const TextBuffer*, size_t line);
+// Not counting the '\n'
+size_t TextBufferLineLength(const TextBuffer*, size_t line);
+// The line the code unit at offset is on
+size_t TextBufferLineOf(const TextBuffer*, size_t offset);
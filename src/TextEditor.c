@@ -0,0 +1,159 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "TextEditor.h"
+
+static void* xrealloc(void* ptr, size_t size)
+{
+    void* result = realloc(ptr, size);
+    if (!result) abort();
+    return result;
+}
+
+static bool is_high_surrogate(TextChar c) { return c >= 0xd800 && c <= 0xdbff; }
+static bool is_low_surrogate(TextChar c) { return c >= 0xdc00 && c <= 0xdfff; }
+
+static void mark_dirty(TextEditor* editor, size_t first, size_t last)
+{
+    if (!editor->dirty) {
+        editor->dirty = true;
+        editor->dirty_first = first;
+        editor->dirty_last = last;
+        return;
+    }
+    if (first < editor->dirty_first) editor->dirty_first = first;
+    if (last > editor->dirty_last) editor->dirty_last = last;
+}
+
+static void set_caret(TextEditor* editor, size_t caret)
+{
+    editor->caret = caret;
+    editor->caret_line = TextBufferLineOf(&editor->buffer, caret);
+    editor->caret_column = caret - TextBufferLineStart(&editor->buffer, editor->caret_line);
+}
+
+void TextEditorInit(TextEditor* editor, const TextChar* text, size_t length)
+{
+    memset(editor, 0, sizeof(*editor));
+    TextBufferInit(&editor->buffer, text, length);
+}
+
+void TextEditorFree(TextEditor* editor)
+{
+    TextBufferFree(&editor->buffer);
+    free(editor->composition);
+    memset(editor, 0, sizeof(*editor));
+}
+
+void TextEditorInsert(TextEditor* editor, const TextChar* text, size_t length)
+{
+    if (!length) return;
+    const size_t line = editor->caret_line;
+    const size_t lines = TextBufferLineCount(&editor->buffer);
+    TextBufferInsert(&editor->buffer, editor->caret, text, length);
+    // a new line moves every line below it down
+    mark_dirty(editor, line, (TextBufferLineCount(&editor->buffer) == lines) ? line : TEXT_LINES_TO_END);
+    set_caret(editor, editor->caret + length);
+    editor->preferred_column = editor->caret_column;
+}
+
+static void delete_range(TextEditor* editor, size_t start, size_t end)
+{
+    if (start >= end) return;
+    const size_t first = TextBufferLineOf(&editor->buffer, start);
+    const size_t lines = TextBufferLineCount(&editor->buffer);
+    TextBufferDelete(&editor->buffer, start, end - start);
+    mark_dirty(editor, first, (TextBufferLineCount(&editor->buffer) == lines) ? first : TEXT_LINES_TO_END);
+    set_caret(editor, start);
+    editor->preferred_column = editor->caret_column;
+}
+
+// the offset one character before or after offset, a surrogate pair
+// counts as one character
+static size_t previous_char(const TextBuffer* buffer, size_t offset)
+{
+    if (offset == 0) return 0;
+    offset--;
+    if (offset > 0 && is_low_surrogate(TextBufferCharAt(buffer, offset)) &&
+        is_high_surrogate(TextBufferCharAt(buffer, offset - 1))) {
+        offset--;
+    }
+    return offset;
+}
+static size_t next_char(const TextBuffer* buffer, size_t offset)
+{
+    const size_t length = TextBufferLength(buffer);
+    if (offset >= length) return length;
+    offset++;
+    if (offset < length && is_high_surrogate(TextBufferCharAt(buffer, offset - 1)) &&
+        is_low_surrogate(TextBufferCharAt(buffer, offset))) {
+        offset++;
+    }
+    return offset;
+}
+
+void TextEditorBackspace(TextEditor* editor)
+{
+    delete_range(editor, previous_char(&editor->buffer, editor->caret), editor->caret);
+}
+
+void TextEditorDelete(TextEditor* editor)
+{
+    delete_range(editor, editor->caret, next_char(&editor->buffer, editor->caret));
+}
+
+void TextEditorMove(TextEditor* editor, TextMove move)
+{
+    const TextBuffer* buffer = &editor->buffer;
+    size_t line = editor->caret_line;
+    switch (move) {
+    case TEXT_MOVE_LEFT: set_caret(editor, previous_char(buffer, editor->caret)); break;
+    case TEXT_MOVE_RIGHT: set_caret(editor, next_char(buffer, editor->caret)); break;
+    case TEXT_MOVE_UP:
+    case TEXT_MOVE_DOWN: {
+        if (move == TEXT_MOVE_UP) {
+            if (line == 0) return;
+            line--;
+        } else {
+            if (line + 1 >= TextBufferLineCount(buffer)) return;
+            line++;
+        }
+        const size_t length = TextBufferLineLength(buffer, line);
+        const size_t column = (editor->preferred_column < length) ? editor->preferred_column : length;
+        editor->caret = TextBufferLineStart(buffer, line) + column;
+        editor->caret_line = line;
+        editor->caret_column = column;
+        // keeps the preferred column so moving through a short line
+        // doesn't lose it
+        return;
+    }
+    case TEXT_MOVE_LINE_START: set_caret(editor, TextBufferLineStart(buffer, line)); break;
+    case TEXT_MOVE_LINE_END: set_caret(editor, TextBufferLineStart(buffer, line) + TextBufferLineLength(buffer, line)); break;
+    case TEXT_MOVE_DOCUMENT_START: set_caret(editor, 0); break;
+    case TEXT_MOVE_DOCUMENT_END: set_caret(editor, TextBufferLength(buffer)); break;
+    }
+    editor->preferred_column = editor->caret_column;
+}
+
+void TextEditorSetComposition(TextEditor* editor, const TextChar* text, size_t length, size_t caret)
+{
+    if (!length && !editor->composition_length) return;
+    if (length > editor->composition_capacity) {
+        editor->composition = xrealloc(editor->composition, length * sizeof(TextChar));
+        editor->composition_capacity = length;
+    }
+    if (length) memcpy(editor->composition, text, length * sizeof(TextChar));
+    editor->composition_length = length;
+    editor->composition_caret = (caret < length) ? caret : length;
+    // drawn inline on the caret's line
+    mark_dirty(editor, editor->caret_line, editor->caret_line);
+}
+
+bool TextEditorTakeDirty(TextEditor* editor, size_t* first, size_t* last)
+{
+    if (!editor->dirty) return false;
+    *first = editor->dirty_first;
+    *last = editor->dirty_last;
+    editor->dirty = false;
+    return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "TextBuffer.h"
+
+// Editing state on top of a TextBuffer: the caret, the IME composition
+// in progress and which lines need repainting.  Every operation is
+// O(log pieces) so it stays fast on multi-megabyte documents.
+typedef enum {
+    TEXT_MOVE_LEFT,
+    TEXT_MOVE_RIGHT,
+    TEXT_MOVE_UP,
+    TEXT_MOVE_DOWN,
+    TEXT_MOVE_LINE_START,
+    TEXT_MOVE_LINE_END,
+    TEXT_MOVE_DOCUMENT_START,
+    TEXT_MOVE_DOCUMENT_END,
+} TextMove;
+
+// last line of a dirty range when everything below the first line moved
+#define TEXT_LINES_TO_END SIZE_MAX
+
+typedef struct {
+    TextBuffer buffer;
+    size_t caret; // offset in the buffer
+    size_t caret_line;
+    size_t caret_column;
+    // the column up and down try to keep, the one the caret was last put at
+    size_t preferred_column;
+    // Text the IME is composing, shown at the caret but not in the buffer
+    // until it's committed with TextEditorInsert
+    TextChar* composition;
+    size_t composition_length;
+    size_t composition_capacity;
+    size_t composition_caret;
+    bool dirty;
+    size_t dirty_first;
+    size_t dirty_last;
+} TextEditor;
+
+void TextEditorInit(TextEditor*, const TextChar* text, size_t length);
+void TextEditorFree(TextEditor*);
+// Inserts at the caret and moves the caret past the text
+void TextEditorInsert(TextEditor*, const TextChar* text, size_t length);
+void TextEditorBackspace(TextEditor*);
+void TextEditorDelete(TextEditor*);
+void TextEditorMove(TextEditor*, TextMove);
+// Replaces the composition, a zero length ends it
+void TextEditorSetComposition(TextEditor*, const TextChar* text, size_t length, size_t caret);
+// Returns false if nothing changed since the last call.  last may be
+// TEXT_LINES_TO_END.
+bool TextEditorTakeDirty(TextEditor*, size_t* first, size_t* last);
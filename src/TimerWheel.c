@@ -0,0 +1,192 @@
+#include <stddef.h>
+
+#include "TimerWheel.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+static uint32_t count_trailing_zeros(uint64_t value)
+{
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return index;
+}
+#else
+static uint32_t count_trailing_zeros(uint64_t value)
+{
+    return (uint32_t)__builtin_ctzll(value);
+}
+#endif
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define MAX_DELTA ((UINT64_C(1) << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+static void list_init(TimerLink* head)
+{
+    head->next = head;
+    head->prev = head;
+}
+static bool list_empty(const TimerLink* head)
+{
+    return head->next == head;
+}
+static void list_push(TimerLink* head, TimerLink* link)
+{
+    link->prev = head->prev;
+    link->next = head;
+    head->prev->next = link;
+    head->prev = link;
+}
+static void list_unlink(TimerLink* link)
+{
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    link->next = NULL;
+    link->prev = NULL;
+}
+// moves every link from src to the empty list dst
+static void list_take(TimerLink* dst, TimerLink* src)
+{
+    if (list_empty(src)) {
+        list_init(dst);
+        return;
+    }
+    dst->next = src->next;
+    dst->prev = src->prev;
+    dst->next->prev = dst;
+    dst->prev->next = dst;
+    list_init(src);
+}
+
+void TimerWheelInit(TimerWheel* wheel, uint64_t now)
+{
+    wheel->now = now;
+    wheel->count = 0;
+    for (uint32_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        wheel->occupied[level] = 0;
+        for (uint32_t slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            list_init(&wheel->slots[level][slot]);
+        }
+    }
+}
+
+static void place(TimerWheel* wheel, Timer* timer)
+{
+    uint32_t level = 0, slot;
+    if (timer->expires < wheel->now) {
+        slot = wheel->now & SLOT_MASK;
+    } else {
+        uint64_t delta = timer->expires - wheel->now;
+        uint64_t expires = timer->expires;
+        if (delta > MAX_DELTA) {
+            delta = MAX_DELTA;
+            expires = wheel->now + MAX_DELTA;
+        }
+        while (delta >> (TIMER_WHEEL_BITS * (level + 1))) level++;
+        slot = (expires >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK;
+    }
+    timer->slot = level * TIMER_WHEEL_SLOTS + slot;
+    list_push(&wheel->slots[level][slot], &timer->link);
+    wheel->occupied[level] |= UINT64_C(1) << slot;
+}
+
+void TimerWheelAdd(TimerWheel* wheel, Timer* timer, uint64_t expires)
+{
+    timer->expires = expires;
+    place(wheel, timer);
+    wheel->count++;
+}
+
+void TimerWheelCancel(TimerWheel* wheel, Timer* timer)
+{
+    if (!TimerIsPending(timer)) return;
+    list_unlink(&timer->link);
+    wheel->count--;
+    // the timer may have already been taken out of its slot to fire, in
+    // which case the slot is either empty or holds newer timers
+    const uint32_t level = timer->slot / TIMER_WHEEL_SLOTS;
+    const uint32_t slot = timer->slot % TIMER_WHEEL_SLOTS;
+    if (list_empty(&wheel->slots[level][slot])) {
+        wheel->occupied[level] &= ~(UINT64_C(1) << slot);
+    }
+}
+
+bool TimerIsPending(const Timer* timer)
+{
+    return timer->link.next != NULL;
+}
+
+// Re-places every timer in a higher level slot whose range has come up,
+// they land in lower levels
+static void cascade(TimerWheel* wheel, uint32_t level, uint32_t slot)
+{
+    TimerLink list;
+    list_take(&list, &wheel->slots[level][slot]);
+    wheel->occupied[level] &= ~(UINT64_C(1) << slot);
+    while (!list_empty(&list)) {
+        Timer* timer = (Timer*)list.next;
+        list_unlink(&timer->link);
+        place(wheel, timer);
+    }
+}
+
+uint32_t TimerWheelAdvance(TimerWheel* wheel, uint64_t now)
+{
+    uint32_t fired = 0;
+    while (wheel->now <= now) {
+        if (wheel->count == 0) {
+            wheel->now = now + 1;
+            break;
+        }
+        const uint32_t index = wheel->now & SLOT_MASK;
+        if (index == 0) {
+            for (uint32_t level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+                const uint32_t slot = (wheel->now >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK;
+                cascade(wheel, level, slot);
+                if (slot != 0) break;
+            }
+        }
+        if (!wheel->occupied[0]) {
+            // nothing can fire before the next cascade
+            const uint64_t next = (wheel->now | SLOT_MASK) + 1;
+            wheel->now = (next <= now) ? next : now + 1;
+            continue;
+        }
+
+        TimerLink due;
+        list_take(&due, &wheel->slots[0][index]);
+        wheel->occupied[0] &= ~(UINT64_C(1) << index);
+        // timers added by the callbacks below for this tick or earlier
+        // land in the next tick's slot
+        wheel->now++;
+        while (!list_empty(&due)) {
+            Timer* timer = (Timer*)due.next;
+            list_unlink(&timer->link);
+            wheel->count--;
+            timer->callback(timer);
+            fired++;
+        }
+    }
+    return fired;
+}
+
+bool TimerWheelNextWakeup(const TimerWheel* wheel, uint64_t* tick)
+{
+    if (wheel->count == 0) return false;
+    uint64_t best = UINT64_MAX;
+    for (uint32_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        const uint64_t occupied = wheel->occupied[level];
+        if (!occupied) continue;
+        // Level 0 slots fire on consecutive ticks starting at now, higher
+        // level slots cascade on consecutive multiples of their granularity
+        const uint32_t shift = TIMER_WHEEL_BITS * level;
+        const uint64_t granularity = UINT64_C(1) << shift;
+        const uint64_t base = (wheel->now + granularity - 1) & ~(granularity - 1);
+        const uint32_t base_slot = (base >> shift) & SLOT_MASK;
+        const uint64_t rotated = (occupied >> base_slot) | (occupied << ((TIMER_WHEEL_SLOTS - base_slot) & SLOT_MASK));
+        const uint64_t candidate = base + (uint64_t)count_trailing_zeros(rotated) * granularity;
+        if (candidate < best) best = candidate;
+    }
+    // the bitmaps only go stale by being clear, so with count > 0 one is set
+    *tick = best;
+    return true;
+}
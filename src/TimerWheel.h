@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Hierarchical timing wheel.  Times are in caller-defined ticks, the app
+// uses milliseconds.  Adding and cancelling a timer is O(1), advancing
+// fires every due timer in a batch and a timer is moved down a level at
+// most TIMER_WHEEL_LEVELS-1 times unless it is beyond the wheel's range.
+//
+// Level 0 has one slot per tick, each level above covers TIMER_WHEEL_SLOTS
+// times the range of the one below.  Timers further out than the whole
+// wheel park in the top level and are re-placed when that slot comes up.
+#define TIMER_WHEEL_BITS 6 // occupied[] relies on this being 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+
+typedef struct TimerLink {
+    struct TimerLink* next;
+    struct TimerLink* prev;
+} TimerLink;
+
+typedef struct Timer {
+    TimerLink link; // must be first, next is NULL when not scheduled
+    uint32_t slot; // level * TIMER_WHEEL_SLOTS + slot while scheduled
+    uint64_t expires;
+    void (*callback)(struct Timer*);
+} Timer;
+
+typedef struct {
+    // the next tick to be processed, everything before it has fired
+    uint64_t now;
+    uint32_t count;
+    // bit i is set if slots[level][i] is non-empty
+    uint64_t occupied[TIMER_WHEEL_LEVELS];
+    TimerLink slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+} TimerWheel;
+
+void TimerWheelInit(TimerWheel*, uint64_t now);
+// Timers that are already due fire on the next advance.  The timer must
+// not already be scheduled, callback must be set by the caller.
+void TimerWheelAdd(TimerWheel*, Timer*, uint64_t expires);
+// Does nothing if the timer isn't scheduled
+void TimerWheelCancel(TimerWheel*, Timer*);
+bool TimerIsPending(const Timer*);
+// Fires every timer that expires at or before now and returns how many
+// fired.  Callbacks may add or cancel timers.
+uint32_t TimerWheelAdvance(TimerWheel*, uint64_t now);
+// Returns false if nothing is scheduled.  Otherwise returns the tick the
+// caller should wake up at: the earliest expiry, or an earlier tick where
+// a higher level needs to be moved down so the earliest expiry is known.
+bool TimerWheelNextWakeup(const TimerWheel*, uint64_t* tick);
@@ -0,0 +1,269 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "TraceDiff.h"
+
+static void* xrealloc(void* ptr, size_t size)
+{
+    void* result = realloc(ptr, size);
+    if (!result) abort();
+    return result;
+}
+
+static uint64_t record_key(const TraceFileRecord* record)
+{
+    return (uint64_t)record->msg << 32 | record->detail;
+}
+
+static void side_init(TraceDiffSide* side, TraceDiffRead read, void* source, uint32_t window)
+{
+    memset(side, 0, sizeof(*side));
+    side->read = read;
+    side->source = source;
+    side->records = xrealloc(NULL, (TRACE_DIFF_CONTEXT + (size_t)window) * sizeof(TraceFileRecord));
+    side->keys = xrealloc(NULL, window * sizeof(uint64_t));
+    side->changed = xrealloc(NULL, window);
+}
+
+static void side_free(TraceDiffSide* side)
+{
+    free(side->records);
+    free(side->keys);
+    free(side->changed);
+    memset(side, 0, sizeof(*side));
+}
+
+static void side_fill(TraceDiffSide* side, uint32_t window)
+{
+    TraceFileRecord* records = side->records + side->kept;
+    while (!side->end && side->count < window) {
+        const uint32_t count = side->read(side->source, records + side->count, window - side->count);
+        if (!count) side->end = true;
+        for (uint32_t i = 0; i < count; i++) side->keys[side->count + i] = record_key(&records[side->count + i]);
+        side->count += count;
+    }
+    memset(side->changed, 0, side->count);
+}
+
+// Drops the first count records of the window, keeping the last kept of
+// them for context
+static void side_advance(TraceDiffSide* side, uint32_t count, uint32_t kept)
+{
+    const uint32_t rest = side->count - count;
+    memmove(side->records, side->records + side->kept + count - kept, ((size_t)kept + rest) * sizeof(TraceFileRecord));
+    memmove(side->keys, side->keys + count, (size_t)rest * sizeof(uint64_t));
+    side->kept = kept;
+    side->count = rest;
+    side->first += count;
+}
+
+void TraceDiffInit(TraceDiff* diff, TraceDiffRead read, void* a, void* b, uint32_t window)
+{
+    memset(diff, 0, sizeof(*diff));
+    diff->window = window;
+    side_init(&diff->a, read, a, window);
+    side_init(&diff->b, read, b, window);
+    // diagonals run from -window - 1 to window + 1
+    const size_t diagonals = 2 * (size_t)window + 3;
+    diff->forward = (int64_t*)xrealloc(NULL, diagonals * sizeof(int64_t)) + window + 1;
+    diff->backward = (int64_t*)xrealloc(NULL, diagonals * sizeof(int64_t)) + window + 1;
+}
+
+void TraceDiffFree(TraceDiff* diff)
+{
+    side_free(&diff->a);
+    side_free(&diff->b);
+    free(diff->forward - diff->window - 1);
+    free(diff->backward - diff->window - 1);
+    memset(diff, 0, sizeof(*diff));
+}
+
+// --------------------------------------------------------------------------------
+// Myers
+// --------------------------------------------------------------------------------
+
+// Finds the middle snake of a[x_lo, x_hi) against b[y_lo, y_hi): the
+// snake a shortest edit script passes through halfway.  The forward and
+// backward searches go one edit further each round until their paths
+// overlap on a diagonal, *x and *y get where the overlap starts.
+static void middle_snake(TraceDiff* diff, int64_t x_lo, int64_t x_hi, int64_t y_lo, int64_t y_hi, int64_t* x_mid, int64_t* y_mid)
+{
+    const uint64_t* a = diff->a.keys;
+    const uint64_t* b = diff->b.keys;
+    int64_t* forward = diff->forward;
+    int64_t* backward = diff->backward;
+    const int64_t d_min = x_lo - y_hi;
+    const int64_t d_max = x_hi - y_lo;
+    const int64_t f_mid = x_lo - y_lo;
+    const int64_t b_mid = x_hi - y_hi;
+    int64_t f_min = f_mid, f_max = f_mid;
+    int64_t b_min = b_mid, b_max = b_mid;
+    // with an odd delta the paths can only meet after a forward step
+    const bool odd = (f_mid - b_mid) & 1;
+    forward[f_mid] = x_lo;
+    backward[b_mid] = x_hi;
+    for (uint32_t cost = 1;; cost++) {
+        // the diagonals one past the range searched so far act as walls
+        if (f_min > d_min) forward[--f_min - 1] = -1;
+        else f_min++;
+        if (f_max < d_max) forward[++f_max + 1] = -1;
+        else f_max--;
+        for (int64_t d = f_max; d >= f_min; d -= 2) {
+            const int64_t low = forward[d - 1], high = forward[d + 1];
+            int64_t x = (low >= high) ? low + 1 : high;
+            int64_t y = x - d;
+            while (x < x_hi && y < y_hi && a[x] == b[y]) x++, y++;
+            forward[d] = x;
+            if (odd && b_min <= d && d <= b_max && backward[d] <= x) {
+                *x_mid = x;
+                *y_mid = y;
+                return;
+            }
+        }
+
+        if (b_min > d_min) backward[--b_min - 1] = INT64_MAX;
+        else b_min++;
+        if (b_max < d_max) backward[++b_max + 1] = INT64_MAX;
+        else b_max--;
+        for (int64_t d = b_max; d >= b_min; d -= 2) {
+            const int64_t low = backward[d - 1], high = backward[d + 1];
+            int64_t x = (low < high) ? low : high - 1;
+            int64_t y = x - d;
+            while (x > x_lo && y > y_lo && a[x - 1] == b[y - 1]) x--, y--;
+            backward[d] = x;
+            if (!odd && f_min <= d && d <= f_max && x <= forward[d]) {
+                *x_mid = x;
+                *y_mid = y;
+                return;
+            }
+        }
+
+        if (cost >= TRACE_DIFF_MAX_COST) {
+            // Give up on the shortest script and split where the forward
+            // search got furthest.  It's at least cost edits past the start
+            // and short of the end, so both halves are smaller.
+            int64_t best = f_max;
+            for (int64_t d = f_max - 2; d >= f_min; d -= 2) {
+                if (2 * forward[d] - d > 2 * forward[best] - best) best = d;
+            }
+            *x_mid = forward[best];
+            *y_mid = forward[best] - best;
+            return;
+        }
+    }
+}
+
+// Marks the records of a[x_lo, x_hi) and b[y_lo, y_hi) a shortest edit
+// script removes or adds
+static void compare(TraceDiff* diff, int64_t x_lo, int64_t x_hi, int64_t y_lo, int64_t y_hi)
+{
+    const uint64_t* a = diff->a.keys;
+    const uint64_t* b = diff->b.keys;
+    // the common prefix and suffix are the cheap and very common case, a
+    // window of identical records never gets further than this
+    while (x_lo < x_hi && y_lo < y_hi && a[x_lo] == b[y_lo]) x_lo++, y_lo++;
+    while (x_lo < x_hi && y_lo < y_hi && a[x_hi - 1] == b[y_hi - 1]) x_hi--, y_hi--;
+    if (x_lo == x_hi) {
+        memset(diff->b.changed + y_lo, 1, (size_t)(y_hi - y_lo));
+    } else if (y_lo == y_hi) {
+        memset(diff->a.changed + x_lo, 1, (size_t)(x_hi - x_lo));
+    } else {
+        int64_t x, y;
+        middle_snake(diff, x_lo, x_hi, y_lo, y_hi, &x, &y);
+        compare(diff, x_lo, x, y_lo, y);
+        compare(diff, x, x_hi, y, y_hi);
+    }
+}
+
+// --------------------------------------------------------------------------------
+// Streaming
+// --------------------------------------------------------------------------------
+
+// Reports the hunks before a[cut_a] and b[cut_b], both are right after a
+// match or the end of the windows.  Returns how many matches directly
+// precede the cut.
+static uint32_t report(TraceDiff* diff, uint32_t cut_a, uint32_t cut_b, TraceDiffCallback callback, void* context)
+{
+    const TraceDiffSide* a = &diff->a;
+    const TraceDiffSide* b = &diff->b;
+    const TraceFileRecord* a_records = a->records + a->kept;
+    const TraceFileRecord* b_records = b->records + b->kept;
+    // the kept records matched, that's why they were kept
+    uint32_t matched = a->kept;
+    uint32_t i = 0, j = 0;
+    while (i < cut_a || j < cut_b) {
+        if (i < cut_a && j < cut_b && !a->changed[i] && !b->changed[j]) {
+            i++;
+            j++;
+            matched++;
+            continue;
+        }
+        TraceDiffHunk hunk;
+        hunk.a_index = a->first + i;
+        hunk.a = &a_records[i];
+        hunk.b_index = b->first + j;
+        hunk.b = &b_records[j];
+        hunk.context_count = (matched < TRACE_DIFF_CONTEXT) ? matched : TRACE_DIFF_CONTEXT;
+        hunk.context = &a_records[(int64_t)i - hunk.context_count];
+        const uint32_t i_start = i, j_start = j;
+        while (i < cut_a && a->changed[i]) i++;
+        while (j < cut_b && b->changed[j]) j++;
+        hunk.a_count = i - i_start;
+        hunk.b_count = j - j_start;
+        callback(context, &hunk);
+        diff->hunks++;
+        diff->removed += hunk.a_count;
+        diff->added += hunk.b_count;
+        matched = 0;
+    }
+    return matched;
+}
+
+void TraceDiffRun(TraceDiff* diff, TraceDiffCallback callback, void* context)
+{
+    TraceDiffSide* a = &diff->a;
+    TraceDiffSide* b = &diff->b;
+    for (;;) {
+        side_fill(a, diff->window);
+        side_fill(b, diff->window);
+        const uint32_t n = a->count, m = b->count;
+        if (!n && !m) return;
+        compare(diff, 0, n, 0, m);
+
+        // cut after the last match in the first three quarters, a side that
+        // ended has no more records that could change its alignment
+        const uint32_t limit_a = a->end ? n : n - n / 4;
+        const uint32_t limit_b = b->end ? m : m - m / 4;
+        uint32_t cut_a = 0, cut_b = 0;
+        uint32_t first_a = 0, first_b = 0;
+        uint32_t i = 0, j = 0;
+        while (i < n && j < m) {
+            if (!a->changed[i] && !b->changed[j]) {
+                i++;
+                j++;
+                if (i <= limit_a && j <= limit_b) {
+                    cut_a = i;
+                    cut_b = j;
+                } else if (!first_a) {
+                    first_a = i;
+                    first_b = j;
+                }
+                continue;
+            }
+            while (i < n && a->changed[i]) i++;
+            while (j < m && b->changed[j]) j++;
+        }
+        if ((a->end && b->end) || (!cut_a && !first_a)) {
+            // everything left, or windows that have nothing in common
+            cut_a = n;
+            cut_b = m;
+        } else if (!cut_a) {
+            cut_a = first_a;
+            cut_b = first_b;
+        }
+
+        const uint32_t matched = report(diff, cut_a, cut_b, callback, context);
+        side_advance(a, cut_a, (matched < TRACE_DIFF_CONTEXT) ? matched : TRACE_DIFF_CONTEXT);
+        side_advance(b, cut_b, 0);
+    }
+}
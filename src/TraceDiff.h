@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "TraceFile.h"
+
+// Aligns two message traces and reports where they diverge.  Records match
+// when their message id and detail are equal, the alignment is a shortest
+// edit script found with Myers' O(ND) algorithm in its linear space form
+// (divide and conquer on the middle snake).
+//
+// Traces can be much larger than memory, so they're streamed through a
+// window of records from each side.  After diffing the two windows only
+// the script up to the last match in their first three quarters is
+// reported, an alignment close to the end of a window might change once
+// more records are read.  The rest moves to the front and the windows are
+// topped up.  Memory is O(window) and identical stretches cost one pass
+// over their keys.
+//
+// Windows with nothing in common would take O(window^2), so like GNU diff
+// the search gives up on the shortest script after TRACE_DIFF_MAX_COST
+// edits and splits where it got furthest.
+#define TRACE_DIFF_CONTEXT 3
+#define TRACE_DIFF_MAX_COST 1024
+
+// Reads up to max records into out, returns how many, 0 at the end
+typedef uint32_t (*TraceDiffRead)(void* source, TraceFileRecord* out, uint32_t max);
+
+typedef struct {
+    uint64_t a_index; // of the first record only in a, or where b's records would go
+    const TraceFileRecord* a;
+    uint32_t a_count;
+    uint64_t b_index;
+    const TraceFileRecord* b;
+    uint32_t b_count;
+    // up to TRACE_DIFF_CONTEXT records both traces have right before the hunk
+    const TraceFileRecord* context;
+    uint32_t context_count;
+} TraceDiffHunk;
+
+typedef void (*TraceDiffCallback)(void* context, const TraceDiffHunk*);
+
+typedef struct {
+    TraceDiffRead read;
+    void* source;
+    // the records kept for context, then the window
+    TraceFileRecord* records;
+    uint32_t kept;
+    uint32_t count; // in the window
+    uint64_t first; // index in the trace of the window's first record
+    bool end;
+    uint64_t* keys; // msg and detail of each record in the window
+    uint8_t* changed; // not in the other trace, set by the diff
+} TraceDiffSide;
+
+typedef struct {
+    TraceDiffSide a, b;
+    uint32_t window;
+    // the furthest reaching path on every diagonal, forward and backward
+    int64_t* forward;
+    int64_t* backward;
+    uint64_t hunks;
+    uint64_t removed; // records only in a
+    uint64_t added; // records only in b
+} TraceDiff;
+
+void TraceDiffInit(TraceDiff*, TraceDiffRead, void* a, void* b, uint32_t window);
+void TraceDiffFree(TraceDiff*);
+// Diffs the traces to the end, calling callback with every divergence in
+// trace order.  The hunk's records are only valid during the call.
+void TraceDiffRun(TraceDiff*, TraceDiffCallback, void* context);
@@ -0,0 +1,58 @@
+#include <string.h>
+
+#include "TraceFile.h"
+
+// A message costs an fwrite into this buffer, it only goes to the OS when
+// it fills up
+#define TRACE_FILE_BUFFER (1 << 16)
+
+bool TraceFileCreate(TraceFile* trace, const char* path)
+{
+    memset(trace, 0, sizeof(*trace));
+    trace->file = fopen(path, "wb");
+    if (!trace->file) return false;
+    setvbuf(trace->file, NULL, _IOFBF, TRACE_FILE_BUFFER);
+    const TraceFileHeader header = {TRACE_FILE_MAGIC, sizeof(TraceFileRecord)};
+    if (fwrite(&header, sizeof(header), 1, trace->file) != 1) {
+        fclose(trace->file);
+        trace->file = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool TraceFileOpen(TraceFile* trace, const char* path)
+{
+    memset(trace, 0, sizeof(*trace));
+    trace->file = fopen(path, "rb");
+    if (!trace->file) return false;
+    setvbuf(trace->file, NULL, _IOFBF, TRACE_FILE_BUFFER);
+    TraceFileHeader header;
+    if (fread(&header, sizeof(header), 1, trace->file) != 1 ||
+        header.magic != TRACE_FILE_MAGIC || header.record_size != sizeof(TraceFileRecord)) {
+        fclose(trace->file);
+        trace->file = NULL;
+        return false;
+    }
+    return true;
+}
+
+void TraceFileClose(TraceFile* trace)
+{
+    if (trace->file) fclose(trace->file);
+    trace->file = NULL;
+}
+
+void TraceFileWrite(TraceFile* trace, uint32_t msg, uint32_t detail, uint64_t wparam, uint64_t lparam)
+{
+    const TraceFileRecord record = {msg, detail, wparam, lparam};
+    fwrite(&record, sizeof(record), 1, trace->file);
+    trace->records++;
+}
+
+uint32_t TraceFileRead(TraceFile* trace, TraceFileRecord* out, uint32_t max)
+{
+    const uint32_t count = (uint32_t)fread(out, sizeof(TraceFileRecord), max, trace->file);
+    trace->records += count;
+    return count;
+}
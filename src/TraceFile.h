@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// A recorded message trace: a header and then one fixed size record per
+// message in the order the window received them.  Each record keeps the
+// raw parameters and one decoded field, the detail, that's stable from run
+// to run (the SWP_* flags of WM_WINDOWPOSCHANGING, the size type of
+// WM_SIZE, ...) and not pointers or coordinates that always differ.
+// tracediff.c aligns two traces by message id and detail.
+//
+// Records are written in the writer's byte order, traces are compared on
+// the machine they were recorded on.
+#define TRACE_FILE_MAGIC 0x3146544d // "MTF1"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t record_size;
+} TraceFileHeader;
+
+typedef struct {
+    uint32_t msg;
+    uint32_t detail; // 0 for messages without one
+    uint64_t wparam;
+    uint64_t lparam;
+} TraceFileRecord;
+
+typedef struct {
+    FILE* file;
+    uint64_t records; // written or read so far
+} TraceFile;
+
+// Returns false if the file can't be created
+bool TraceFileCreate(TraceFile*, const char* path);
+// Returns false if the file can't be opened or isn't a trace
+bool TraceFileOpen(TraceFile*, const char* path);
+void TraceFileClose(TraceFile*);
+// Buffered, the records reach the file at the latest on TraceFileClose
+void TraceFileWrite(TraceFile*, uint32_t msg, uint32_t detail, uint64_t wparam, uint64_t lparam);
+// Reads up to max records, returns how many.  0 at the end of the trace,
+// a record cut short by a crash of the writer is never returned.
+uint32_t TraceFileRead(TraceFile*, TraceFileRecord* out, uint32_t max);
@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "TraceRing.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// The record fields are written by one process while another reads them,
+// the seqlock only works if the compiler keeps every access and the fences
+// order them.  x86 and x64 don't reorder stores with stores or loads with
+// loads, so with MSVC volatile accesses and compiler barriers are enough.
+#ifdef _MSC_VER
+#include <intrin.h>
+#define LOAD(p) (*(const volatile uint64_t*)(p))
+#define LOAD32(p) (*(const volatile uint32_t*)(p))
+#define STORE(p, v) (*(volatile uint64_t*)(p) = (v))
+#define STORE32(p, v) (*(volatile uint32_t*)(p) = (v))
+#define FENCE_ACQUIRE() _ReadWriteBarrier()
+#define FENCE_RELEASE() _ReadWriteBarrier()
+#else
+#define LOAD(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define LOAD32(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define STORE32(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define FENCE_ACQUIRE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define FENCE_RELEASE() __atomic_thread_fence(__ATOMIC_RELEASE)
+#endif
+
+static size_t ring_size(uint32_t capacity)
+{
+    return sizeof(TraceRingHeader) + (size_t)capacity * sizeof(TraceRecord);
+}
+
+#ifdef _WIN32
+static bool map(TraceRing* ring, bool create)
+{
+    char name[80];
+    snprintf(name, sizeof(name), "Local\\%s", ring->name);
+    if (create) {
+        ring->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+            (DWORD)((uint64_t)ring->size >> 32), (DWORD)ring->size, name);
+    } else {
+        ring->mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+    }
+    if (!ring->mapping) return false;
+    ring->header = MapViewOfFile(ring->mapping, create ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, create ? ring->size : 0);
+    if (!ring->header) {
+        CloseHandle(ring->mapping);
+        return false;
+    }
+    if (!create) {
+        MEMORY_BASIC_INFORMATION info;
+        if (!VirtualQuery(ring->header, &info, sizeof(info))) return false;
+        ring->size = info.RegionSize;
+    }
+    return true;
+}
+
+static void unmap(TraceRing* ring)
+{
+    UnmapViewOfFile(ring->header);
+    CloseHandle(ring->mapping);
+}
+#else
+static bool map(TraceRing* ring, bool create)
+{
+    char name[80];
+    snprintf(name, sizeof(name), "/%s", ring->name);
+    if (create) {
+        shm_unlink(name);
+        ring->fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (ring->fd < 0) return false;
+        if (ftruncate(ring->fd, (off_t)ring->size) != 0) {
+            close(ring->fd);
+            shm_unlink(name);
+            return false;
+        }
+    } else {
+        ring->fd = shm_open(name, O_RDONLY, 0);
+        if (ring->fd < 0) return false;
+        struct stat st;
+        if (fstat(ring->fd, &st) != 0 || (size_t)st.st_size < sizeof(TraceRingHeader)) {
+            close(ring->fd);
+            return false;
+        }
+        ring->size = (size_t)st.st_size;
+    }
+    void* memory = mmap(NULL, ring->size, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, ring->fd, 0);
+    if (memory == MAP_FAILED) {
+        close(ring->fd);
+        if (create) shm_unlink(name);
+        return false;
+    }
+    ring->header = memory;
+    return true;
+}
+
+static void unmap(TraceRing* ring)
+{
+    munmap(ring->header, ring->size);
+    close(ring->fd);
+    if (ring->writer) {
+        char name[80];
+        snprintf(name, sizeof(name), "/%s", ring->name);
+        shm_unlink(name);
+    }
+}
+#endif
+
+bool TraceRingCreate(TraceRing* ring, const char* name, uint32_t capacity, uint32_t writer_pid)
+{
+    if (!capacity || (capacity & (capacity - 1))) return false;
+    memset(ring, 0, sizeof(*ring));
+    snprintf(ring->name, sizeof(ring->name), "%s", name);
+    ring->writer = true;
+    ring->size = ring_size(capacity);
+    if (!map(ring, true)) return false;
+    // fresh shared memory is zeroed, every seq is 0 and matches no record
+    TraceRingHeader* header = ring->header;
+    header->capacity = capacity;
+    header->writer_pid = writer_pid;
+    header->head = 0;
+    FENCE_RELEASE();
+    STORE32(&header->magic, TRACE_RING_MAGIC);
+    return true;
+}
+
+bool TraceRingAttach(TraceRing* ring, const char* name)
+{
+    memset(ring, 0, sizeof(*ring));
+    snprintf(ring->name, sizeof(ring->name), "%s", name);
+    if (!map(ring, false)) return false;
+    const TraceRingHeader* header = ring->header;
+    const bool valid = LOAD32(&header->magic) == TRACE_RING_MAGIC;
+    FENCE_ACQUIRE();
+    if (!valid || !header->capacity || (header->capacity & (header->capacity - 1)) ||
+        ring_size(header->capacity) > ring->size) {
+        unmap(ring);
+        return false;
+    }
+    ring->next = LOAD(&header->head);
+    return true;
+}
+
+void TraceRingClose(TraceRing* ring)
+{
+    if (ring->header) unmap(ring);
+    memset(ring, 0, sizeof(*ring));
+}
+
+void TraceRingPublish(TraceRing* ring, uint32_t msg, uint32_t thread, uint64_t time_ns, uint64_t duration_ns)
+{
+    TraceRingHeader* header = ring->header;
+    const uint64_t n = ring->next++;
+    TraceRecord* record = &header->records[n & (header->capacity - 1)];
+    STORE(&record->seq, 2 * n + 1);
+    // the odd seq has to be visible before any of the new fields
+    FENCE_RELEASE();
+    STORE(&record->time_ns, time_ns);
+    STORE(&record->duration_ns, duration_ns);
+    STORE32(&record->msg, msg);
+    STORE32(&record->thread, thread);
+    // and the fields before the even one, and the record before the head
+    FENCE_RELEASE();
+    STORE(&record->seq, 2 * n + 2);
+    STORE(&header->head, n + 1);
+}
+
+uint32_t TraceRingRead(TraceRing* ring, TraceRecord* out, uint32_t max)
+{
+    const TraceRingHeader* header = ring->header;
+    const uint64_t head = LOAD(&header->head);
+    FENCE_ACQUIRE();
+    if (head - ring->next > header->capacity) {
+        // lapped, those records are gone
+        ring->dropped += head - header->capacity - ring->next;
+        ring->next = head - header->capacity;
+    }
+    uint32_t count = 0;
+    while (count < max && ring->next < head) {
+        const uint64_t n = ring->next++;
+        const TraceRecord* record = &header->records[n & (header->capacity - 1)];
+        const uint64_t seq = LOAD(&record->seq);
+        FENCE_ACQUIRE();
+        if (seq == 2 * n + 2) {
+            TraceRecord* copy = &out[count];
+            copy->time_ns = LOAD(&record->time_ns);
+            copy->duration_ns = LOAD(&record->duration_ns);
+            copy->msg = LOAD32(&record->msg);
+            copy->thread = LOAD32(&record->thread);
+            // the fields have to be read before seq is checked again
+            FENCE_ACQUIRE();
+            if (LOAD(&record->seq) == seq) {
+                copy->seq = n;
+                count++;
+                continue;
+            }
+        }
+        // the writer lapped us while we got here and reused the slot
+        ring->dropped++;
+    }
+    return count;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Live message trace shared with other processes.  A window thread is the
+// only writer: it publishes a record per handled message into a ring in
+// shared memory.  Monitors map the same memory and read the records where
+// they are, nothing goes through the kernel and the writer never waits
+// for a reader.  A reader that falls more than the ring's capacity behind
+// loses the oldest records and counts them as dropped.
+//
+// Every record has a sequence number that's made odd before its fields are
+// written and even after (a seqlock), so a reader can tell a consistent
+// record from one the writer overwrote while it was being read.
+//
+// POSIX shared memory (shm_open) on Linux, a named file mapping on Windows.
+// Readers are typically monitor.c.
+#define TRACE_RING_MAGIC 0x31435254 // "TRC1"
+
+typedef struct {
+    uint64_t seq; // 2n+1 while record n is written, 2n+2 once it's complete
+    uint64_t time_ns; // when the handler started, on the writer's clock
+    uint64_t duration_ns;
+    uint32_t msg;
+    uint32_t thread;
+} TraceRecord;
+
+typedef struct {
+    uint32_t magic; // written last, a reader ignores the ring until it's set
+    uint32_t capacity; // records, a power of two
+    uint32_t writer_pid;
+    char pad0[64 - 3 * sizeof(uint32_t)];
+    // records published so far, on its own cache line so readers polling it
+    // don't share one with the record being written
+    volatile uint64_t head;
+    char pad1[64 - sizeof(uint64_t)];
+    TraceRecord records[];
+} TraceRingHeader;
+
+typedef struct {
+    TraceRingHeader* header;
+    size_t size;
+    uint64_t next; // writer: the next record to publish, reader: to read
+    uint64_t dropped; // reader only
+    bool writer;
+    char name[64];
+#ifdef _WIN32
+    void* mapping;
+#else
+    int fd;
+#endif
+} TraceRing;
+
+// Creates the ring named name, replacing a stale one.  Returns false if the
+// shared memory can't be created or mapped.
+bool TraceRingCreate(TraceRing*, const char* name, uint32_t capacity, uint32_t writer_pid);
+// Maps an existing ring read only, reading starts with the next record
+// published.  Returns false if there's no ring by that name or it isn't
+// initialized yet.
+bool TraceRingAttach(TraceRing*, const char* name);
+// The writer also removes the name
+void TraceRingClose(TraceRing*);
+void TraceRingPublish(TraceRing*, uint32_t msg, uint32_t thread, uint64_t time_ns, uint64_t duration_ns);
+// Copies up to max records that were published since the last call into
+// out, with seq set to the record's index.  Returns how many.
+uint32_t TraceRingRead(TraceRing*, TraceRecord* out, uint32_t max);
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Workload.h"
+
+static void* xrealloc(void* ptr, size_t size)
+{
+    void* result = realloc(ptr, size);
+    if (!result) abort();
+    return result;
+}
+
+// xorshift32, the scenarios only need to be the same every run
+static uint32_t rng_next(Workload* workload)
+{
+    uint32_t x = workload->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    workload->rng = x;
+    return x;
+}
+
+static int32_t rng_range(Workload* workload, int32_t min, int32_t max)
+{
+    return min + (int32_t)(rng_next(workload) % (uint32_t)(max - min));
+}
+
+// How far the corner is dragged out and back, in pixels, and in how many steps
+#define RESIZE_DRAG_DISTANCE 400
+#define RESIZE_DRAG_PERIOD 250
+// The band along the window's edges that's most likely frame, the caption
+// is in the top one
+#define FRAME_BAND 8
+#define CAPTION_BAND 32
+
+const char* WorkloadName(WorkloadKind kind)
+{
+    switch (kind) {
+    case WORKLOAD_RESIZE_DRAG: return "resize-drag";
+    case WORKLOAD_MOUSE_FLOOD: return "mouse-flood";
+    case WORKLOAD_ACTIVATION: return "activation";
+    case WORKLOAD_STRING_STORM: return "string-storm";
+    default: return "?";
+    }
+}
+
+void WorkloadInit(Workload* workload, WorkloadKind kind, int32_t width, int32_t height)
+{
+    memset(workload, 0, sizeof(*workload));
+    workload->kind = kind;
+    workload->width = width;
+    workload->height = height;
+    workload->rng = 0x2545f491u + (uint32_t)kind;
+    switch (kind) {
+    case WORKLOAD_RESIZE_DRAG: workload->step_count = 10 * 125; break;
+    case WORKLOAD_MOUSE_FLOOD: workload->step_count = 10 * 1000; break;
+    case WORKLOAD_ACTIVATION: workload->step_count = 10 * 50; break;
+    case WORKLOAD_STRING_STORM: workload->step_count = 20000; break;
+    default: abort();
+    }
+    workload->x = workload->target_x = width / 2;
+    workload->y = workload->target_y = height / 2;
+}
+
+// A new place for the pointer to head for, a third of them on the frame
+static void pick_target(Workload* workload)
+{
+    const int32_t width = workload->width, height = workload->height;
+    if (rng_range(workload, 0, 3)) {
+        workload->target_x = rng_range(workload, 0, width);
+        workload->target_y = rng_range(workload, 0, height);
+    } else {
+        switch (rng_range(workload, 0, 4)) {
+        case 0: // caption
+            workload->target_x = rng_range(workload, 0, width);
+            workload->target_y = rng_range(workload, 0, CAPTION_BAND);
+            break;
+        case 1: // left border
+            workload->target_x = rng_range(workload, 0, FRAME_BAND);
+            workload->target_y = rng_range(workload, 0, height);
+            break;
+        case 2: // right border
+            workload->target_x = rng_range(workload, width - FRAME_BAND, width);
+            workload->target_y = rng_range(workload, 0, height);
+            break;
+        default: // bottom border
+            workload->target_x = rng_range(workload, 0, width);
+            workload->target_y = rng_range(workload, height - FRAME_BAND, height);
+            break;
+        }
+    }
+    workload->speed = rng_range(workload, 1, 7);
+}
+
+static int32_t approach(int32_t from, int32_t to, int32_t speed)
+{
+    if (to > from) return (to - from > speed) ? from + speed : to;
+    return (from - to > speed) ? from - speed : to;
+}
+
+bool WorkloadNext(Workload* workload, WorkloadStep* step)
+{
+    if (workload->step >= workload->step_count) return false;
+    const uint32_t i = workload->step++;
+    switch (workload->kind) {
+    case WORKLOAD_RESIZE_DRAG: {
+        // out and back again like a triangle wave, with a hand's jitter
+        const uint32_t phase = i % RESIZE_DRAG_PERIOD;
+        const uint32_t t = (phase < RESIZE_DRAG_PERIOD / 2) ? phase : RESIZE_DRAG_PERIOD - phase;
+        const int32_t distance = (int32_t)(t * 2 * RESIZE_DRAG_DISTANCE / RESIZE_DRAG_PERIOD);
+        step->kind = WORKLOAD_STEP_RESIZE;
+        step->time_ms = i * 8;
+        step->a = workload->width + distance + rng_range(workload, -2, 3);
+        step->b = workload->height + distance * 3 / 4 + rng_range(workload, -2, 3);
+        return true;
+    }
+    case WORKLOAD_MOUSE_FLOOD:
+        if (workload->x == workload->target_x && workload->y == workload->target_y) pick_target(workload);
+        workload->x = approach(workload->x, workload->target_x, workload->speed);
+        workload->y = approach(workload->y, workload->target_y, workload->speed);
+        step->kind = WORKLOAD_STEP_POINTER;
+        step->time_ms = i;
+        step->a = workload->x;
+        step->b = workload->y;
+        return true;
+    case WORKLOAD_ACTIVATION:
+        // starts active, so the first step takes the activation away and
+        // the last gives it back
+        step->kind = WORKLOAD_STEP_ACTIVATE;
+        step->time_ms = i * 20;
+        step->a = (int32_t)(i & 1);
+        step->b = 0;
+        return true;
+    case WORKLOAD_STRING_STORM:
+        step->kind = WORKLOAD_STEP_STRING;
+        step->time_ms = i / 20;
+        step->a = rng_range(workload, 0, WORKLOAD_STRINGS);
+        step->b = 0;
+        return true;
+    default:
+        abort();
+    }
+}
+
+// --------------------------------------------------------------------------------
+// Stats
+// --------------------------------------------------------------------------------
+
+void WorkloadStatsInit(WorkloadStats* stats, uint32_t capacity, uint64_t now_ns)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->latency_ns = xrealloc(NULL, (size_t)capacity * sizeof(uint32_t));
+    stats->capacity = capacity;
+    stats->start_ns = now_ns;
+    stats->allocations = -1;
+}
+
+void WorkloadStatsFree(WorkloadStats* stats)
+{
+    free(stats->latency_ns);
+    memset(stats, 0, sizeof(*stats));
+}
+
+void WorkloadStatsAdd(WorkloadStats* stats, uint64_t latency_ns)
+{
+    if (stats->messages < stats->capacity) {
+        stats->latency_ns[stats->messages] = (latency_ns > UINT32_MAX) ? UINT32_MAX : (uint32_t)latency_ns;
+    }
+    stats->messages++;
+}
+
+void WorkloadStatsFinish(WorkloadStats* stats, uint64_t now_ns)
+{
+    stats->end_ns = now_ns;
+}
+
+static int compare_u32(const void* a, const void* b)
+{
+    const uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+size_t WorkloadStatsFormat(WorkloadStats* stats, const char* name, char* buf, size_t len)
+{
+    const uint32_t samples = (stats->messages < stats->capacity) ? (uint32_t)stats->messages : stats->capacity;
+    qsort(stats->latency_ns, samples, sizeof(uint32_t), compare_u32);
+    const uint32_t p50 = samples ? stats->latency_ns[samples / 2] : 0;
+    const uint32_t p99 = samples ? stats->latency_ns[samples * 99ull / 100] : 0;
+    const uint32_t max = samples ? stats->latency_ns[samples - 1] : 0;
+    const uint64_t elapsed_ns = stats->end_ns - stats->start_ns;
+    const double per_second = elapsed_ns ? stats->messages * 1e9 / elapsed_ns : 0;
+
+    char allocations[32];
+    if (stats->allocations < 0) snprintf(allocations, sizeof(allocations), "n/a");
+    else snprintf(allocations, sizeof(allocations), "%lld", (long long)stats->allocations);
+    const int result = snprintf(buf, len,
+        "%-17s %8llu msgs in %9.3f ms = %9.0f msgs/s, latency p50 %6u ns p99 %8u ns max %9u ns, allocations %s, logged %llu bytes",
+        name, (unsigned long long)stats->messages, elapsed_ns / 1e6, per_second, p50, p99, max, allocations,
+        (unsigned long long)stats->log_bytes);
+    return (result < 0) ? 0 : (size_t)result;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Synthetic scenarios for driving a window end to end.  A workload is a
+// deterministic stream of steps, each something that happens to the window
+// at a time into the scenario: it's resized, the pointer moves, it gains
+// or loses the activation or a string message arrives.  The window side
+// turns the steps into the messages Windows would send, see run_scenario
+// in basics.c.
+//
+// The step times describe what the user is doing, playback doesn't wait
+// for them.  A scenario measures how fast the window gets through a fixed
+// amount of work, so logging modes and dispatch strategies can be compared
+// on the same input.
+typedef enum {
+    // 10 s dragging the bottom right corner, 125 moves a second: the
+    // WM_WINDOWPOSCHANGING, WM_NCCALCSIZE, WM_WINDOWPOSCHANGED (WM_SIZE),
+    // WM_NCPAINT, WM_PAINT cycle
+    WORKLOAD_RESIZE_DRAG,
+    // 10 s of a 1000 Hz mouse wandering over the client area and the frame
+    WORKLOAD_MOUSE_FLOOD,
+    // another window taking the activation and giving it back, 50 times a
+    // second for 10 s
+    WORKLOAD_ACTIVATION,
+    // 20000 registered messages in 1 s
+    WORKLOAD_STRING_STORM,
+    WORKLOAD_COUNT,
+} WorkloadKind;
+
+typedef enum {
+    WORKLOAD_STEP_RESIZE, // to a by b
+    WORKLOAD_STEP_POINTER, // to a,b in window coordinates, the frame included
+    WORKLOAD_STEP_ACTIVATE, // a is 1 when the window becomes active, 0 when it stops being
+    WORKLOAD_STEP_STRING, // registered message number a, below WORKLOAD_STRINGS
+} WorkloadStepKind;
+
+#define WORKLOAD_STRINGS 16
+
+typedef struct {
+    WorkloadStepKind kind;
+    uint32_t time_ms;
+    int32_t a, b;
+} WorkloadStep;
+
+typedef struct {
+    WorkloadKind kind;
+    int32_t width, height; // of the window when the workload started
+    uint32_t step; // the next one
+    uint32_t step_count;
+    uint32_t rng;
+    // the pointer heads for target at speed pixels a millisecond
+    int32_t x, y;
+    int32_t target_x, target_y;
+    int32_t speed;
+} Workload;
+
+// "resize-drag", "mouse-flood", "activation" or "string-storm"
+const char* WorkloadName(WorkloadKind);
+void WorkloadInit(Workload*, WorkloadKind, int32_t width, int32_t height);
+// Returns false after the last step
+bool WorkloadNext(Workload*, WorkloadStep*);
+
+// What one run of a workload cost.  The latency buffer is allocated up
+// front so recording doesn't add allocations to the count, messages past
+// its capacity are counted but not sampled.
+typedef struct {
+    uint32_t* latency_ns; // of every handled message, nested ones included
+    uint32_t capacity;
+    uint64_t messages;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    int64_t allocations; // -1 when they couldn't be counted
+    uint64_t log_bytes;
+} WorkloadStats;
+
+void WorkloadStatsInit(WorkloadStats*, uint32_t capacity, uint64_t now_ns);
+void WorkloadStatsFree(WorkloadStats*);
+void WorkloadStatsAdd(WorkloadStats*, uint64_t latency_ns);
+void WorkloadStatsFinish(WorkloadStats*, uint64_t now_ns);
+// One line with messages/s, the latency percentiles, allocations and
+// bytes logged.  Sorts the samples.  Always null terminates and returns
+// the length it would have needed like snprintf.
+size_t WorkloadStatsFormat(WorkloadStats*, const char* name, char* buf, size_t len);
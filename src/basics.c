@@ -1,15 +1,42 @@
 #pragma comment(lib, "user32")
 #pragma comment(lib, "gdi32")
+#pragma comment(lib, "imm32")
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <windows.h>
+#include <imm.h>
+#ifdef _DEBUG
+#include <crtdbg.h>
+#endif
 
+#include "FramePacer.h"
 #include "GetMsgName.h"
+#include "HandlerProfile.h"
+#include "HitTest.h"
+#include "MpscQueue.h"
+#include "MsgFormat.h"
+#include "MsgNameCache.h"
+#include "MsgSequence.h"
+#include "PointerBatch.h"
+#include "Region.h"
+#include "SessionStats.h"
+#include "StartupProfile.h"
+#include "TaskScheduler.h"
+#include "TextEditor.h"
+#include "TimerWheel.h"
+#include "TraceFile.h"
+#include "TraceRing.h"
+#include "Workload.h"
+
+// what this thread has logged, the scenarios report it
+static __declspec(thread) uint64_t thread_log_bytes = 0;
 
 #define LOG(fmt, ...) do { \
-    fprintf(stderr, fmt "\n", ##__VA_ARGS__); \
+    const int log_len = fprintf(stderr, fmt "\n", ##__VA_ARGS__); \
+    if (log_len > 0) thread_log_bytes += (uint64_t)log_len; \
     fflush(stderr); \
 } while (0)
 
@@ -35,27 +62,6 @@
     fflush(stderr); \
     abort(); \
 } while (0)
-
-
-static void append_str(char* s, size_t* offset, const char sep, const char* append_str)
-{
-    const size_t append_len = strlen(append_str);
-    if (*offset > 0) {
-        s[*offset] = sep;
-        *offset += 1;
-    }
-    memcpy(s + *offset, append_str, append_len);
-    *offset += append_len;
-}
-static bool consume_flag(DWORD* flags, DWORD flag)
-{
-    if (*flags & flag) {
-        *flags &= ~flag;
-        return true;
-    }
-    return false;
-}
-
 static const DWORD WND_STYLE_ALL = (
     WS_TABSTOP
     | WS_MINIMIZEBOX
@@ -75,41 +81,6 @@ static const DWORD WND_STYLE_ALL = (
     | WS_POPUP
 );
 
-// This is calcualted by calling format_wnd_style with 0xffffffff and adding 1
-#define FORMAT_WND_STYLE_BUF_LEN ((size_t)147)
-
-static size_t format_wnd_style(char* out, DWORD style)
-{
-    DWORD remaining = style;
-    size_t offset = 0;
-    if (consume_flag(&remaining, WS_TABSTOP)) append_str(out, &offset, ',', "TABSTOP");
-    if (consume_flag(&remaining, WS_MINIMIZEBOX)) append_str(out, &offset, ',', "MINBOX");
-    if (consume_flag(&remaining, WS_SIZEBOX)) append_str(out, &offset, ',', "SIZEBOX");
-    if (consume_flag(&remaining, WS_SYSMENU)) append_str(out, &offset, ',', "SYSMENU");
-    if (consume_flag(&remaining, WS_HSCROLL)) append_str(out, &offset, ',', "HSCROLL");
-    if (consume_flag(&remaining, WS_VSCROLL)) append_str(out, &offset, ',', "VSCROLL");
-    if (consume_flag(&remaining, WS_DLGFRAME)) append_str(out, &offset, ',', "DLGFRAME");
-    if (consume_flag(&remaining, WS_BORDER)) append_str(out, &offset, ',', "BORDER");
-    if (consume_flag(&remaining, WS_MAXIMIZE)) append_str(out, &offset, ',', "MAXIMIZE");
-    if (consume_flag(&remaining, WS_CLIPCHILDREN)) append_str(out, &offset, ',', "CLIPCHILDREN");
-    if (consume_flag(&remaining, WS_CLIPSIBLINGS)) append_str(out, &offset, ',', "CLIPSIBLINGS");
-    if (consume_flag(&remaining, WS_DISABLED)) append_str(out, &offset, ',', "DISABLED");
-    if (consume_flag(&remaining, WS_VISIBLE)) append_str(out, &offset, ',', "VISIBLE");
-    if (consume_flag(&remaining, WS_MINIMIZE)) append_str(out, &offset, ',', "MINIMIZE");
-    if (consume_flag(&remaining, WS_CHILD)) append_str(out, &offset, ',', "CHILD");
-    if (consume_flag(&remaining, WS_POPUP)) append_str(out, &offset, ',', "POPUP");
-    if (remaining) {
-        if (offset > 0) {
-            out[offset] = ',';
-            offset += 1;
-        }
-        offset += sprintf(out + offset, "0x%08x", remaining);
-    }
-    out[offset] = 0;
-
-    return offset;
-}
-
 static const DWORD WND_EX_STYLE_ALL = (
     WS_EX_DLGMODALFRAME
     | WS_EX_NOPARENTNOTIFY
@@ -137,153 +108,105 @@ static const DWORD WND_EX_STYLE_ALL = (
     | WS_EX_NOACTIVATE
 );
 
-// This is calcualted by calling format_wnd_ex_style with 0xffffffff and adding 1
-#define FORMAT_WND_EX_STYLE_BUF_LEN ((size_t)268)
-
-static size_t format_wnd_ex_style(char* out, DWORD ex_style)
-{
-    DWORD remaining = ex_style;
-    size_t offset = 0;
-    if (consume_flag(&remaining, WS_EX_DLGMODALFRAME)) append_str(out, &offset, ',', "DLGMODALFRAME");
-    // No 0x2 flag
-    if (consume_flag(&remaining, WS_EX_NOPARENTNOTIFY)) append_str(out, &offset, ',', "NOPARENTNOTIFY");
-    if (consume_flag(&remaining, WS_EX_TOPMOST)) append_str(out, &offset, ',', "TOPMOST");
-    if (consume_flag(&remaining, WS_EX_ACCEPTFILES)) append_str(out, &offset, ',', "ACCEPTFILES");
-    if (consume_flag(&remaining, WS_EX_TRANSPARENT)) append_str(out, &offset, ',', "TRANSPARENT");
-    if (consume_flag(&remaining, WS_EX_MDICHILD)) append_str(out, &offset, ',', "MDICHILD");
-    if (consume_flag(&remaining, WS_EX_TOOLWINDOW)) append_str(out, &offset, ',', "TOOLWINDOW");
-    if (consume_flag(&remaining, WS_EX_WINDOWEDGE)) append_str(out, &offset, ',', "WINDOWEDGE");
-    if (consume_flag(&remaining, WS_EX_CLIENTEDGE)) append_str(out, &offset, ',', "CLIENTEDGE");
-    if (consume_flag(&remaining, WS_EX_CONTEXTHELP)) append_str(out, &offset, ',', "CONTEXTHELP");
-    // no 0x800 flag
-    if (consume_flag(&remaining, WS_EX_RIGHT)) append_str(out, &offset, ',', "RIGHT");
-    if (consume_flag(&remaining, WS_EX_RTLREADING)) append_str(out, &offset, ',', "RTLREADING");
-    if (consume_flag(&remaining, WS_EX_LEFTSCROLLBAR)) append_str(out, &offset, ',', "LEFTSCROLLBAR");
-    // no 0x8000 flag
-    if (consume_flag(&remaining, WS_EX_CONTROLPARENT)) append_str(out, &offset, ',', "CONTROLPARENT");
-    if (consume_flag(&remaining, WS_EX_STATICEDGE)) append_str(out, &offset, ',', "STATICEDGE");
-    if (consume_flag(&remaining, WS_EX_APPWINDOW)) append_str(out, &offset, ',', "APPWINDOW");
-    if (consume_flag(&remaining, WS_EX_LAYERED)) append_str(out, &offset, ',', "LAYERED");
-    if (consume_flag(&remaining, WS_EX_NOINHERITLAYOUT)) append_str(out, &offset, ',', "NOINHERITLAYOUT");
-    if (consume_flag(&remaining, WS_EX_NOREDIRECTIONBITMAP)) append_str(out, &offset, ',', "NOREDIRECTIONBITMAP");
-    if (consume_flag(&remaining, WS_EX_LAYOUTRTL)) append_str(out, &offset, ',', "LAYOUTRTL");
-    // no 0x0080000 flag
-    // no 0x0100000 flag
-    if (consume_flag(&remaining, WS_EX_COMPOSITED)) append_str(out, &offset, ',', "COMPOSITED");
-    // no 0x0400000 flag
-    if (consume_flag(&remaining, WS_EX_NOACTIVATE)) append_str(out, &offset, ',', "NOACTIVATE");
-    // no 0x1000000 flag
-    // no 0x2000000 flag
-    // no 0x4000000 flag
-    // no 0x8000000 flag
-
-    if (remaining) {
-        if (offset > 0) {
-            out[offset] = ',';
-            offset += 1;
-        }
-        offset += sprintf(out + offset, "0x%08x", remaining);
-    }
-    out[offset] = 0;
-    return offset;
-}
-
-static const char *showwindow_status_str(LPARAM status)
-{
-    switch (status) {
-    case 0: return "ShowWindow";
-    case SW_PARENTCLOSING: return "PARENTCLOSING";
-    case SW_OTHERZOOM: return "OTHERZOOM";
-    case SW_OTHERUNZOOM: return "OTHERUNZOOM";
-    case SW_PARENTOPENING: return "PARENTOPENING";
-    default: return "?";
-    }
-}
-
-// This is calcualted by calling format_swp_flags with 0xffffffff and adding 1
-#define FORMAT_SWP_FLAGS_BUF_LEN ((size_t)155)
-
-static size_t format_swp_flags(char* out, UINT flags)
-{
-    DWORD remaining = flags;
-    size_t offset = 0;
-    if (consume_flag(&remaining, SWP_NOSIZE)) append_str(out, &offset, ',', "NOSIZE");
-    if (consume_flag(&remaining, SWP_NOMOVE)) append_str(out, &offset, ',', "NOMOVE");
-    if (consume_flag(&remaining, SWP_NOZORDER)) append_str(out, &offset, ',', "NOZORDER");
-    if (consume_flag(&remaining, SWP_NOREDRAW)) append_str(out, &offset, ',', "NOREDRAW");
-    if (consume_flag(&remaining, SWP_NOACTIVATE)) append_str(out, &offset, ',', "NOACTIVATE");
-    if (consume_flag(&remaining, SWP_FRAMECHANGED)) append_str(out, &offset, ',', "FRAMECHANGED");
-    if (consume_flag(&remaining, SWP_SHOWWINDOW)) append_str(out, &offset, ',', "SHOWWINDOW");
-    if (consume_flag(&remaining, SWP_HIDEWINDOW)) append_str(out, &offset, ',', "HIDEWINDOW");
-    if (consume_flag(&remaining, SWP_NOCOPYBITS)) append_str(out, &offset, ',', "NOCOPYBITS");
-    if (consume_flag(&remaining, SWP_NOOWNERZORDER)) append_str(out, &offset, ',', "NOOWNERZORDER");
-    if (consume_flag(&remaining, SWP_NOSENDCHANGING)) append_str(out, &offset, ',', "NOSENDCHANGING");
-    if (consume_flag(&remaining, SWP_DEFERERASE)) append_str(out, &offset, ',', "DEFERERASE");
-    if (consume_flag(&remaining, SWP_ASYNCWINDOWPOS)) append_str(out, &offset, ',', "ASYNCWINDOWPOS");
-    if (remaining) {
-        if (offset > 0) {
-            out[offset] = ',';
-            offset += 1;
-        }
-        offset += sprintf(out + offset, "0x%08x", remaining);
-    }
-    out[offset] = 0;
-    return offset;
-}
-
-static const char* ime_notify_code_str(WPARAM code)
-{
-    switch (code) {
-    case IMN_CLOSESTATUSWINDOW: return "CLOSESTATUSWINDOW";
-    case IMN_OPENSTATUSWINDOW: return "OPENSTATUSWINDOW";
-    case IMN_CHANGECANDIDATE: return "CHANGECANDIDATE";
-    case IMN_CLOSECANDIDATE: return "CLOSECANDIDATE";
-    case IMN_OPENCANDIDATE: return "OPENCANDIDATE";
-    case IMN_SETCONVERSIONMODE: return "SETCONVERSIONMODE";
-    case IMN_SETSENTENCEMODE: return "SETSENTENCEMODE";
-    case IMN_SETOPENSTATUS: return "SETOPENSTATUS";
-    case IMN_SETCANDIDATEPOS: return "SETCANDIDATEPOS";
-    case IMN_SETCOMPOSITIONFONT: return "SETCOMPOSITIONFONT";
-    case IMN_SETCOMPOSITIONWINDOW: return "SETCOMPOSITIONWINDOW";
-    case IMN_GUIDELINE: return "GUIDELINE";
-    case IMN_PRIVATE: return "PRIVATE";
-    default: return "?";
-    }
-}
-
-static const char* get_hit_str(WPARAM hit_test_area)
-{
-    switch (hit_test_area) {
-    case HTBORDER: return "BORDER";
-    case HTBOTTOM: return "BOTTOM";
-    case HTBOTTOMLEFT: return "BOTTOMLEFT";
-    case HTBOTTOMRIGHT: return "BOTTOMRIGHT";
-    case HTCAPTION: return "CAPTION";
-    case HTCLIENT: return "CLIENT";
-    case HTCLOSE: return "CLOSE";
-    case HTERROR: return "ERROR";
-    case HTGROWBOX: return "GROWBOX";
-    case HTHELP: return "HELP";
-    case HTHSCROLL: return "HSCROLL";
-    case HTLEFT: return "LEFT";
-    case HTMENU: return "MENU";
-    case HTMAXBUTTON: return "MAXBUTTON";
-    case HTMINBUTTON: return "MINBUTTON";
-    case HTNOWHERE: return "NOWHERE";
-    case HTRIGHT: return "RIGHT";
-    case HTSYSMENU: return "SYSMENU";
-    case HTTOP: return "TOP";
-    case HTTOPLEFT: return "TOPLEFT";
-    case HTTOPRIGHT: return "TOPRIGHT";
-    case HTVSCROLL: return "VSCROLL";
-    default: return "?";
+// GetRegionData returns the rects in the same y-x banded order as Region
+// uses, so the conversion is a straight append of each rect.  Only bands
+// the system split where Region keeps them merged need joining.
+static void region_from_hrgn(Region* out, HRGN rgn)
+{
+    DWORD size = GetRegionData(rgn, 0, NULL);
+    if (!size) FATAL_WIN32("GetRegionData", GetLastError());
+    RGNDATA* data = (RGNDATA*)malloc(size);
+    ENFORCE(data);
+    if (!GetRegionData(rgn, size, data)) FATAL_WIN32("GetRegionData", GetLastError());
+    const RECT* rects = (const RECT*)data->Buffer;
+    RegionClear(out);
+    for (DWORD i = 0; i < data->rdh.nCount; i++) {
+        RegionAppendRect(out, rects[i].left, rects[i].top, rects[i].right, rects[i].bottom);
+    }
+    RegionAppendEnd(out);
+    free(data);
+}
+
+static uint64_t now_ns(void)
+{
+    static uint64_t frequency = 0;
+    if (!frequency) {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        frequency = f.QuadPart;
     }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)(counter.QuadPart / frequency) * 1000000000 +
+        (uint64_t)(counter.QuadPart % frequency) * 1000000000 / frequency;
+}
+
+// When this process was created, on the now_ns clock
+static uint64_t process_start_ns(void)
+{
+    FILETIME created, exited, kernel, user, now;
+    if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) {
+        FATAL_WIN32("GetProcessTimes", GetLastError());
+    }
+    GetSystemTimePreciseAsFileTime(&now);
+    const uint64_t ns = now_ns();
+    // FILETIMEs count 100ns intervals
+    const uint64_t age = ((((uint64_t)now.dwHighDateTime << 32) | now.dwLowDateTime) -
+        (((uint64_t)created.dwHighDateTime << 32) | created.dwLowDateTime)) * 100;
+    return (age < ns) ? ns - age : 0;
 }
 
 // --------------------------------------------------------------------------------
 // This application
 // --------------------------------------------------------------------------------
 
+// Build with /DSELF_CHECKS=0 to leave out the startup checks of the
+// constant tables, they can only fail after editing them
+#ifndef SELF_CHECKS
+#define SELF_CHECKS 1
+#endif
+
+// Build with /DPROFILE_HANDLERS=1 to log what each message's handler costs
+// in cycles when the window closes, see HandlerProfile.h
+#ifndef PROFILE_HANDLERS
+#define PROFILE_HANDLERS 0
+#endif
+
+// Build with /DTRACE_RING=1 to publish every message and how long its
+// handler took to a shared memory ring named basics-<pid>-<thread>, for
+// monitor.exe to show live
+#ifndef TRACE_RING
+#define TRACE_RING 0
+#endif
+#define TRACE_RING_CAPACITY (1 << 16)
+
+// Build with /DTRACE_FILE=1 to record every message to
+// trace-<pid>-<thread>.bin, for tracediff.exe to compare with the trace of
+// another build
+#ifndef TRACE_FILE
+#define TRACE_FILE 0
+#endif
+
+// Session statistics are written to stats-<pid>-<thread>.csv and .json
+// when the window closes.  Build with /DSTATS_EXPORT_MS=n to also write
+// them every n milliseconds, in case the session doesn't end cleanly.
+#ifndef STATS_EXPORT_MS
+#define STATS_EXPORT_MS 0
+#endif
+
+// Build with /DSCENARIOS=1 to drive each window through the Workload
+// scenarios once it has painted, log what each one cost and close it.
+// Allocations are only counted with the debug CRT (/MTd or /MDd), basics.bat
+// builds out\scenarios.exe that way.
+#ifndef SCENARIOS
+#define SCENARIOS 0
+#endif
+#define SCENARIO_SAMPLES (1 << 20)
+
+// From process creation to the end of the first window's first WM_PAINT,
+// logged right after it
+static StartupProfile global_startup;
+
 
 static const WCHAR* WND_CLASS = L"BasicsWindow";
 static const WCHAR* WND_NAME = L"Basics";
@@ -298,32 +221,741 @@ static const DWORD WND_STYLE = (
 static const DWORD WND_EX_STYLE = WS_EX_WINDOWEDGE;
 #define CREATE_PARAMS_MAGIC ((void*)0x017e3919)
 
-static void CheckHwnd(HWND hwnd)
+// The window's state as of the last message that reported a change to
+// it, so CheckHwnd can validate every message without asking the system.
+// WndProc keeps it current from WM_WINDOWPOSCHANGED, WM_SIZE, WM_MOVE,
+// WM_SETTEXT and WM_STYLECHANGED.
+typedef struct {
+    bool valid; // false until queried, or after a change no message reports
+    bool pos_pending; // between WM_WINDOWPOSCHANGING and WM_WINDOWPOSCHANGED
+    DWORD style;
+    DWORD ex_style;
+    // screen coordinates, WM_NCHITTEST points are translated by this
+    RECT window_rect;
+    POINT client_origin; // screen coordinates
+    SIZE client_size;
+    WCHAR title[64]; // truncated like GetWindowTextW would
+} WindowSnapshot;
+
+// Build with /DCHECK_HWND=0 to skip validating the window on every message
+#ifndef CHECK_HWND
+#define CHECK_HWND 1
+#endif
+// every this many messages the snapshot is compared against the system
+#define CHECK_HWND_FULL_INTERVAL 64
+// Build with /DCHECK_HWND_RESIZE=1 to move and resize the hidden window
+// before showing it and check the snapshot followed, it's too slow for
+// every launch
+#ifndef CHECK_HWND_RESIZE
+#define CHECK_HWND_RESIZE 0
+#endif
+// ShowWindow and friends flip these without sending WM_STYLECHANGED
+#define WND_STYLE_STATE (WS_VISIBLE | WS_MINIMIZE | WS_MAXIMIZE | WS_DISABLED)
+
+static void query_window(HWND hwnd, WindowSnapshot* window)
 {
-    // TODO: check everything we can about the hwnd, is the style correct?
-    //       the size? the Name/Class, etc
+    window->style = (DWORD)GetWindowLongW(hwnd, GWL_STYLE);
+    window->ex_style = (DWORD)GetWindowLongW(hwnd, GWL_EXSTYLE);
+    if (!GetWindowRect(hwnd, &window->window_rect)) FATAL_WIN32("GetWindowRect", GetLastError());
+    RECT client;
+    if (!GetClientRect(hwnd, &client)) FATAL_WIN32("GetClientRect", GetLastError());
+    window->client_size.cx = client.right;
+    window->client_size.cy = client.bottom;
+    window->client_origin.x = 0;
+    window->client_origin.y = 0;
+    ENFORCE(ClientToScreen(hwnd, &window->client_origin));
+    window->title[0] = 0;
+    GetWindowTextW(hwnd, window->title, ARRAYSIZE(window->title));
+    window->valid = true;
 }
 
+static void set_window_title(WindowSnapshot* window, const WCHAR* title)
+{
+    size_t i = 0;
+    for (; title && title[i] && i + 1 < ARRAYSIZE(window->title); i++) {
+        window->title[i] = title[i];
+    }
+    window->title[i] = 0;
+}
 
-HWND global_hwnd = NULL;
-unsigned global_msg_count = 0;
-unsigned global_wnd_pos_changing = 0;
-unsigned global_wnd_pos_changed = 0;
 
-LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
+// Worker threads hand results to a UI thread with PostWork.  Items are
+// queued without locks and only the first item into an empty queue posts
+// WM_APP_WORK, the UI thread then runs the whole batch at once.
+#define WM_APP_WORK (WM_APP + 0)
+// Posted once the window has painted, with SCENARIOS
+#define WM_APP_SCENARIOS (WM_APP + 1)
+
+typedef struct WorkItem {
+    MpscNode node; // must be first
+    void (*run)(struct WorkItem*);
+} WorkItem;
+
+// UI callbacks are scheduled on a timer wheel with millisecond ticks.  A
+// single OS timer is kept armed for the wheel's next wakeup no matter how
+// many callbacks are pending.
+#define TIMER_ID_WHEEL 1
+#define TIMER_NOT_ARMED UINT64_MAX
+
+// The order messages may arrive in, every window's stream is checked
+// against these as it's dispatched.  See MsgSequence.h for the syntax.
+static const MsgSeqRule MSG_RULES[] = {
+    { "creation order", "WM_GETMINMAXINFO WM_NCCREATE WM_NCCALCSIZE WM_CREATE [^WM_NCCREATE WM_CREATE]*" },
+    { "never destroyed", "[^WM_DESTROY]*" },
+    { "at most one WM_WINDOWPOSCHANGED per WM_WINDOWPOSCHANGING",
+      "( [^WM_WINDOWPOSCHANGED]"
+      " | WM_WINDOWPOSCHANGING [^WM_WINDOWPOSCHANGING WM_WINDOWPOSCHANGED]* WM_WINDOWPOSCHANGED )*" },
+};
+static MsgSeqSpec global_msg_seq_spec;
+
+static bool lookup_msg(const char* name, size_t len, uint32_t* msg)
+{
+    for (uint32_t i = 0; i < WM_USER; i++) {
+        const char* candidate = GetMsgName(i);
+        if (!strncmp(candidate, name, len) && !candidate[len]) {
+            *msg = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Each UI thread owns one window and runs its own message loop.  All the
+// state that loop touches lives here and is only written by the owning
+// thread, other threads only push to work_queue (see PostWork).
+typedef struct __declspec(align(64)) UiThread {
+    MpscQueue work_queue; // first, it's the only field other threads write
+    HWND hwnd;
+    unsigned msg_count;
+    MsgSeqVerifier msg_seq;
+    // names of the registered messages this thread has seen
+    MsgNameCache msg_names;
+    HandlerProfile* handler_profile; // NULL unless PROFILE_HANDLERS
+    // timed with GetTickCount64, it's cheaper than now_ns and a second
+    // resolution is all the rates need
+    SessionStats stats;
+    Timer stats_timer;
+    TraceRing trace; // header is NULL unless TRACE_RING
+    TraceFile trace_file; // file is NULL unless TRACE_FILE
+    unsigned wnd_pos_changing;
+    unsigned wnd_pos_changed;
+    WindowSnapshot window;
+    // a timer read costs more than the snapshot checks, only one message
+    // in CHECK_HWND_FULL_INTERVAL is timed
+    uint64_t check_hwnd_ns;
+    unsigned check_hwnd_samples;
+    uint64_t full_check_hwnd_ns;
+    unsigned full_check_hwnd_count;
+    HitTestGrid hit_test;
+    // the exact areas being repainted, instead of just their bounding boxes
+    Region nc_update;
+    Region update;
+    HBRUSH background; // COLOR_WINDOW, WM_ERASEBKGND fills the update region with it
+    TimerWheel timers;
+    uint64_t timer_armed_tick;
+    // every mouse position since the last frame, see add_mouse_move
+    PointerBatch pointer;
+    bool last_mouse_valid;
+    MOUSEMOVEPOINT last_mouse;
+    // background work for this window, throttled while it's in the background
+    TaskScheduler* tasks;
+    bool active;
+    bool minimized;
+    // the document, drawn in SYSTEM_FIXED_FONT so a column is always
+    // char_width pixels
+    TextEditor editor;
+    int line_height;
+    int char_width;
+    bool has_caret;
+    // every message's latency goes here while a scenario runs
+    WorkloadStats* scenario;
+    bool scenarios_posted;
+    // scratch for ImmGetCompositionStringW
+    TextChar* ime_text;
+    size_t ime_capacity;
+} UiThread;
+
+// Build with /DUI_THREAD_COUNT=N to run N windows on N threads
+#ifndef UI_THREAD_COUNT
+#define UI_THREAD_COUNT 1
+#endif
+UiThread global_ui_threads[UI_THREAD_COUNT];
+static __declspec(thread) UiThread* thread_ui = NULL;
+
+static uint64_t now_ms(void)
+{
+    return now_ns() / 1000000;
+}
+
+// Registered messages and clipboard formats are atoms in the same table,
+// so the clipboard API names both
+static size_t resolve_registered_msg(void* context, uint32_t msg, char* out, size_t size)
 {
-    global_msg_count++;
+    (void)context;
+    const int len = GetClipboardFormatNameA(msg, out, (int)size);
+    return (len > 0) ? (size_t)len : 0;
+}
 
-    if (global_hwnd) ENFORCE_EQ("", "%p", global_hwnd, hwnd);
-    global_hwnd = hwnd;
+// GetMsgName plus the registered messages, for the calling UI thread
+static const char* msg_name(uint32_t msg)
+{
+    const char* name = MsgNameCacheGet(&thread_ui->msg_names, msg);
+    return name ? name : GetMsgName(msg);
+}
 
-    CheckHwnd(hwnd);
+static void ui_thread_init(UiThread* ui)
+{
+    MpscQueueInit(&ui->work_queue);
+    ui->hwnd = NULL;
+    ui->msg_count = 0;
+    MsgSeqVerifierInit(&ui->msg_seq, &global_msg_seq_spec);
+    MsgNameCacheInit(&ui->msg_names, resolve_registered_msg, NULL);
+    ui->handler_profile = PROFILE_HANDLERS ? HandlerProfileCreate() : NULL;
+    SessionStatsInit(&ui->stats, GetTickCount64());
+    memset(&ui->stats_timer, 0, sizeof(ui->stats_timer));
+    memset(&ui->trace, 0, sizeof(ui->trace));
+    if (TRACE_RING) {
+        char name[64];
+        snprintf(name, sizeof(name), "basics-%lu-%u", GetCurrentProcessId(), (unsigned)(ui - global_ui_threads));
+        if (TraceRingCreate(&ui->trace, name, TRACE_RING_CAPACITY, GetCurrentProcessId())) LOG("tracing to %s", name);
+        else LOG("couldn't create trace ring %s", name);
+    }
+    memset(&ui->trace_file, 0, sizeof(ui->trace_file));
+    if (TRACE_FILE) {
+        char path[64];
+        snprintf(path, sizeof(path), "trace-%lu-%u.bin", GetCurrentProcessId(), (unsigned)(ui - global_ui_threads));
+        if (TraceFileCreate(&ui->trace_file, path)) LOG("recording to %s", path);
+        else LOG("couldn't create %s", path);
+    }
+    ui->wnd_pos_changing = 0;
+    ui->wnd_pos_changed = 0;
+    memset(&ui->window, 0, sizeof(ui->window));
+    ui->check_hwnd_ns = 0;
+    ui->check_hwnd_samples = 0;
+    ui->full_check_hwnd_ns = 0;
+    ui->full_check_hwnd_count = 0;
+    HitTestInit(&ui->hit_test);
+    RegionInit(&ui->nc_update);
+    RegionInit(&ui->update);
+    ui->background = CreateSolidBrush(GetSysColor(COLOR_WINDOW));
+    if (!ui->background) FATAL_WIN32("CreateSolidBrush", GetLastError());
+    TimerWheelInit(&ui->timers, now_ms());
+    ui->timer_armed_tick = TIMER_NOT_ARMED;
+    PointerBatchInit(&ui->pointer);
+    ui->last_mouse_valid = false;
+    // split the cores between the UI threads, a window in the background
+    // keeps one worker
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    const uint32_t workers = info.dwNumberOfProcessors / UI_THREAD_COUNT;
+    ui->tasks = TaskSchedulerCreate(workers ? workers : 1, 1, now_ns());
+    ui->active = false;
+    ui->minimized = false;
+    TextEditorInit(&ui->editor, NULL, 0);
+    ui->line_height = 0;
+    ui->char_width = 0;
+    ui->has_caret = false;
+    ui->scenario = NULL;
+    ui->scenarios_posted = false;
+    ui->ime_text = NULL;
+    ui->ime_capacity = 0;
+    // Custom window chrome registers its hot zones here, for example a
+    // 46x30 close button that follows the top-right corner of the window:
+    // HitRegion close = { -46, 0, 0, 30, HIT_ANCHOR_LEFT_FAR | HIT_ANCHOR_RIGHT_FAR, HTCLOSE };
+    // HitTestAddRegion(&ui->hit_test, &close);
+}
 
-    //LOG("WndProc msg=%s(%u)", GetMsgName(msg), msg);
+// Hands an item to a UI thread (possibly the calling one), it runs on
+// that thread inside WM_APP_WORK.  Can be called from any thread once the
+// target's window exists.
+void PostWork(UiThread* target, WorkItem* item)
+{
+    if (MpscQueuePush(&target->work_queue, &item->node)) {
+        if (!PostMessage(target->hwnd, WM_APP_WORK, 0, 0)) FATAL_WIN32("PostMessage", GetLastError());
+    }
+}
+
+static void arm_os_timer(UiThread* ui)
+{
+    uint64_t tick;
+    if (!TimerWheelNextWakeup(&ui->timers, &tick)) return;
+    // an OS timer that's armed too early just causes an extra WM_TIMER
+    if (tick >= ui->timer_armed_tick) return;
+    const uint64_t now = now_ms();
+    const UINT delay = (tick > now) ? (UINT)(tick - now) : 0;
+    if (!SetTimer(ui->hwnd, TIMER_ID_WHEEL, delay, NULL)) FATAL_WIN32("SetTimer", GetLastError());
+    ui->timer_armed_tick = tick;
+}
+
+// UI threads only, once the window exists.  The callback runs on the
+// calling thread.
+void ScheduleTimer(Timer* timer, uint32_t delay_ms, void (*callback)(Timer*))
+{
+    UiThread* ui = thread_ui;
+    timer->callback = callback;
+    TimerWheelAdd(&ui->timers, timer, now_ms() + delay_ms);
+    arm_os_timer(ui);
+}
+void CancelTimer(Timer* timer)
+{
+    // leaves the OS timer armed, WM_TIMER re-arms or kills it when it fires
+    TimerWheelCancel(&thread_ui->timers, timer);
+}
+
+// Can be called from any thread, including from inside a task
+void SubmitTask(UiThread* target, Task* task)
+{
+    TaskSchedulerSubmit(target->tasks, task);
+}
+
+// Windows only reports the latest position when the mouse moves several
+// times between two GetMessage calls.  GetMouseMovePointsEx remembers the
+// last 64 points it went through, this adds the ones since the previous
+// WM_MOUSEMOVE before the one this message reports.
+static void add_mouse_move(UiThread* ui, HWND hwnd, POINT client, WPARAM keys, DWORD time)
+{
+    const uint16_t buttons = (uint16_t)(keys & POINTER_BUTTONS);
+    const uint16_t modifiers = (uint16_t)(keys & POINTER_MODS);
+    POINT screen = client;
+    ENFORCE(ClientToScreen(hwnd, &screen));
+    MOUSEMOVEPOINT current = { screen.x & 0xffff, screen.y & 0xffff, time, 0 };
+    if (ui->last_mouse_valid) {
+        MOUSEMOVEPOINT points[64];
+        // newest first starting at current, -1 if current already fell
+        // out of the history
+        const int count = GetMouseMovePointsEx(sizeof(MOUSEMOVEPOINT), &current, points, ARRAYSIZE(points), GMMP_USE_DISPLAY_POINTS);
+        int end = 1;
+        while (end < count) {
+            const MOUSEMOVEPOINT* point = &points[end];
+            if (point->time < ui->last_mouse.time) break;
+            if (point->time == ui->last_mouse.time && point->x == ui->last_mouse.x && point->y == ui->last_mouse.y) break;
+            end++;
+        }
+        for (int i = end - 1; i >= 1; i--) {
+            // display points are 16 bits, monitors left of or above the
+            // primary one have negative coordinates
+            POINT p = { points[i].x, points[i].y };
+            if (p.x > 32767) p.x -= 65536;
+            if (p.y > 32767) p.y -= 65536;
+            ENFORCE(ScreenToClient(hwnd, &p));
+            // the keys are only known for the points that got a message
+            PointerBatchAdd(&ui->pointer, p.x, p.y, buttons, modifiers, points[i].time);
+        }
+    }
+    PointerBatchAdd(&ui->pointer, client.x, client.y, buttons, modifiers, time);
+    ui->last_mouse = current;
+    ui->last_mouse_valid = true;
+}
+
+// Runs once per frame with every mouse position since the last frame
+static void on_pointer_batch(const PointerBatch* batch)
+{
+    const PointerState* state = &batch->state;
+    LOG("pointer: %u samples, now %d,%d moved %d,%d buttons=0x%x modifiers=0x%x pressed=0x%x released=0x%x",
+        batch->count, state->x, state->y, state->dx, state->dy,
+        state->buttons, state->modifiers, state->pressed, state->released);
+    // Drawing and drag code walks batch->x[i], batch->y[i] for every point
+    // here instead of handling WM_MOUSEMOVE one at a time
+}
+
+static void flush_pointer(UiThread* ui)
+{
+    if (!ui->pointer.count) return;
+    on_pointer_batch(&ui->pointer);
+    PointerBatchClear(&ui->pointer);
+}
+
+static void update_task_state(UiThread* ui)
+{
+    TaskState state = TASK_STATE_ACTIVE;
+    if (ui->minimized) state = TASK_STATE_MINIMIZED;
+    else if (!ui->active) state = TASK_STATE_INACTIVE;
+    TaskSchedulerSetState(ui->tasks, state, now_ns());
+}
+
+// Invalidates only the lines the edits since the last call touched, then
+// puts the caret after the text (and into the composition, if any)
+static void text_changed(UiThread* ui, HWND hwnd)
+{
+    TextEditor* editor = &ui->editor;
+    size_t first, last;
+    if (TextEditorTakeDirty(editor, &first, &last)) {
+        const LONG height = ui->window.client_size.cy;
+        const size_t visible = (size_t)(height / ui->line_height) + 1;
+        if (first < visible) {
+            RECT rect = { 0, (LONG)first * ui->line_height, ui->window.client_size.cx, height };
+            if (last < visible) rect.bottom = (LONG)(last + 1) * ui->line_height;
+            // WM_PAINT draws the lines opaque, nothing to erase
+            if (!InvalidateRect(hwnd, &rect, FALSE)) FATAL_WIN32("InvalidateRect", GetLastError());
+        }
+    }
+    if (ui->has_caret) {
+        const int x = (int)(editor->caret_column + editor->composition_caret) * ui->char_width;
+        const int y = (int)editor->caret_line * ui->line_height;
+        if (!SetCaretPos(x, y)) FATAL_WIN32("SetCaretPos", GetLastError());
+    }
+}
+
+// Draws one line between left and right, past the end of the document as
+// blank.  The composition is shown in place at the caret.
+static void paint_line(UiThread* ui, HDC hdc, size_t line, LONG left, LONG right)
+{
+    const TextEditor* editor = &ui->editor;
+    const TextBuffer* buffer = &editor->buffer;
+    // only what fits in the window is copied out of the buffer
+    TextChar text[1024];
+    size_t columns = (size_t)(ui->window.client_size.cx / ui->char_width) + 1;
+    if (columns > ARRAYSIZE(text)) columns = ARRAYSIZE(text);
+    size_t length = 0;
+    if (line < TextBufferLineCount(buffer)) {
+        length = TextBufferLineLength(buffer, line);
+        if (length > columns) length = columns;
+        TextBufferCopy(buffer, TextBufferLineStart(buffer, line), length, text);
+    }
+    const size_t column = editor->caret_column;
+    if (line == editor->caret_line && editor->composition_length && column < columns) {
+        size_t insert = editor->composition_length;
+        if (insert > columns - column) insert = columns - column;
+        size_t tail = length - column;
+        if (tail > columns - column - insert) tail = columns - column - insert;
+        memmove(text + column + insert, text + column, tail * sizeof(TextChar));
+        memcpy(text + column, editor->composition, insert * sizeof(TextChar));
+        length = column + insert + tail;
+    }
+    const RECT line_rect = { left, (LONG)line * ui->line_height, right, (LONG)(line + 1) * ui->line_height };
+    if (!ExtTextOutW(hdc, 0, line_rect.top, ETO_OPAQUE | ETO_CLIPPED, &line_rect, text, (UINT)length, NULL)) {
+        FATAL_WIN32("ExtTextOutW", GetLastError());
+    }
+}
+
+// Draws each line the update region crosses once, as wide as the spans
+// crossing it.  Lines between two damaged areas aren't touched.
+static void paint_text(UiThread* ui, HDC hdc, const Region* update)
+{
+    if (!SelectObject(hdc, GetStockObject(SYSTEM_FIXED_FONT))) FATAL_WIN32("SelectObject", GetLastError());
+    SetTextColor(hdc, GetSysColor(COLOR_WINDOWTEXT));
+    SetBkColor(hdc, GetSysColor(COLOR_WINDOW));
+
+    const int32_t line_height = ui->line_height;
+    size_t next = 0; // lines above this were painted for an earlier band
+    for (uint32_t i = 0; i < update->band_count; i++) {
+        const RegionBand* band = &update->bands[i];
+        size_t line = (size_t)(band->top / line_height);
+        if (line < next) line = next;
+        const size_t last = (size_t)((band->bottom - 1) / line_height);
+        if (last < line) continue;
+        for (; line <= last; line++) {
+            // the bands are sorted and don't overlap, the ones crossing
+            // this line start at this one
+            const int32_t line_bottom = (int32_t)(line + 1) * line_height;
+            LONG left = INT32_MAX, right = INT32_MIN;
+            for (uint32_t j = i; j < update->band_count && update->bands[j].top < line_bottom; j++) {
+                const RegionBand* crossing = &update->bands[j];
+                const RegionSpan* spans = &update->spans[crossing->span_start];
+                if (spans[0].left < left) left = spans[0].left;
+                if (spans[crossing->span_count - 1].right > right) right = spans[crossing->span_count - 1].right;
+            }
+            paint_line(ui, hdc, line, left, right);
+        }
+        next = last + 1;
+    }
+}
+
+// Reads one of the IME's strings (GCS_COMPSTR or GCS_RESULTSTR) into
+// ui->ime_text, returns its length
+static size_t get_ime_string(UiThread* ui, HIMC imc, DWORD index)
+{
+    const LONG bytes = ImmGetCompositionStringW(imc, index, NULL, 0);
+    if (bytes <= 0) return 0;
+    const size_t length = (size_t)bytes / sizeof(WCHAR);
+    if (length > ui->ime_capacity) {
+        ui->ime_text = (TextChar*)realloc(ui->ime_text, length * sizeof(TextChar));
+        ENFORCE(ui->ime_text);
+        ui->ime_capacity = length;
+    }
+    ENFORCE_EQ("", "%ld", bytes, ImmGetCompositionStringW(imc, index, ui->ime_text, (DWORD)bytes));
+    return length;
+}
+
+// The first of each message that gets a window on screen, for the first
+// UI thread's window
+static void profile_startup_msg(UiThread* ui, UINT msg)
+{
+    // only thread 0 writes global_startup, check that first so the other
+    // threads never read it
+    if (ui != &global_ui_threads[0] || global_startup.done) return;
+    switch (msg) {
+    case WM_NCCREATE: StartupProfileFirst(&global_startup, 0, "first WM_NCCREATE", now_ns()); break;
+    case WM_CREATE: StartupProfileFirst(&global_startup, 1, "first WM_CREATE", now_ns()); break;
+    case WM_SIZE: StartupProfileFirst(&global_startup, 2, "first WM_SIZE", now_ns()); break;
+    case WM_ERASEBKGND: StartupProfileFirst(&global_startup, 3, "first WM_ERASEBKGND", now_ns()); break;
+    case WM_PAINT: StartupProfileFirst(&global_startup, 4, "first WM_PAINT", now_ns()); break;
+    default: break;
+    }
+}
+
+static void log_startup(void)
+{
+    const uint64_t total = StartupProfileFinish(&global_startup, "first WM_PAINT done", now_ns());
+    char report[STARTUP_MAX_MARKS * 64];
+    StartupProfileFormat(&global_startup, report, sizeof(report));
+    LOG("startup, since process creation:\n%s", report);
+    LOG("time to first paint: %.3f ms", total / 1e6);
+}
+
+static void stats_key_name(StatsHistogramId id, uint32_t key, char* out, size_t size)
+{
+    switch (id) {
+    case STATS_HIT_TEST: snprintf(out, size, "%s", GetHitStr((int32_t)key)); return;
+    case STATS_SWP_FLAGS: {
+        char buf[FORMAT_SWP_FLAGS_BUF_LEN];
+        FormatSwpFlags(buf, key);
+        snprintf(out, size, "%s", buf);
+        return;
+    }
+    case STATS_SIZE_TYPE: snprintf(out, size, "%s", SizeTypeStr(key)); return;
+    case STATS_IME_NOTIFY: snprintf(out, size, "%s", ImeNotifyCodeStr(key)); return;
+    case STATS_HIGH_MSGS:
+    case STATS_HISTOGRAM_COUNT: break;
+    }
+    UNREACHABLE();
+}
+
+static void export_stats(UiThread* ui)
+{
+    static const StatsNames names = { msg_name, stats_key_name };
+    const uint64_t now = GetTickCount64();
+    const unsigned index = (unsigned)(ui - global_ui_threads);
+    char path[64];
+    snprintf(path, sizeof(path), "stats-%lu-%u.csv", GetCurrentProcessId(), index);
+    FILE* file = fopen(path, "w");
+    if (!file || !SessionStatsWriteCsv(&ui->stats, &names, now, file)) LOG("writing %s failed", path);
+    if (file) fclose(file);
+    snprintf(path, sizeof(path), "stats-%lu-%u.json", GetCurrentProcessId(), index);
+    file = fopen(path, "w");
+    if (!file || !SessionStatsWriteJson(&ui->stats, &names, now, file)) LOG("writing %s failed", path);
+    if (file) fclose(file);
+    LOG("stats: %llu messages written to stats-%lu-%u.csv/.json",
+        ui->stats.messages, GetCurrentProcessId(), index);
+}
+
+static void on_stats_timer(Timer* timer)
+{
+    export_stats(thread_ui);
+    ScheduleTimer(timer, STATS_EXPORT_MS, on_stats_timer);
+}
+
+// Compares the snapshot with what the system reports
+static void check_hwnd_full(UiThread* ui, HWND hwnd)
+{
+    const WindowSnapshot* window = &ui->window;
+    WindowSnapshot actual;
+    query_window(hwnd, &actual);
+    ENFORCE_EQ("0x", "%x", window->style & ~WND_STYLE_STATE, actual.style & ~WND_STYLE_STATE);
+    ENFORCE_EQ("0x", "%x", window->ex_style, actual.ex_style);
+    ENFORCE(EqualRect(&window->window_rect, &actual.window_rect));
+    ENFORCE_EQ("", "%d", window->client_size.cx, actual.client_size.cx);
+    ENFORCE_EQ("", "%d", window->client_size.cy, actual.client_size.cy);
+    // a minimized window's client origin isn't reported consistently
+    if (!ui->minimized) {
+        ENFORCE_EQ("", "%d", window->client_origin.x, actual.client_origin.x);
+        ENFORCE_EQ("", "%d", window->client_origin.y, actual.client_origin.y);
+    }
+    ENFORCE(!wcscmp(window->title, actual.title));
+    {
+        WCHAR class_name[64];
+        if (!GetClassNameW(hwnd, class_name, ARRAYSIZE(class_name))) FATAL_WIN32("GetClassName", GetLastError());
+        ENFORCE(!wcscmp(WND_CLASS, class_name));
+    }
+}
+
+static void CheckHwnd(UiThread* ui, HWND hwnd)
+{
+    const unsigned phase = ui->msg_count % CHECK_HWND_FULL_INTERVAL;
+    const bool timed = (phase == CHECK_HWND_FULL_INTERVAL / 2);
+    const uint64_t start = timed ? now_ns() : 0;
+    WindowSnapshot* window = &ui->window;
+    if (!window->valid) query_window(hwnd, window);
+
+    // The per message checks only look at the snapshot.  The title isn't
+    // checked against WND_NAME, WM_NCCREATE doesn't call DefWindowProc so
+    // the system never sets it.
+    ENFORCE_EQ("0x", "%x", WND_STYLE, window->style & WND_STYLE);
+    ENFORCE_EQ("0x", "%x", WND_EX_STYLE, window->ex_style & WND_EX_STYLE);
+    ENFORCE(window->client_size.cx <= window->window_rect.right - window->window_rect.left);
+    ENFORCE(window->client_size.cy <= window->window_rect.bottom - window->window_rect.top);
+
+    // Catch drift from a change the snapshot missed.  The system has already
+    // moved the window by the time it sends some of the messages in between
+    // WM_WINDOWPOSCHANGING and WM_WINDOWPOSCHANGED, so skip those.
+    if (phase || window->pos_pending) {
+        if (timed) {
+            ui->check_hwnd_ns += now_ns() - start;
+            ui->check_hwnd_samples++;
+        }
+        return;
+    }
+    const uint64_t full_start = now_ns();
+    check_hwnd_full(ui, hwnd);
+    ui->full_check_hwnd_ns += now_ns() - full_start;
+    ui->full_check_hwnd_count++;
+}
+
+// --------------------------------------------------------------------------------
+// Scenarios
+// --------------------------------------------------------------------------------
+
+// Counted by the debug CRT's allocation hook, release builds have no hook
+static __declspec(thread) uint64_t thread_allocations = 0;
+
+#ifdef _DEBUG
+static int count_allocation(int type, void* data, size_t size, int block_type, long request,
+    const unsigned char* file, int line)
+{
+    if (type == _HOOK_ALLOC || type == _HOOK_REALLOC) thread_allocations++;
+    return TRUE;
+}
+#endif
+
+// Dispatches what the scenario posted, the way message_loop would
+static void pump_posted(UiThread* ui)
+{
+    MSG msg;
+    while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+        if (msg.message == WM_QUIT) {
+            // for message_loop to see
+            PostQuitMessage((int)msg.wParam);
+            return;
+        }
+        DispatchMessage(&msg);
+        flush_pointer(ui);
+    }
+}
+
+// Turns a step into the messages Windows sends for it.  The window is
+// at window_rect in screen coordinates when the scenario starts.
+static void play_step(UiThread* ui, HWND hwnd, const RECT* window_rect, const UINT* strings, const WorkloadStep* step)
+{
+    switch (step->kind) {
+    case WORKLOAD_STEP_RESIZE:
+        // the system paints after every move of a drag
+        if (!SetWindowPos(hwnd, NULL, 0, 0, step->a, step->b, SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE)) {
+            FATAL_WIN32("SetWindowPos", GetLastError());
+        }
+        if (!UpdateWindow(hwnd)) FATAL_WIN32("UpdateWindow", GetLastError());
+        return;
+    case WORKLOAD_STEP_POINTER: {
+        POINT p = { window_rect->left + step->a, window_rect->top + step->b };
+        const LRESULT hit = SendMessage(hwnd, WM_NCHITTEST, 0, MAKELPARAM(p.x, p.y));
+        SendMessage(hwnd, WM_SETCURSOR, (WPARAM)hwnd, MAKELPARAM(hit, WM_MOUSEMOVE));
+        if (hit == HTCLIENT) {
+            if (!ScreenToClient(hwnd, &p)) FATAL_WIN32("ScreenToClient", GetLastError());
+            SendMessage(hwnd, WM_MOUSEMOVE, 0, MAKELPARAM(p.x, p.y));
+            flush_pointer(ui);
+        } else {
+            SendMessage(hwnd, WM_NCMOUSEMOVE, (WPARAM)hit, MAKELPARAM(p.x, p.y));
+        }
+        return;
+    }
+    case WORKLOAD_STEP_ACTIVATE:
+        // as if another of our windows took the activation and gave it back
+        if (step->a) {
+            SendMessage(hwnd, WM_NCACTIVATE, TRUE, 0);
+            SendMessage(hwnd, WM_ACTIVATE, WA_ACTIVE, 0);
+            SetFocus(hwnd);
+        } else {
+            SendMessage(hwnd, WM_NCACTIVATE, FALSE, 0);
+            SendMessage(hwnd, WM_ACTIVATE, WA_INACTIVE, 0);
+            SetFocus(NULL);
+        }
+        return;
+    case WORKLOAD_STEP_STRING:
+        if (!PostMessage(hwnd, strings[step->a], 0, 0)) FATAL_WIN32("PostMessage", GetLastError());
+        return;
+    default:
+        UNREACHABLE();
+    }
+}
+
+static void run_scenario(UiThread* ui, HWND hwnd, WorkloadKind kind, const UINT* strings)
+{
+    RECT window_rect;
+    if (!GetWindowRect(hwnd, &window_rect)) FATAL_WIN32("GetWindowRect", GetLastError());
+    const int width = window_rect.right - window_rect.left;
+    const int height = window_rect.bottom - window_rect.top;
+    Workload workload;
+    WorkloadInit(&workload, kind, width, height);
+    WorkloadStats stats;
+    WorkloadStatsInit(&stats, SCENARIO_SAMPLES, now_ns());
+    const uint64_t log_bytes = thread_log_bytes;
+    const uint64_t allocations = thread_allocations;
+
+    ui->scenario = &stats;
+    WorkloadStep step;
+    unsigned posted = 0;
+    while (WorkloadNext(&workload, &step)) {
+        play_step(ui, hwnd, &window_rect, strings, &step);
+        // a thread's queue holds at most 10000 posted messages
+        if (step.kind == WORKLOAD_STEP_STRING && ++posted % 1000 == 0) pump_posted(ui);
+    }
+    pump_posted(ui);
+    ui->scenario = NULL;
+
+    WorkloadStatsFinish(&stats, now_ns());
+    stats.log_bytes = thread_log_bytes - log_bytes;
+#ifdef _DEBUG
+    stats.allocations = (int64_t)(thread_allocations - allocations);
+#else
+    (void)allocations;
+#endif
+    // the next scenario starts from the same size
+    if (!SetWindowPos(hwnd, NULL, 0, 0, width, height, SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE)) {
+        FATAL_WIN32("SetWindowPos", GetLastError());
+    }
+    char line[256];
+    WorkloadStatsFormat(&stats, WorkloadName(kind), line, sizeof(line));
+    LOG("scenario %s", line);
+    WorkloadStatsFree(&stats);
+}
+
+static void run_scenarios(UiThread* ui, HWND hwnd)
+{
+    UINT strings[WORKLOAD_STRINGS];
+    for (unsigned i = 0; i < WORKLOAD_STRINGS; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "BasicsScenario%u", i);
+        strings[i] = RegisterWindowMessageA(name);
+        if (!strings[i]) FATAL_WIN32("RegisterWindowMessage", GetLastError());
+    }
+    for (unsigned kind = 0; kind < WORKLOAD_COUNT; kind++) run_scenario(ui, hwnd, (WorkloadKind)kind, strings);
+    if (!PostMessage(hwnd, WM_CLOSE, 0, 0)) FATAL_WIN32("PostMessage", GetLastError());
+}
+
+static LRESULT handle_msg(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
+{
+    UiThread* ui = thread_ui;
+    ui->msg_count++;
+    profile_startup_msg(ui, msg);
+    SessionStatsMessage(&ui->stats, msg, GetTickCount64());
+    {
+        const int32_t rule = MsgSeqStep(&ui->msg_seq, msg);
+        if (rule >= 0) {
+            char report[1024];
+            MsgSeqFormatViolation(&ui->msg_seq, rule, msg_name, report, sizeof(report));
+            LOG("%s", report);
+            abort();
+        }
+    }
+
+    if (ui->hwnd) ENFORCE_EQ("", "%p", ui->hwnd, hwnd);
+    ui->hwnd = hwnd;
+
+    if (CHECK_HWND) CheckHwnd(ui, hwnd);
+
+    //LOG("WndProc msg=%s(%u)", msg_name(msg), msg);
     switch (msg) {
     case WM_NULL: return 0; // WM_NULL == 0
     case WM_CREATE: { // WM_CREATE == 1
-        ENFORCE_EQ("", "%u", 4, global_msg_count);
         CREATESTRUCT* create = (CREATESTRUCT*)lparam;
         ENFORCE_EQ("", "%p", CREATE_PARAMS_MAGIC, create->lpCreateParams);
         ENFORCE_EQ("", "%p", GetModuleHandleW(NULL), create->hInstance);
@@ -332,7 +964,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
         LOG("WM_NCCREATE %d,%d %dx%d", create->x, create->y, create->cx, create->cy);
         {
             char buf[FORMAT_WND_STYLE_BUF_LEN];
-            format_wnd_style(buf, create->style);
+            FormatWndStyle(buf, create->style);
             LOG("  style=0x%x %s", create->style, buf);
         }
         ENFORCE_EQ("0x", "%x", WND_STYLE, create->style);
@@ -340,10 +972,21 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
         ENFORCE(!wcscmp(WND_CLASS, create->lpszClass));
         {
             char buf[FORMAT_WND_EX_STYLE_BUF_LEN];
-            format_wnd_ex_style(buf, create->dwExStyle);
+            FormatWndExStyle(buf, create->dwExStyle);
             LOG("  exstyle=0x%x %s", create->dwExStyle, buf);
         }
         ENFORCE_EQ("0x", "%x", WND_EX_STYLE, create->dwExStyle);
+
+        HDC hdc = GetDC(hwnd);
+        if (!hdc) FATAL_WIN32("GetDC", GetLastError());
+        if (!SelectObject(hdc, GetStockObject(SYSTEM_FIXED_FONT))) FATAL_WIN32("SelectObject", GetLastError());
+        TEXTMETRICW metrics;
+        if (!GetTextMetricsW(hdc, &metrics)) FATAL_WIN32("GetTextMetricsW", GetLastError());
+        ReleaseDC(hwnd, hdc);
+        ui->line_height = metrics.tmHeight;
+        ui->char_width = metrics.tmAveCharWidth;
+        ENFORCE(ui->line_height > 0 && ui->char_width > 0);
+        if (STATS_EXPORT_MS) ScheduleTimer(&ui->stats_timer, STATS_EXPORT_MS, on_stats_timer);
         return 0;
     }
     case WM_DESTROY: // WM_DESTROY == 2
@@ -352,28 +995,29 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
     case WM_MOVE: { // WM_MOVE == 3
         POINT p = {(short)LOWORD(lparam), (short)HIWORD(lparam)};
         LOG("WM_MOVE %d,%d", p.x, p.y);
+        ui->window.client_origin = p;
         // TODO: paint the window position, so, call invalidate here
         return 0;
     }
     case WM_SIZE: { // WM_SIZE == 5
         WORD width = LOWORD(lparam);
         WORD height = HIWORD(lparam);
-
-        // TODO: verify width/height match size that GetClientRect returns
+        // CheckHwnd's full re-check verifies this against GetClientRect
+        ui->window.client_size.cx = width;
+        ui->window.client_size.cy = height;
 
         // Get the resize type
         WPARAM resize_type = wparam;
-        const char* type_str = "UNKNOWN";
-        switch (resize_type) {
-        case SIZE_MAXIMIZED: type_str = "MAXIMIZED"; break;
-        case SIZE_MINIMIZED: type_str = "MINIMIZED"; break;
-        case SIZE_RESTORED: type_str = "RESTORED"; break;
-        case SIZE_MAXHIDE: type_str = "MAXHIDE"; break;
-        case SIZE_MAXSHOW: type_str = "MAXSHOW"; break;
-        default: break;
-        }
+        SessionStatsAdd(&ui->stats, STATS_SIZE_TYPE, (uint32_t)resize_type);
         LOG("WM_SIZE: type=%s (%llu), width=%u, height=%u",
-            type_str, resize_type, width, height);
+            SizeTypeStr(resize_type), resize_type, width, height);
+        if (resize_type == SIZE_MINIMIZED) {
+            ui->minimized = true;
+            update_task_state(ui);
+        } else if (resize_type == SIZE_RESTORED || resize_type == SIZE_MAXIMIZED) {
+            ui->minimized = false;
+            update_task_state(ui);
+        }
         return 0;
     }
     case WM_ACTIVATE: { // WM_ACTIVATE == 6
@@ -389,35 +1033,37 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
         }
         LOG("WM_ACTIVATE: state=%s (%u) minimized=%d otherWindow=%p",
             state_str, activate_state, minimized, other_window);
-        // This is where you would handle window activation state changes
-        // For example:
-        if (activate_state == WA_INACTIVE) {
-            // Window is being deactivated
-            // You might pause animations or background operations
-        } else {
-            // Window is being activated (either by mouse click or other means)
-            // You might resume animations or background operations
-        }
+        ui->active = (activate_state != WA_INACTIVE);
+        ui->minimized = (minimized != 0);
+        update_task_state(ui);
         return 0;
     }
     case WM_SETFOCUS: { // WM_SETFOCUS == 7
         HWND hwnd_prev_focus = (HWND)wparam;
         LOG("WM_SETFOCUS: previous focus=%p", hwnd_prev_focus);
-
-        // This is where you would handle receiving keyboard focus
-        // For example:
-        // - Creating or showing a caret (text cursor)
-        // - Refreshing or highlighting input areas
-        // - Starting keyboard-related operations
-
-        // If you need a caret, create it here:
-        // CreateCaret(hwnd, NULL, 2, 20); // creates a 2x20 pixel solid caret
-        // SetCaretPos(x, y); // position the caret
-        // ShowCaret(hwnd); // make the caret visible
-
+        // the caret belongs to whichever window has the focus
+        if (!CreateCaret(hwnd, NULL, 2, ui->line_height)) FATAL_WIN32("CreateCaret", GetLastError());
+        ui->has_caret = true;
+        text_changed(ui, hwnd);
+        if (!ShowCaret(hwnd)) FATAL_WIN32("ShowCaret", GetLastError());
         return 0;
     }
+    case WM_KILLFOCUS: { // WM_KILLFOCUS == 8
+        HWND hwnd_next_focus = (HWND)wparam;
+        LOG("WM_KILLFOCUS: next focus=%p", hwnd_next_focus);
+        ui->has_caret = false;
+        if (!DestroyCaret()) FATAL_WIN32("DestroyCaret", GetLastError());
+        return 0;
+    }
+    case WM_SETTEXT: { // WM_SETTEXT == 12
+        const WCHAR* title = (const WCHAR*)lparam;
+        LRESULT result = DefWindowProc(hwnd, msg, wparam, lparam);
+        LOG("WM_SETTEXT => %lld", result);
+        if (result) set_window_title(&ui->window, title);
+        return result;
+    }
     case WM_CLOSE: // WM_CLOSE == 16
+        export_stats(ui);
         PostQuitMessage(0);
         return 0;
     case WM_ERASEBKGND: { // WM_ERASEBKGND == 14
@@ -430,28 +1076,55 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
         }
         ENFORCE_EQ("", "%d", 0, rect.left);
         ENFORCE_EQ("", "%d", 0, rect.top);
-        LOG("WM_ERASEBKGND: %dx%d", rect.right, rect.bottom);
-
-        // examples
-        // HBRUSH brush = CreateSolidBrush(RGB(255, 255, 255));
-        // FillRect(hdc, &rect, brush);
+        // Outside of WM_PAINT there's no update region, erase everything
+        const bool outside_paint = RegionIsEmpty(&ui->update);
+        if (outside_paint) RegionSetRect(&ui->update, rect.left, rect.top, rect.right, rect.bottom);
+        LOG("WM_ERASEBKGND: %dx%d, erasing %u rects area=%lld",
+            rect.right, rect.bottom, RegionRectCount(&ui->update), RegionArea(&ui->update));
+
+        // only the damaged area, not its bounding box
+        for (uint32_t i = 0; i < ui->update.band_count; i++) {
+            const RegionBand* band = &ui->update.bands[i];
+            for (uint32_t j = 0; j < band->span_count; j++) {
+                const RegionSpan* span = &ui->update.spans[band->span_start + j];
+                const RECT r = { span->left, band->top, span->right, band->bottom };
+                if (!FillRect(hdc, &r, ui->background)) FATAL_WIN32("FillRect", GetLastError());
+            }
+        }
+        if (outside_paint) RegionClear(&ui->update);
 
         // Return TRUE to indicate that the background has been erased
         // This prevents the default handling from also erasing the background
         return TRUE;
     }
     case WM_PAINT: { // WM_PAINT == 15
+        // paint.rcPaint is only the bounding box of the update region, grab
+        // the exact region before BeginPaint validates it
+        HRGN update_region = CreateRectRgn(0, 0, 0, 0);
+        if (!update_region) FATAL_WIN32("CreateRectRgn", GetLastError());
+        if (GetUpdateRgn(hwnd, update_region, FALSE) == ERROR) FATAL_WIN32("GetUpdateRgn", GetLastError());
+        region_from_hrgn(&ui->update, update_region);
+        DeleteObject(update_region);
+
         PAINTSTRUCT paint;
         HDC hdc = BeginPaint(hwnd, &paint);
         if (!hdc) FATAL_WIN32("BeginPaint", GetLastError());
 
+        paint_text(ui, hdc, &ui->update);
+
         if (!EndPaint(hwnd, &paint)) FATAL_WIN32("EndPaint", GetLastError());
+        RegionClear(&ui->update);
+        if (ui == &global_ui_threads[0] && !global_startup.done) log_startup();
+        if (SCENARIOS && !ui->scenarios_posted) {
+            if (!PostMessage(hwnd, WM_APP_SCENARIOS, 0, 0)) FATAL_WIN32("PostMessage", GetLastError());
+            ui->scenarios_posted = true;
+        }
         return 0;
     }
     case WM_SHOWWINDOW: { // WM_SHOWWINDOW == 24
         WPARAM show = wparam;
         LPARAM status = (LPARAM)lparam;
-        LOG("WM_SHOWWINDOW show=%lld, status=%s (%llu)", show, showwindow_status_str(status), status);
+        LOG("WM_SHOWWINDOW show=%lld, status=%s (%llu)", show, ShowWindowStatusStr(status), status);
         ENFORCE((show == 0) || (show == 1));
         return 0;
     }
@@ -461,12 +1134,11 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
         ENFORCE((activate == 0) || (activate == 1));
         if (activate) {
             LOG("WM_ACTIVATEAPP: activate (thread %llu)", thread_id);
-            // This is where you would handle window activation
-            // For example, resuming animations, sounds, or other processing
+            // WM_ACTIVATE says whether this particular window is the active one
         } else {
             LOG("WM_ACTIVATEAPP: deactivate (thread %llu)", thread_id);
-            // This is where you would handle window deactivation
-            // For example, pausing animations, sounds, or other processing
+            ui->active = false;
+            update_task_state(ui);
         }
         return 0;
     case WM_SETCURSOR: { // WM_SETCURSOR == 32
@@ -482,9 +1154,6 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
         return DefWindowProc(hwnd, msg, wparam, lparam);
     }
     case WM_GETMINMAXINFO: { // WM_GETMINMAXINFO == 36
-        if (global_msg_count <= 4) {
-            ENFORCE_EQ("", "%u", 1, global_msg_count);
-        }
         MINMAXINFO* info = (MINMAXINFO*)lparam;
         LOG(
             "maxsize=%dx%d maxpos=%d,%d mintrack=%dx%d maxtrack=%dx%d",
@@ -496,16 +1165,18 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
         return 0;
     }
     case WM_WINDOWPOSCHANGING: { // WM_WINDOWPOSCHANGING == 70
-        global_wnd_pos_changing++;
+        ui->wnd_pos_changing++;
+        ui->window.pos_pending = true;
         WINDOWPOS* winpos = (WINDOWPOS*)lparam;
         LOG(
             "WM_WINDOWPOSCHANGING %d,%d %dx%d hwndInsertAfter=0x%p count=%u",
             winpos->x, winpos->y, winpos->cx, winpos->cy,
-            winpos->hwndInsertAfter, global_wnd_pos_changing
+            winpos->hwndInsertAfter, ui->wnd_pos_changing
         );
+        SessionStatsAdd(&ui->stats, STATS_SWP_FLAGS, winpos->flags);
         {
             char buf[FORMAT_SWP_FLAGS_BUF_LEN];
-            format_swp_flags(buf, winpos->flags);
+            FormatSwpFlags(buf, winpos->flags);
             LOG("  flags=0x%x %s", winpos->flags, buf);
         }
 
@@ -517,20 +1188,48 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
         return 0;
     }
     case WM_WINDOWPOSCHANGED: { // WM_WINDOWPOSCHANGED == 71
-        global_wnd_pos_changed++;
+        ui->wnd_pos_changed++;
 
         WINDOWPOS* winpos = (WINDOWPOS*)lparam;
         LOG(
             "WM_WINDOWPOSCHANGED %d,%d %dx%d hwndInsertAfter=0x%p count=%u",
             winpos->x, winpos->y, winpos->cx, winpos->cy,
-            winpos->hwndInsertAfter, global_wnd_pos_changed
+            winpos->hwndInsertAfter, ui->wnd_pos_changed
         );
         {
             char buf[FORMAT_SWP_FLAGS_BUF_LEN];
-            format_swp_flags(buf, winpos->flags);
+            FormatSwpFlags(buf, winpos->flags);
             LOG("  flags=0x%x %s", winpos->flags, buf);
         }
 
+        // A top-level window's position is in screen coordinates, the same
+        // as GetWindowRect.  The hit test grid is only rebuilt when the size
+        // actually changes, a move just changes the origin we translate
+        // WM_NCHITTEST points by.
+        RECT* rect = &ui->window.window_rect;
+        const LONG width = (winpos->flags & SWP_NOSIZE) ? rect->right - rect->left : winpos->cx;
+        const LONG height = (winpos->flags & SWP_NOSIZE) ? rect->bottom - rect->top : winpos->cy;
+        if (!(winpos->flags & SWP_NOMOVE)) {
+            rect->left = winpos->x;
+            rect->top = winpos->y;
+        }
+        rect->right = rect->left + width;
+        rect->bottom = rect->top + height;
+        ui->window.pos_pending = false;
+        HitTestResize(&ui->hit_test, width, height);
+        // The client area moved and resized with the window.  WM_MOVE and
+        // WM_SIZE report it too, but only from inside DefWindowProc below,
+        // after the messages in between were checked against the snapshot.
+        if (!(winpos->flags & SWP_NOSIZE) || !(winpos->flags & SWP_NOMOVE)) {
+            RECT client;
+            if (!GetClientRect(hwnd, &client)) FATAL_WIN32("GetClientRect", GetLastError());
+            ui->window.client_size.cx = client.right;
+            ui->window.client_size.cy = client.bottom;
+            POINT origin = { 0, 0 };
+            ENFORCE(ClientToScreen(hwnd, &origin));
+            ui->window.client_origin = origin;
+        }
+
         // This is where you would handle the finalized window position change
         // For example, you might:
         // - Update your internal state
@@ -544,6 +1243,20 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
         //     InvalidateRect(hwnd, NULL, TRUE);
         // }
 
+        // sends WM_MOVE and WM_SIZE, the minimized state comes from WM_SIZE
+        return DefWindowProc(hwnd, msg, wparam, lparam);
+    }
+    case WM_STYLECHANGING: // WM_STYLECHANGING == 124
+        return 0;
+    case WM_STYLECHANGED: { // WM_STYLECHANGED == 125
+        const STYLESTRUCT* styles = (const STYLESTRUCT*)lparam;
+        LOG("WM_STYLECHANGED %s 0x%x => 0x%x",
+            (wparam == GWL_EXSTYLE) ? "GWL_EXSTYLE" : "GWL_STYLE", styles->styleOld, styles->styleNew);
+        if (wparam == GWL_EXSTYLE) {
+            ui->window.ex_style = styles->styleNew;
+        } else {
+            ui->window.style = styles->styleNew;
+        }
         return 0;
     }
     case WM_GETICON: { // WM_GETICON == 127
@@ -562,7 +1275,6 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
         return 0;
     }
     case WM_NCCREATE: { // WM_NCCREATE == 129
-        ENFORCE_EQ("", "%u", 2, global_msg_count);
         CREATESTRUCT* create = (CREATESTRUCT*)lparam;
         ENFORCE_EQ("", "%p", CREATE_PARAMS_MAGIC, create->lpCreateParams);
         ENFORCE_EQ("", "%p", GetModuleHandleW(NULL), create->hInstance);
@@ -571,7 +1283,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
         LOG("WM_NCCREATE %d,%d %dx%d", create->x, create->y, create->cx, create->cy);
         {
             char buf[FORMAT_WND_STYLE_BUF_LEN];
-            format_wnd_style(buf, create->style);
+            FormatWndStyle(buf, create->style);
             LOG("  style=0x%x %s", create->style, buf);
         }
         ENFORCE_EQ("0x", "%x", WND_STYLE, create->style);
@@ -579,16 +1291,16 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
         ENFORCE(!wcscmp(WND_CLASS, create->lpszClass));
         {
             char buf[FORMAT_WND_EX_STYLE_BUF_LEN];
-            format_wnd_ex_style(buf, create->dwExStyle);
+            FormatWndExStyle(buf, create->dwExStyle);
             LOG("  exstyle=0x%x %s", create->dwExStyle, buf);
         }
         ENFORCE_EQ("0x", "%x", WND_EX_STYLE, create->dwExStyle);
         return TRUE; // continue creating the window
     }
     case WM_NCCALCSIZE: // WM_NCCALCSIZE == 131
-        if (global_msg_count <= 4) {
-            ENFORCE_EQ("", "%u", 3, global_msg_count);
-        }
+        // While the window is being created the client area changes here
+        // without a WM_SIZE, query it again on the next message
+        if (!ui->window.pos_pending) ui->window.valid = false;
 
         // If wParam is TRUE, lparam points to NCCALCSIZE_PARAMS structure
         if (wparam) {
@@ -621,7 +1333,14 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
         return DefWindowProc(hwnd, msg, wparam, lparam);
     case WM_NCHITTEST: { // WM_NCHITTEST == 132
         POINT p = {(short)LOWORD(lparam), (short)HIWORD(lparam)};
+        int32_t code;
+        if (HitTestLookup(&ui->hit_test, p.x - ui->window.window_rect.left, p.y - ui->window.window_rect.top, &code)) {
+            LOG("WM_NCHITTEST: %d,%d => %s(%d) (registered region)", p.x, p.y, GetHitStr(code), code);
+            SessionStatsAdd(&ui->stats, STATS_HIT_TEST, (uint32_t)code);
+            return code;
+        }
         LRESULT result = DefWindowProc(hwnd, msg, wparam, lparam);
+        SessionStatsAdd(&ui->stats, STATS_HIT_TEST, (uint32_t)result);
         LOG("WM_NCHITTEST: %d,%d => %lld", p.x, p.y, result);
         return result;
     }
@@ -634,14 +1353,15 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
         if (wparam == 1) {
             LOG("WM_NCPAINT: entire area");
         } else if (wparam != 0) {
-            RECT region_rect;
-            if (!GetRgnBox(update_region, &region_rect)) FATAL_WIN32("GetRgnBox", GetLastError());
+            region_from_hrgn(&ui->nc_update, update_region);
+            int32_t left, top, right, bottom;
+            if (!RegionGetBox(&ui->nc_update, &left, &top, &right, &bottom)) {
+                left = top = right = bottom = 0;
+            }
             LOG(
-                "WM_NCPAINT: region: (%d,%d)-(%d,%d) %dx%d",
-                region_rect.left, region_rect.top,
-                region_rect.right, region_rect.bottom,
-                region_rect.right - region_rect.left,
-                region_rect.bottom - region_rect.top
+                "WM_NCPAINT: region: %u rects area=%lld box (%d,%d)-(%d,%d) %dx%d",
+                RegionRectCount(&ui->nc_update), RegionArea(&ui->nc_update),
+                left, top, right, bottom, right - left, bottom - top
             );
         }
 
@@ -649,7 +1369,8 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
         // 1. Get the device context for the non-client area
         // HDC hdc = GetDCEx(hwnd, update_region, DCX_WINDOW | DCX_INTERSECTRGN);
 
-        // 2. Perform your custom drawing
+        // 2. Perform your custom drawing, only the rects in ui->nc_update
+        //    need to be repainted
         // ...
 
         // 3. Release the device context
@@ -679,7 +1400,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
         WPARAM hit_test_area = wparam;
 
         LOG("WM_NCMOUSEMOVE: point=%d,%d area=%s(%llu)",
-            p.x, p.y, get_hit_str(hit_test_area), hit_test_area);
+            p.x, p.y, GetHitStr(hit_test_area), hit_test_area);
 
         // You can perform actions based on mouse movement in non-client areas.
         // For example, you might want to:
@@ -704,25 +1425,104 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
         POINT p = { (short)LOWORD(lparam), (short)HIWORD(lparam) };
         WPARAM hit_test_area = wparam;
         LOG("WM_NCLBUTTONDOWN: %d,%d area=%s(%llu)",
-            p.x, p.y, get_hit_str(hit_test_area), hit_test_area);
+            p.x, p.y, GetHitStr(hit_test_area), hit_test_area);
+        return DefWindowProc(hwnd, msg, wparam, lparam);
+    }
+    case WM_KEYDOWN: { // WM_KEYDOWN == 256
+        const bool ctrl = GetKeyState(VK_CONTROL) < 0;
+        // a held key is reported once with a repeat count if we fall behind
+        for (WORD i = 0; i < LOWORD(lparam); i++) {
+            switch (wparam) {
+            case VK_LEFT: TextEditorMove(&ui->editor, TEXT_MOVE_LEFT); break;
+            case VK_RIGHT: TextEditorMove(&ui->editor, TEXT_MOVE_RIGHT); break;
+            case VK_UP: TextEditorMove(&ui->editor, TEXT_MOVE_UP); break;
+            case VK_DOWN: TextEditorMove(&ui->editor, TEXT_MOVE_DOWN); break;
+            case VK_HOME: TextEditorMove(&ui->editor, ctrl ? TEXT_MOVE_DOCUMENT_START : TEXT_MOVE_LINE_START); break;
+            case VK_END: TextEditorMove(&ui->editor, ctrl ? TEXT_MOVE_DOCUMENT_END : TEXT_MOVE_LINE_END); break;
+            case VK_DELETE: TextEditorDelete(&ui->editor); break;
+            default: return 0; // typed characters come as WM_CHAR
+            }
+        }
+        text_changed(ui, hwnd);
+        return 0;
+    }
+    case WM_KEYUP: // WM_KEYUP == 257
+        return 0;
+    case WM_CHAR: { // WM_CHAR == 258
+        // a character outside the BMP comes as two messages, one per surrogate
+        TextChar c = (TextChar)wparam;
+        if (c == '\r') c = '\n';
+        else if (c != '\b' && (c < 0x20 || c == 0x7f)) return 0; // tab and the other control characters
+        for (WORD i = 0; i < LOWORD(lparam); i++) {
+            if (c == '\b') TextEditorBackspace(&ui->editor);
+            else TextEditorInsert(&ui->editor, &c, 1);
+        }
+        text_changed(ui, hwnd);
+        return 0;
+    }
+    case WM_DEADCHAR: // WM_DEADCHAR == 259
+        // the accent is combined into the next WM_CHAR
+        return 0;
+    case WM_SYSKEYDOWN: // WM_SYSKEYDOWN == 260
+    case WM_SYSKEYUP: // WM_SYSKEYUP == 261
+    case WM_SYSCHAR: // WM_SYSCHAR == 262
+        // Alt+F4, Alt+Space and friends
         return DefWindowProc(hwnd, msg, wparam, lparam);
+    case WM_IME_STARTCOMPOSITION: { // WM_IME_STARTCOMPOSITION == 269
+        LOG("WM_IME_STARTCOMPOSITION at line %zu column %zu", ui->editor.caret_line, ui->editor.caret_column);
+        // The composition is drawn inline, not in the IME's window.  Its
+        // candidate list still lines up with where the composition starts.
+        HIMC imc = ImmGetContext(hwnd);
+        if (imc) {
+            COMPOSITIONFORM form;
+            form.dwStyle = CFS_POINT;
+            form.ptCurrentPos.x = (LONG)ui->editor.caret_column * ui->char_width;
+            form.ptCurrentPos.y = (LONG)ui->editor.caret_line * ui->line_height;
+            if (!ImmSetCompositionWindow(imc, &form)) FATAL_WIN32("ImmSetCompositionWindow", GetLastError());
+            ImmReleaseContext(hwnd, imc);
+        }
+        return 0;
+    }
+    case WM_IME_ENDCOMPOSITION: // WM_IME_ENDCOMPOSITION == 270
+        LOG("WM_IME_ENDCOMPOSITION");
+        TextEditorSetComposition(&ui->editor, NULL, 0, 0);
+        text_changed(ui, hwnd);
+        return 0;
+    case WM_IME_COMPOSITION: { // WM_IME_COMPOSITION == 271
+        HIMC imc = ImmGetContext(hwnd);
+        if (!imc) return DefWindowProc(hwnd, msg, wparam, lparam);
+        // Both can be set, a committed result followed by the start of the
+        // next composition.  Not calling DefWindowProc means no WM_IME_CHAR.
+        if (lparam & GCS_RESULTSTR) {
+            const size_t length = get_ime_string(ui, imc, GCS_RESULTSTR);
+            TextEditorSetComposition(&ui->editor, NULL, 0, 0);
+            TextEditorInsert(&ui->editor, ui->ime_text, length);
+        }
+        if (lparam & GCS_COMPSTR) {
+            const size_t length = get_ime_string(ui, imc, GCS_COMPSTR);
+            LONG cursor = (LONG)length;
+            if (lparam & GCS_CURSORPOS) cursor = ImmGetCompositionStringW(imc, GCS_CURSORPOS, NULL, 0);
+            TextEditorSetComposition(&ui->editor, ui->ime_text, length, (cursor < 0) ? length : (size_t)cursor);
+        }
+        ImmReleaseContext(hwnd, imc);
+        text_changed(ui, hwnd);
+        return 0;
+    }
+    case WM_TIMER: { // WM_TIMER == 275
+        if (wparam != TIMER_ID_WHEEL) UNREACHABLE();
+        // SetTimer timers repeat, kill it and re-arm it for the new next
+        // wakeup once the due callbacks have run
+        if (!KillTimer(hwnd, TIMER_ID_WHEEL)) FATAL_WIN32("KillTimer", GetLastError());
+        ui->timer_armed_tick = TIMER_NOT_ARMED;
+        const uint32_t fired = TimerWheelAdvance(&ui->timers, now_ms());
+        LOG("WM_TIMER: fired %u callbacks, %u pending", fired, ui->timers.count);
+        arm_os_timer(ui);
+        return 0;
     }
     case WM_MOUSEMOVE: { // WM_MOUSEMOVE == 512
         POINT p = {(short)LOWORD(lparam), (short)HIWORD(lparam)};
-        WPARAM key_flags = wparam;
-
-        bool left_button = (key_flags & MK_LBUTTON) != 0;
-        bool right_button = (key_flags & MK_RBUTTON) != 0;
-        bool shift_key = (key_flags & MK_SHIFT) != 0;
-        bool control_key = (key_flags & MK_CONTROL) != 0;
-        bool middle_button = (key_flags & MK_MBUTTON) != 0;
-        bool x_button1 = (key_flags & MK_XBUTTON1) != 0;
-        bool x_button2 = (key_flags & MK_XBUTTON2) != 0;
-
-        LOG("WM_MOUSEMOVE: %d,%d keys=0x%llx (L=%d,R=%d,M=%d,X1=%d,X2=%d,shift=%d,ctrl=%d)",
-            p.x, p.y, (LONG_PTR)key_flags,
-            left_button, right_button, middle_button,
-            x_button1, x_button2, shift_key, control_key);
+        // batched, on_pointer_batch handles the points once per frame
+        add_mouse_move(ui, hwnd, p, wparam, GetMessageTime());
 
         // This is useful for UI elements that need to know when mouse leaves
         /*
@@ -748,16 +1548,17 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
         // ISC_SHOWUICANDIDATEWINDOW (0x00000001)
         // ISC_SHOWUICANDIDATEWINDOW << 1 through ISC_SHOWUICANDIDATEWINDOW << 3
 
-        // You can modify the flags to hide certain UI elements
-        // For example, to hide the composition window:
-        // flags &= ~ISC_SHOWUICOMPOSITIONWINDOW;
+        // The composition is drawn inline by WM_PAINT, hide the IME's own
+        // composition window but keep its candidate list
+        flags &= ~ISC_SHOWUICOMPOSITIONWINDOW;
 
-        return DefWindowProc(hwnd, msg, wparam, lparam);
+        return DefWindowProc(hwnd, msg, wparam, flags);
     }
     case WM_IME_NOTIFY: { // WM_IME_NOTIFY == 0x0282 (642)
         WPARAM code = wparam;
-        const char *code_str = ime_notify_code_str(code);
+        const char *code_str = ImeNotifyCodeStr(code);
         LOG("WM_IME_NOTIFY: code=%s (0x%x) param=0x%llx", code_str, (unsigned)code, lparam);
+        SessionStatsAdd(&ui->stats, STATS_IME_NOTIFY, (uint32_t)code);
         return DefWindowProc(hwnd, msg, wparam, lparam);
     }
     case WM_IME_REQUEST: // WM_IME_REQUEST == 648
@@ -767,6 +1568,22 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
         return 0;
     case WM_DWMNCRENDERINGCHANGED: // WM_DWMNCRENDERINGCHANGED == 799
         return DefWindowProc(hwnd, msg, wparam, lparam);
+    case WM_APP_WORK: { // WM_APP_WORK == WM_APP
+        unsigned count = 0;
+        MpscNode* node = MpscQueueTakeAll(&ui->work_queue);
+        while (node) {
+            WorkItem* item = (WorkItem*)node;
+            // grab next first, the item may free itself
+            node = node->next;
+            item->run(item);
+            count++;
+        }
+        LOG("WM_APP_WORK: ran %u items", count);
+        return 0;
+    }
+    case WM_APP_SCENARIOS: // WM_APP_SCENARIOS == WM_APP + 1
+        run_scenarios(ui, hwnd);
+        return 0;
     default:
         if (msg < WM_USER) {
             LOG("TODO: implement window message %s (%u)", GetMsgName(msg), msg);
@@ -780,7 +1597,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
             return DefWindowProc(hwnd, msg, wparam, lparam);
         } else if (msg < 0x10000) {
             LRESULT result = DefWindowProc(hwnd, msg, wparam, lparam);
-            LOG("String Message %u (0x%x) => %lld (0x%llx)", msg, msg, result, (LONG_PTR)result);
+            LOG("String Message %s (0x%x) => %lld (0x%llx)", msg_name(msg), msg, result, (LONG_PTR)result);
             return result;
         } else {
             LOG("Reserved System Message %u?", msg);
@@ -790,27 +1607,273 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
     UNREACHABLE();
 }
 
+// The field of msg tracediff aligns on besides the id, one that's the same
+// in every run of the same build.  Pointers, handles and coordinates never
+// are, tracediff decodes these in format_detail.
+static uint32_t trace_detail(UINT msg, WPARAM wparam, LPARAM lparam)
+{
+    switch (msg) {
+    case WM_CREATE: // WM_CREATE == 1
+    case WM_NCCREATE: // WM_NCCREATE == 129
+        return ((const CREATESTRUCT*)lparam)->style;
+    case WM_WINDOWPOSCHANGING: // WM_WINDOWPOSCHANGING == 70
+    case WM_WINDOWPOSCHANGED: // WM_WINDOWPOSCHANGED == 71
+        return ((const WINDOWPOS*)lparam)->flags;
+    case WM_SIZE: // WM_SIZE == 5
+    case WM_NCCALCSIZE: // WM_NCCALCSIZE == 131
+    case WM_NCACTIVATE: // WM_NCACTIVATE == 134
+    case WM_IME_NOTIFY: // WM_IME_NOTIFY == 0x0282 (642)
+    case WM_KEYDOWN: // WM_KEYDOWN == 256
+    case WM_KEYUP: // WM_KEYUP == 257
+    case WM_CHAR: // WM_CHAR == 258
+        return (uint32_t)wparam;
+    case WM_ACTIVATE: // WM_ACTIVATE == 6
+        return LOWORD(wparam);
+    case WM_SHOWWINDOW: // WM_SHOWWINDOW == 24
+        return (uint32_t)lparam;
+    case WM_SETCURSOR: // WM_SETCURSOR == 32
+        return LOWORD(lparam); // the hit test code
+    case WM_SYSCOMMAND: // WM_SYSCOMMAND == 274
+        return (uint32_t)wparam & 0xfff0;
+    default:
+        return 0;
+    }
+}
+
+LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam)
+{
+    if (!PROFILE_HANDLERS && !TRACE_RING && !TRACE_FILE && !SCENARIOS) return handle_msg(hwnd, msg, wparam, lparam);
+    UiThread* ui = thread_ui;
+    // in the order the messages arrive, a message sent from inside a
+    // handler comes after the one that sent it
+    if (TRACE_FILE && ui->trace_file.file) {
+        TraceFileWrite(&ui->trace_file, msg, trace_detail(msg, wparam, lparam), (uint64_t)wparam, (uint64_t)lparam);
+    }
+    HandlerSample sample;
+    if (PROFILE_HANDLERS) HandlerProfileBegin(ui->handler_profile, &sample);
+    const bool timed = (TRACE_RING && ui->trace.header) || (SCENARIOS && ui->scenario);
+    const uint64_t start = timed ? now_ns() : 0;
+    const LRESULT result = handle_msg(hwnd, msg, wparam, lparam);
+    // the duration includes messages sent from inside the handler, those
+    // are published first
+    const uint64_t duration = timed ? now_ns() - start : 0;
+    if (TRACE_RING && ui->trace.header) {
+        TraceRingPublish(&ui->trace, msg, (uint32_t)(ui - global_ui_threads), start, duration);
+    }
+    if (SCENARIOS && ui->scenario) WorkloadStatsAdd(ui->scenario, duration);
+    if (PROFILE_HANDLERS) HandlerProfileEnd(ui->handler_profile, &sample, msg);
+    return result;
+}
+
+static int message_loop(void)
+{
+    while (true) {
+        MSG msg;
+        BOOL result = GetMessage(&msg, NULL, 0, 0);
+        if (result < 0) FATAL_WIN32("GetMessage", GetLastError());
+        if (result == 0) {
+            LOG("WM_QUIT %llu", msg.wParam);
+            return msg.wParam;
+        }
+        // Without frames a batch is every move up to the next other message
+        // or until the queue runs dry, so the moves are handled before a
+        // click that came after them.  The high word is what's still queued.
+        if (msg.message != WM_MOUSEMOVE) flush_pointer(thread_ui);
+        DispatchMessage(&msg);
+        if (msg.message == WM_MOUSEMOVE && HIWORD(GetQueueStatus(QS_ALLINPUT)) == 0) flush_pointer(thread_ui);
+    }
+}
+
+// Build with /DFRAME_LOOP to drive the window with frame_loop instead of
+// message_loop.
+#ifndef FRAME_INTERVAL_NS
+#define FRAME_INTERVAL_NS ((uint64_t)16666667) // 60 Hz
+#endif
+
+static void on_frame(uint64_t budget_ns)
+{
+    flush_pointer(thread_ui);
+    // This is where you would advance animations or do background work,
+    // anything that takes longer than budget_ns delays the next frame and
+    // holds up input so it should be split across frames.
+}
+
+static void log_frame_stats(const FramePacer* pacer)
+{
+    LOG("frames=%llu missed_deadlines=%llu overruns=%llu dispatch=%.1fms idle=%.1fms wait=%.1fms",
+        pacer->frame_count, pacer->missed_deadlines, pacer->overruns,
+        pacer->phase_ns[FRAME_PHASE_DISPATCH] / 1e6,
+        pacer->phase_ns[FRAME_PHASE_IDLE] / 1e6,
+        pacer->phase_ns[FRAME_PHASE_WAIT] / 1e6);
+}
+
+// Drains all pending messages, runs on_frame once per frame interval
+// then sleeps until either a message arrives or the next frame is due.
+static int frame_loop(void)
+{
+    FramePacer pacer;
+    FramePacerInit(&pacer, FRAME_INTERVAL_NS, now_ns());
+    while (true) {
+        FramePacerEnterPhase(&pacer, FRAME_PHASE_DISPATCH, now_ns());
+        MSG msg;
+        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+            if (msg.message == WM_QUIT) {
+                FramePacerEnterPhase(&pacer, FRAME_PHASE_DISPATCH, now_ns());
+                LOG("WM_QUIT %llu", msg.wParam);
+                log_frame_stats(&pacer);
+                return msg.wParam;
+            }
+            DispatchMessage(&msg);
+            // A steady stream of input or timers would keep the queue from
+            // ever draining, stop once the frame is due.  At least one
+            // message goes through per iteration even when frames overrun.
+            if (!FramePacerTimeout(&pacer, now_ns())) break;
+        }
+
+        uint64_t budget_ns;
+        if (FramePacerFrameDue(&pacer, now_ns(), &budget_ns)) {
+            FramePacerEnterPhase(&pacer, FRAME_PHASE_IDLE, now_ns());
+            on_frame(budget_ns);
+            FramePacerFrameDone(&pacer, now_ns());
+        }
+
+        FramePacerEnterPhase(&pacer, FRAME_PHASE_WAIT, now_ns());
+        // Rounded up so we don't spin through the last partial millisecond,
+        // the frame can start up to 1ms late instead.
+        const uint64_t timeout_ns = FramePacerTimeout(&pacer, now_ns());
+        const DWORD timeout_ms = (DWORD)((timeout_ns + 999999) / 1000000);
+        if (MsgWaitForMultipleObjectsEx(0, NULL, timeout_ms, QS_ALLINPUT, MWMO_INPUTAVAILABLE) == WAIT_FAILED) {
+            FATAL_WIN32("MsgWaitForMultipleObjectsEx", GetLastError());
+        }
+    }
+}
+
+static int ui_thread_run(UiThread* ui)
+{
+    thread_ui = ui;
+    HWND hwnd = CreateWindowExW(
+        WND_EX_STYLE,
+        WND_CLASS,
+        WND_NAME,
+        WND_STYLE,
+        CW_USEDEFAULT,
+        CW_USEDEFAULT,
+        CW_USEDEFAULT,
+        CW_USEDEFAULT,
+        NULL,
+        NULL,
+        GetModuleHandleW(NULL),
+        CREATE_PARAMS_MAGIC
+    );
+    if (!hwnd) FATAL_WIN32("CreateWindow", GetLastError());
+    const bool profile = (ui == &global_ui_threads[0]);
+    if (profile) StartupProfileMark(&global_startup, "CreateWindowExW", now_ns());
+    // The snapshot has to follow a resize and a move, the hidden window
+    // is moved and put back and compared with the system after each
+    if (CHECK_HWND && CHECK_HWND_RESIZE) {
+        RECT rect;
+        if (!GetWindowRect(hwnd, &rect)) FATAL_WIN32("GetWindowRect", GetLastError());
+        const int width = rect.right - rect.left, height = rect.bottom - rect.top;
+        const UINT flags = SWP_NOZORDER | SWP_NOACTIVATE | SWP_NOREDRAW;
+        if (!SetWindowPos(hwnd, NULL, rect.left + 7, rect.top + 5, width + 37, height + 23, flags)) {
+            FATAL_WIN32("SetWindowPos", GetLastError());
+        }
+        ENFORCE(ui->window.valid);
+        check_hwnd_full(ui, hwnd);
+        if (!SetWindowPos(hwnd, NULL, rect.left, rect.top, width, height, flags)) FATAL_WIN32("SetWindowPos", GetLastError());
+        check_hwnd_full(ui, hwnd);
+        if (profile) StartupProfileMark(&global_startup, "resize self check", now_ns());
+    }
+    ShowWindow(hwnd, SW_SHOWNORMAL);
+    if (profile) StartupProfileMark(&global_startup, "ShowWindow", now_ns());
+
+#ifdef FRAME_LOOP
+    const int result = frame_loop();
+#else
+    const int result = message_loop();
+#endif
+
+    TaskSchedulerStats stats;
+    TaskSchedulerGetStats(ui->tasks, now_ns(), &stats);
+    for (unsigned state = 0; state < TASK_STATE_COUNT; state++) {
+        LOG("tasks %s: %.1f ms, %llu run",
+            TaskStateName(state), stats.state_ns[state] / 1e6, stats.tasks_run[state]);
+    }
+    LOG("tasks: %llu held while minimized, %llu steals", stats.tasks_held, stats.steals);
+    if (CHECK_HWND) {
+        const unsigned samples = ui->check_hwnd_samples;
+        LOG("CheckHwnd: %.1f ns/msg from the snapshot over %u sampled messages, %u full re-checks at %.1f us each",
+            samples ? (double)ui->check_hwnd_ns / samples : 0.0, samples,
+            ui->full_check_hwnd_count,
+            ui->full_check_hwnd_count ? ui->full_check_hwnd_ns / 1e3 / ui->full_check_hwnd_count : 0.0);
+    }
+    TaskSchedulerDestroy(ui->tasks);
+    LOG("registered message names: %llu hits, %llu misses (%llu unresolved), %u cached",
+        ui->msg_names.hits, ui->msg_names.misses, ui->msg_names.unresolved, ui->msg_names.count);
+    if (ui->handler_profile) {
+        const size_t len = HandlerProfileReport(ui->handler_profile, msg_name, NULL, 0);
+        char* report = (char*)malloc(len + 1);
+        ENFORCE(report);
+        HandlerProfileReport(ui->handler_profile, msg_name, report, len + 1);
+        LOG("handler cost:\n%s", report);
+        free(report);
+        HandlerProfileDestroy(ui->handler_profile);
+    }
+    if (ui->trace.header) TraceRingClose(&ui->trace);
+    if (ui->trace_file.file) {
+        LOG("recorded %llu messages", ui->trace_file.records);
+        TraceFileClose(&ui->trace_file);
+    }
+    MsgNameCacheFree(&ui->msg_names);
+    MsgSeqVerifierFree(&ui->msg_seq);
+    PointerBatchFree(&ui->pointer);
+    TextEditorFree(&ui->editor);
+    DeleteObject(ui->background);
+    free(ui->ime_text);
+    return result;
+}
+
+static DWORD WINAPI ui_thread_proc(void* param)
+{
+    return ui_thread_run((UiThread*)param);
+}
+
 int CALLBACK wWinMain(
     HINSTANCE hinstance,
     HINSTANCE hprev_instance,
     LPWSTR cmdline,
     int cmd_show
 ) {
-    ENFORCE_EQ("", "%lu", 0xffff0000, WND_STYLE_ALL);
-    {
-        char buf[FORMAT_WND_STYLE_BUF_LEN + 100];
-        ENFORCE_EQ("", "%zu", FORMAT_WND_STYLE_BUF_LEN, 1 + format_wnd_style(buf, 0xffffffff));
-    }
+    // the first phase is the loader and the C runtime
+    StartupProfileInit(&global_startup, process_start_ns());
+    StartupProfileMark(&global_startup, "wWinMain", now_ns());
+
+    // The masks fold to constants, with SELF_CHECKS=0 the whole block is
+    // dead code
+    if (SELF_CHECKS) {
+        ENFORCE_EQ("", "%lu", 0xffff0000, WND_STYLE_ALL);
+        {
+            char buf[FORMAT_WND_STYLE_BUF_LEN + 100];
+            ENFORCE_EQ("", "%zu", FORMAT_WND_STYLE_BUF_LEN, 1 + FormatWndStyle(buf, 0xffffffff));
+            // MsgFormat has its own copy of the values, every flag in the
+            // headers has to have a name there
+            FormatWndStyle(buf, WND_STYLE_ALL);
+            ENFORCE(!strstr(buf, "0x"));
+        }
 
-    ENFORCE_EQ("", "%lu", 0xa7f77fd, WND_EX_STYLE_ALL);
-    {
-        char buf[FORMAT_WND_EX_STYLE_BUF_LEN + 100];
-        ENFORCE_EQ("", "%zu", FORMAT_WND_EX_STYLE_BUF_LEN, 1 + format_wnd_ex_style(buf, 0xffffffff));
-    }
+        ENFORCE_EQ("", "%lu", 0xa7f77fd, WND_EX_STYLE_ALL);
+        {
+            char buf[FORMAT_WND_EX_STYLE_BUF_LEN + 100];
+            ENFORCE_EQ("", "%zu", FORMAT_WND_EX_STYLE_BUF_LEN, 1 + FormatWndExStyle(buf, 0xffffffff));
+            FormatWndExStyle(buf, WND_EX_STYLE_ALL);
+            ENFORCE(!strstr(buf, "0x"));
+        }
 
-    {
-        char buf[FORMAT_SWP_FLAGS_BUF_LEN + 100];
-        ENFORCE_EQ("", "%zu", FORMAT_SWP_FLAGS_BUF_LEN, 1 + format_swp_flags(buf, 0xffffffff));
+        {
+            char buf[FORMAT_SWP_FLAGS_BUF_LEN + 100];
+            ENFORCE_EQ("", "%zu", FORMAT_SWP_FLAGS_BUF_LEN, 1 + FormatSwpFlags(buf, 0xffffffff));
+        }
+        StartupProfileMark(&global_startup, "self checks", now_ns());
     }
 
 
@@ -833,32 +1896,36 @@ int CALLBACK wWinMain(
         c.hIconSm = NULL;
         if (!RegisterClassExW(&c)) FATAL_WIN32("RegisterClass", GetLastError());
     }
+    StartupProfileMark(&global_startup, "RegisterClassExW", now_ns());
 
-    HWND hwnd = CreateWindowExW(
-        WND_EX_STYLE,
-        WND_CLASS,
-        WND_NAME,
-        WND_STYLE,
-        CW_USEDEFAULT,
-        CW_USEDEFAULT,
-        CW_USEDEFAULT,
-        CW_USEDEFAULT,
-        NULL,
-        NULL,
-        GetModuleHandleW(NULL),
-        CREATE_PARAMS_MAGIC
-    );
-    if (!hwnd) FATAL_WIN32("CreateWindow", GetLastError());
-    ShowWindow(hwnd, SW_SHOWNORMAL);
-
-    while (true) {
-        MSG msg;
-        BOOL result = GetMessage(&msg, NULL, 0, 0);
-        if (result < 0) FATAL_WIN32("GetMessage", GetLastError());
-        if (result == 0) {
-            LOG("WM_QUIT %llu", msg.wParam);
-            return msg.wParam;
+    {
+        char error[256];
+        if (!MsgSeqCompile(&global_msg_seq_spec, MSG_RULES, ARRAYSIZE(MSG_RULES), lookup_msg, error, sizeof(error))) {
+            LOG("bad message sequence rule: %s", error);
+            abort();
         }
-        DispatchMessage(&msg);
     }
+    StartupProfileMark(&global_startup, "MsgSeqCompile", now_ns());
+#ifdef _DEBUG
+    if (SCENARIOS) _CrtSetAllocHook(count_allocation);
+#endif
+    for (unsigned i = 0; i < UI_THREAD_COUNT; i++) {
+        ui_thread_init(&global_ui_threads[i]);
+    }
+    StartupProfileMark(&global_startup, "ui_thread_init", now_ns());
+    if (UI_THREAD_COUNT == 1) {
+        return ui_thread_run(&global_ui_threads[0]);
+    }
+
+    // WaitForMultipleObjects can wait on at most 64 threads
+    ENFORCE(UI_THREAD_COUNT <= 64);
+    HANDLE threads[UI_THREAD_COUNT];
+    for (unsigned i = 0; i < UI_THREAD_COUNT; i++) {
+        threads[i] = CreateThread(NULL, 0, ui_thread_proc, &global_ui_threads[i], 0, NULL);
+        if (!threads[i]) FATAL_WIN32("CreateThread", GetLastError());
+    }
+    if (WaitForMultipleObjects(UI_THREAD_COUNT, threads, TRUE, INFINITE) == WAIT_FAILED) {
+        FATAL_WIN32("WaitForMultipleObjects", GetLastError());
+    }
+    return 0;
 }
@@ -0,0 +1,2133 @@
+// Benchmarks for the platform-neutral parts of the project, these build
+// and run on Linux (see bench.sh).
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "HitTest.h"
+#include "FramePacer.h"
+#include "GetMsgName.h"
+#include "HandlerProfile.h"
+#include "MpscQueue.h"
+#include "MsgFormat.h"
+#include "MsgNameCache.h"
+#include "MsgSequence.h"
+#include "PointerBatch.h"
+#include "Region.h"
+#include "SessionStats.h"
+#include "StartupProfile.h"
+#include "TaskScheduler.h"
+#include "TextEditor.h"
+#include "TimerWheel.h"
+#include "TraceDiff.h"
+#include "TraceRing.h"
+#include "Workload.h"
+
+#define ENFORCE(expr) do { \
+    if (!(expr)) { \
+        fprintf(stderr, "ENFORCE failed: %s, file %s, line %d\n", #expr, __FILE__, __LINE__); \
+        abort(); \
+    } \
+} while (0)
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t rng_state = 0x2545f4914f6cdd1d;
+static uint32_t rng_next(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)(rng_state >> 32);
+}
+static int32_t rng_range(int32_t min, int32_t max)
+{
+    return min + (int32_t)(rng_next() % (uint32_t)(max - min));
+}
+
+// keeps the optimizer from discarding benchmarked work
+static volatile int64_t sink;
+
+// --------------------------------------------------------------------------------
+// HitTest
+// --------------------------------------------------------------------------------
+#define HIT_WIDTH 1920
+#define HIT_HEIGHT 1080
+#define HIT_POINTS 4096
+#define HIT_ITERATIONS 1000000
+
+// What WM_NCHITTEST would have to do without the grid
+static bool linear_lookup(const HitTestGrid* grid, int32_t x, int32_t y, int32_t* code)
+{
+    for (uint32_t i = grid->region_count; i > 0; i--) {
+        const HitRect* rect = &grid->resolved[i - 1];
+        if (x >= rect->left && x < rect->right && y >= rect->top && y < rect->bottom) {
+            *code = grid->regions[i - 1].code;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void bench_hit_test(uint32_t region_count)
+{
+    HitTestGrid grid;
+    HitTestInit(&grid);
+    for (uint32_t i = 0; i < region_count; i++) {
+        HitRegion region;
+        region.left = rng_range(0, HIT_WIDTH);
+        region.top = rng_range(0, HIT_HEIGHT);
+        region.right = region.left + rng_range(4, 120);
+        region.bottom = region.top + rng_range(4, 40);
+        region.anchor = 0;
+        region.code = (int32_t)(i % 22);
+        HitTestAddRegion(&grid, &region);
+    }
+
+    int32_t xs[HIT_POINTS], ys[HIT_POINTS];
+    for (int i = 0; i < HIT_POINTS; i++) {
+        xs[i] = rng_range(0, HIT_WIDTH);
+        ys[i] = rng_range(0, HIT_HEIGHT);
+    }
+
+    uint64_t start = now_ns();
+    HitTestResize(&grid, HIT_WIDTH, HIT_HEIGHT);
+    int32_t code;
+    HitTestLookup(&grid, 0, 0, &code);
+    const uint64_t rebuild_ns = now_ns() - start;
+
+    int64_t total = 0;
+    start = now_ns();
+    for (int i = 0; i < HIT_ITERATIONS; i++) {
+        const int p = i & (HIT_POINTS - 1);
+        if (HitTestLookup(&grid, xs[p], ys[p], &code)) total += code;
+    }
+    const uint64_t grid_ns = now_ns() - start;
+
+    int64_t linear_total = 0;
+    start = now_ns();
+    for (int i = 0; i < HIT_ITERATIONS; i++) {
+        const int p = i & (HIT_POINTS - 1);
+        if (linear_lookup(&grid, xs[p], ys[p], &code)) linear_total += code;
+    }
+    const uint64_t linear_ns = now_ns() - start;
+    ENFORCE(total == linear_total);
+    sink = total;
+
+    printf("hit_test regions=%-4u rebuild=%8.1fus grid=%6.2fns/op linear=%7.2fns/op\n",
+        region_count, rebuild_ns / 1e3,
+        (double)grid_ns / HIT_ITERATIONS, (double)linear_ns / HIT_ITERATIONS);
+    HitTestFree(&grid);
+}
+
+// --------------------------------------------------------------------------------
+// Region
+// --------------------------------------------------------------------------------
+#define REGION_ITERATIONS 200
+
+// scattered small rects, like the damage from many small widgets updating
+static void fragmented_region(Region* region, uint32_t rect_count)
+{
+    RegionClear(region);
+    for (uint32_t i = 0; i < rect_count; i++) {
+        const int32_t left = rng_range(0, HIT_WIDTH);
+        const int32_t top = rng_range(0, HIT_HEIGHT);
+        RegionUnionRect(region, left, top, left + rng_range(4, 64), top + rng_range(4, 32));
+    }
+}
+
+#define REGION_CHECK_SIZE 48
+#define REGION_CHECK_SETS 500
+
+typedef uint8_t RegionBitmap[REGION_CHECK_SIZE][REGION_CHECK_SIZE];
+
+static void random_rects(Region* region, RegionBitmap bitmap)
+{
+    RegionClear(region);
+    memset(bitmap, 0, sizeof(RegionBitmap));
+    const uint32_t count = rng_range(0, 12);
+    for (uint32_t i = 0; i < count; i++) {
+        const int32_t left = rng_range(0, REGION_CHECK_SIZE), top = rng_range(0, REGION_CHECK_SIZE);
+        const int32_t right = rng_range(left, REGION_CHECK_SIZE + 1), bottom = rng_range(top, REGION_CHECK_SIZE + 1);
+        RegionUnionRect(region, left, top, right, bottom);
+        for (int32_t y = top; y < bottom; y++) memset(&bitmap[y][left], 1, (size_t)(right - left));
+    }
+}
+
+// The canonical region of a bitmap, one band per row for RegionAppendRect
+// to merge
+static void region_from_bitmap(Region* region, RegionBitmap bitmap)
+{
+    RegionClear(region);
+    for (int32_t y = 0; y < REGION_CHECK_SIZE; y++) {
+        for (int32_t x = 0; x < REGION_CHECK_SIZE;) {
+            if (!bitmap[y][x]) {
+                x++;
+                continue;
+            }
+            const int32_t left = x;
+            while (x < REGION_CHECK_SIZE && bitmap[y][x]) x++;
+            RegionAppendRect(region, left, y, x, y + 1);
+        }
+    }
+    RegionAppendEnd(region);
+}
+
+// Every op against a brute force bitmap of the same rects.  Equal regions
+// have one representation, so comparing with the region built straight
+// from the bitmap checks the spans and bands, not just the pixels.
+static void check_region_ops(void)
+{
+    Region a, b, out, expected;
+    RegionInit(&a);
+    RegionInit(&b);
+    RegionInit(&out);
+    RegionInit(&expected);
+    RegionBitmap bitmap_a, bitmap_b, bitmap_out;
+    for (uint32_t set = 0; set < REGION_CHECK_SETS; set++) {
+        random_rects(&a, bitmap_a);
+        random_rects(&b, bitmap_b);
+        region_from_bitmap(&expected, bitmap_a);
+        ENFORCE(RegionEqual(&a, &expected));
+        for (int op = 0; op < 4; op++) {
+            for (int32_t y = 0; y < REGION_CHECK_SIZE; y++) {
+                for (int32_t x = 0; x < REGION_CHECK_SIZE; x++) {
+                    const bool in_a = bitmap_a[y][x], in_b = bitmap_b[y][x];
+                    bitmap_out[y][x] = (op == REGION_OP_UNION) ? in_a || in_b :
+                        (op == REGION_OP_INTERSECT) ? in_a && in_b :
+                        (op == REGION_OP_SUBTRACT) ? in_a && !in_b : in_a != in_b;
+                }
+            }
+            RegionCombine(&out, &a, &b, (RegionOp)op);
+            region_from_bitmap(&expected, bitmap_out);
+            ENFORCE(RegionEqual(&out, &expected));
+            for (int32_t y = -1; y <= REGION_CHECK_SIZE; y++) {
+                for (int32_t x = -1; x <= REGION_CHECK_SIZE; x++) {
+                    const bool inside = x >= 0 && y >= 0 && x < REGION_CHECK_SIZE && y < REGION_CHECK_SIZE && bitmap_out[y][x];
+                    ENFORCE(RegionContains(&out, x, y) == inside);
+                }
+            }
+        }
+    }
+    RegionFree(&a);
+    RegionFree(&b);
+    RegionFree(&out);
+    RegionFree(&expected);
+}
+
+static void bench_region(uint32_t rect_count)
+{
+    Region a, b, out;
+    RegionInit(&a);
+    RegionInit(&b);
+    RegionInit(&out);
+
+    uint64_t start = now_ns();
+    fragmented_region(&a, rect_count);
+    const uint64_t build_ns = now_ns() - start;
+    fragmented_region(&b, rect_count);
+
+    // what region_from_hrgn does with GetRegionData's rects
+    start = now_ns();
+    for (uint32_t i = 0; i < a.band_count; i++) {
+        const RegionBand* band = &a.bands[i];
+        for (uint32_t j = 0; j < band->span_count; j++) {
+            const RegionSpan* span = &a.spans[band->span_start + j];
+            RegionAppendRect(&out, span->left, band->top, span->right, band->bottom);
+        }
+    }
+    RegionAppendEnd(&out);
+    const uint64_t append_ns = now_ns() - start;
+    ENFORCE(RegionEqual(&out, &a));
+
+    static const char* const op_names[] = { "union", "intersect", "subtract", "xor" };
+    int64_t areas[4];
+    uint64_t op_ns[4];
+    for (int op = 0; op < 4; op++) {
+        start = now_ns();
+        for (int i = 0; i < REGION_ITERATIONS; i++) {
+            RegionCombine(&out, &a, &b, (RegionOp)op);
+        }
+        op_ns[op] = now_ns() - start;
+        areas[op] = RegionArea(&out);
+    }
+    // inclusion-exclusion keeps the ops honest with each other
+    ENFORCE(areas[REGION_OP_UNION] == RegionArea(&a) + RegionArea(&b) - areas[REGION_OP_INTERSECT]);
+    ENFORCE(areas[REGION_OP_SUBTRACT] == RegionArea(&a) - areas[REGION_OP_INTERSECT]);
+    ENFORCE(areas[REGION_OP_XOR] == areas[REGION_OP_UNION] - areas[REGION_OP_INTERSECT]);
+
+    printf("region rects=%-4u build=%8.1fus append=%6.1fus spans=%u/%u", rect_count, build_ns / 1e3,
+        append_ns / 1e3, RegionRectCount(&a), RegionRectCount(&b));
+    for (int op = 0; op < 4; op++) {
+        printf(" %s=%.2fus", op_names[op], op_ns[op] / 1e3 / REGION_ITERATIONS);
+    }
+    printf("\n");
+    RegionFree(&a);
+    RegionFree(&b);
+    RegionFree(&out);
+}
+
+// --------------------------------------------------------------------------------
+// MpscQueue
+// --------------------------------------------------------------------------------
+#define MPSC_ITEMS (1 << 22)
+#define MPSC_MAX_PRODUCERS 16
+
+// The semaphore stands in for the WM_APP_WORK message the UI thread waits on
+typedef struct {
+    MpscQueue queue;
+    sem_t wakeup;
+    MpscNode* nodes;
+    uint32_t producer_count;
+    volatile uint32_t ready;
+    volatile uint64_t wakeups;
+} MpscBench;
+
+typedef struct {
+    MpscBench* bench;
+    uint32_t index;
+} MpscProducer;
+
+static void* mpsc_producer(void* arg)
+{
+    const MpscProducer* producer = arg;
+    MpscBench* bench = producer->bench;
+    const uint32_t per_producer = MPSC_ITEMS / bench->producer_count;
+    MpscNode* nodes = bench->nodes + producer->index * per_producer;
+    __atomic_add_fetch(&bench->ready, 1, __ATOMIC_RELAXED);
+    while (__atomic_load_n(&bench->ready, __ATOMIC_ACQUIRE) <= bench->producer_count) { }
+    for (uint32_t i = 0; i < per_producer; i++) {
+        if (MpscQueuePush(&bench->queue, &nodes[i])) {
+            __atomic_add_fetch(&bench->wakeups, 1, __ATOMIC_RELAXED);
+            sem_post(&bench->wakeup);
+        }
+    }
+    return NULL;
+}
+
+static void bench_mpsc(uint32_t producer_count)
+{
+    MpscBench bench;
+    MpscQueueInit(&bench.queue);
+    ENFORCE(sem_init(&bench.wakeup, 0, 0) == 0);
+    bench.nodes = malloc(MPSC_ITEMS * sizeof(MpscNode));
+    ENFORCE(bench.nodes);
+    bench.producer_count = producer_count;
+    bench.ready = 0;
+    bench.wakeups = 0;
+
+    pthread_t threads[MPSC_MAX_PRODUCERS];
+    MpscProducer producers[MPSC_MAX_PRODUCERS];
+    for (uint32_t i = 0; i < producer_count; i++) {
+        producers[i].bench = &bench;
+        producers[i].index = i;
+        ENFORCE(pthread_create(&threads[i], NULL, mpsc_producer, &producers[i]) == 0);
+    }
+    while (__atomic_load_n(&bench.ready, __ATOMIC_RELAXED) < producer_count) { }
+
+    const uint64_t total = (uint64_t)(MPSC_ITEMS / producer_count) * producer_count;
+    uint64_t received = 0, batches = 0;
+    const uint64_t start = now_ns();
+    __atomic_add_fetch(&bench.ready, 1, __ATOMIC_RELEASE);
+    while (received < total) {
+        sem_wait(&bench.wakeup);
+        for (MpscNode* node = MpscQueueTakeAll(&bench.queue); node; node = node->next) {
+            received++;
+        }
+        batches++;
+    }
+    const uint64_t elapsed = now_ns() - start;
+    for (uint32_t i = 0; i < producer_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    printf("mpsc producers=%-2u %6.2fM items/s wakeups/item=%.5f avg_batch=%.1f\n",
+        producer_count, total / (elapsed / 1e9) / 1e6,
+        (double)bench.wakeups / total, (double)total / batches);
+    sem_destroy(&bench.wakeup);
+    free(bench.nodes);
+}
+
+// --------------------------------------------------------------------------------
+// TaskScheduler
+// --------------------------------------------------------------------------------
+#define TASK_COUNT 200000
+#define TASK_FANOUT 64
+#define TASK_MAX_WORKERS 16
+#define TASK_WAIT_NS ((uint64_t)10000000000) // a scheduler that loses tasks fails here
+
+typedef struct BenchTask {
+    Task task; // must be first
+    uint32_t spin; // iterations of busy work
+    // submitted from inside the task, from the worker's own deque
+    struct BenchTask* children;
+    uint32_t child_count;
+} BenchTask;
+
+static TaskScheduler* bench_scheduler;
+static volatile uint32_t tasks_done;
+static volatile uint32_t tasks_running;
+static volatile uint32_t tasks_max_running;
+
+static void bench_task_run(Task* task)
+{
+    BenchTask* t = (BenchTask*)task;
+    const uint32_t running = __atomic_add_fetch(&tasks_running, 1, __ATOMIC_RELAXED);
+    uint32_t max = __atomic_load_n(&tasks_max_running, __ATOMIC_RELAXED);
+    while (running > max &&
+        !__atomic_compare_exchange_n(&tasks_max_running, &max, running, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    volatile uint32_t work = 0;
+    for (uint32_t i = 0; i < t->spin; i++) work++;
+    for (uint32_t i = 0; i < t->child_count; i++) TaskSchedulerSubmit(bench_scheduler, &t->children[i].task);
+    __atomic_sub_fetch(&tasks_running, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&tasks_done, 1, __ATOMIC_RELEASE);
+}
+
+static void init_bench_tasks(BenchTask* tasks, uint32_t count, TaskKind kind, uint32_t spin)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        tasks[i].task.kind = kind;
+        tasks[i].task.run = bench_task_run;
+        tasks[i].spin = spin;
+        tasks[i].children = NULL;
+        tasks[i].child_count = 0;
+    }
+}
+
+static void wait_tasks(uint32_t count)
+{
+    const uint64_t start = now_ns();
+    while (__atomic_load_n(&tasks_done, __ATOMIC_ACQUIRE) < count) {
+        ENFORCE(now_ns() - start < TASK_WAIT_NS);
+        usleep(100);
+    }
+}
+
+// Resets the counters, submits count tasks from outside the workers and
+// waits for them.  Returns the ns it took.
+static uint64_t run_bench_tasks(BenchTask* tasks, uint32_t count, uint32_t expected)
+{
+    __atomic_store_n(&tasks_done, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&tasks_max_running, 0, __ATOMIC_RELAXED);
+    const uint64_t start = now_ns();
+    for (uint32_t i = 0; i < count; i++) TaskSchedulerSubmit(bench_scheduler, &tasks[i].task);
+    wait_tasks(expected);
+    return now_ns() - start;
+}
+
+static void bench_tasks(uint32_t worker_count)
+{
+    const uint32_t throttled = 1;
+    bench_scheduler = TaskSchedulerCreate(worker_count, throttled, now_ns());
+    BenchTask* tasks = malloc(TASK_COUNT * sizeof(BenchTask));
+    ENFORCE(tasks);
+    TaskSchedulerStats before, after;
+
+    // Throughput, everything submitted from outside and spread round robin
+    TaskSchedulerSetState(bench_scheduler, TASK_STATE_ACTIVE, now_ns());
+    init_bench_tasks(tasks, TASK_COUNT, TASK_KIND_BACKGROUND, 100);
+    TaskSchedulerGetStats(bench_scheduler, now_ns(), &before);
+    const uint64_t external_ns = run_bench_tasks(tasks, TASK_COUNT, TASK_COUNT);
+    TaskSchedulerGetStats(bench_scheduler, now_ns(), &after);
+    const uint64_t external_steals = after.steals - before.steals;
+    const uint32_t max_active = tasks_max_running;
+    ENFORCE(max_active <= worker_count);
+
+    // Fan out, each root task submits its children to its own worker's
+    // deque and the others have to steal them
+    const uint32_t roots = TASK_COUNT / TASK_FANOUT;
+    init_bench_tasks(tasks, TASK_COUNT, TASK_KIND_BACKGROUND, 100);
+    for (uint32_t i = 0; i < roots; i++) {
+        tasks[i].children = &tasks[roots + i * (TASK_FANOUT - 1)];
+        tasks[i].child_count = TASK_FANOUT - 1;
+    }
+    before = after;
+    const uint64_t fanout_ns = run_bench_tasks(tasks, roots, roots * TASK_FANOUT);
+    TaskSchedulerGetStats(bench_scheduler, now_ns(), &after);
+    const uint64_t fanout_steals = after.steals - before.steals;
+    ENFORCE(after.tasks_run[TASK_STATE_ACTIVE] - before.tasks_run[TASK_STATE_ACTIVE] == roots * TASK_FANOUT);
+
+    // Throttled, longer tasks so they overlap if the throttle leaks
+    const uint32_t throttle_count = 2000;
+    init_bench_tasks(tasks, throttle_count, TASK_KIND_BACKGROUND, 20000);
+    TaskSchedulerSetState(bench_scheduler, TASK_STATE_INACTIVE, now_ns());
+    run_bench_tasks(tasks, throttle_count, throttle_count);
+    const uint32_t max_inactive = tasks_max_running;
+    ENFORCE(max_inactive <= throttled);
+    TaskSchedulerSetState(bench_scheduler, TASK_STATE_MINIMIZED, now_ns());
+    run_bench_tasks(tasks, throttle_count, throttle_count);
+    const uint32_t max_minimized = tasks_max_running;
+    ENFORCE(max_minimized <= throttled);
+
+    // Render tasks wait out the minimized window, background ones don't
+    const uint32_t render_count = 1000, background_count = 1000;
+    init_bench_tasks(tasks, render_count, TASK_KIND_RENDER, 100);
+    init_bench_tasks(tasks + render_count, background_count, TASK_KIND_BACKGROUND, 100);
+    TaskSchedulerGetStats(bench_scheduler, now_ns(), &before);
+    run_bench_tasks(tasks, render_count + background_count, background_count);
+    usleep(20000);
+    ENFORCE(__atomic_load_n(&tasks_done, __ATOMIC_ACQUIRE) == background_count);
+    TaskSchedulerGetStats(bench_scheduler, now_ns(), &after);
+    ENFORCE(after.tasks_held - before.tasks_held == render_count);
+    ENFORCE(after.tasks_run[TASK_STATE_MINIMIZED] - before.tasks_run[TASK_STATE_MINIMIZED] == background_count);
+    const uint64_t restore_start = now_ns();
+    TaskSchedulerSetState(bench_scheduler, TASK_STATE_ACTIVE, now_ns());
+    wait_tasks(render_count + background_count);
+    const uint64_t restore_ns = now_ns() - restore_start;
+
+    printf("tasks workers=%-2u external=%.1fns/task steals=%llu fanout=%.1fns/task steals=%llu "
+        "max_running active=%u inactive=%u minimized=%u held=%u released_in=%.1fus\n",
+        worker_count, (double)external_ns / TASK_COUNT, (unsigned long long)external_steals,
+        (double)fanout_ns / (roots * TASK_FANOUT), (unsigned long long)fanout_steals,
+        max_active, max_inactive, max_minimized, render_count, restore_ns / 1e3);
+    TaskSchedulerDestroy(bench_scheduler);
+    free(tasks);
+}
+
+// --------------------------------------------------------------------------------
+// TimerWheel
+// --------------------------------------------------------------------------------
+#define TIMER_ACTIVE 100000
+#define TIMER_CHURN 1000000
+#define TIMER_RUN_MS 60000
+#define TIMER_MAX_DELAY 60000
+
+// The usual alternative, a binary min-heap that tracks each timer's index
+// so it can be cancelled
+typedef struct {
+    uint64_t expires;
+    uint32_t index;
+} HeapTimer;
+
+typedef struct {
+    HeapTimer** items;
+    uint32_t count;
+} TimerHeap;
+
+static void heap_swap(TimerHeap* heap, uint32_t a, uint32_t b)
+{
+    HeapTimer* tmp = heap->items[a];
+    heap->items[a] = heap->items[b];
+    heap->items[b] = tmp;
+    heap->items[a]->index = a;
+    heap->items[b]->index = b;
+}
+static void heap_up(TimerHeap* heap, uint32_t i)
+{
+    while (i > 0 && heap->items[(i - 1) / 2]->expires > heap->items[i]->expires) {
+        heap_swap(heap, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+static void heap_down(TimerHeap* heap, uint32_t i)
+{
+    while (true) {
+        uint32_t smallest = i;
+        const uint32_t left = 2 * i + 1, right = 2 * i + 2;
+        if (left < heap->count && heap->items[left]->expires < heap->items[smallest]->expires) smallest = left;
+        if (right < heap->count && heap->items[right]->expires < heap->items[smallest]->expires) smallest = right;
+        if (smallest == i) return;
+        heap_swap(heap, i, smallest);
+        i = smallest;
+    }
+}
+static void heap_add(TimerHeap* heap, HeapTimer* timer, uint64_t expires)
+{
+    timer->expires = expires;
+    timer->index = heap->count;
+    heap->items[heap->count++] = timer;
+    heap_up(heap, timer->index);
+}
+static void heap_remove(TimerHeap* heap, HeapTimer* timer)
+{
+    const uint32_t i = timer->index;
+    heap->count--;
+    if (i != heap->count) {
+        heap_swap(heap, i, heap->count);
+        heap_up(heap, i);
+        heap_down(heap, i);
+    }
+}
+
+static TimerWheel bench_wheel;
+static uint64_t bench_timer_now;
+static uint64_t bench_timer_fired;
+
+static void wheel_rearm(Timer* timer)
+{
+    bench_timer_fired++;
+    TimerWheelAdd(&bench_wheel, timer, bench_timer_now + 1 + rng_next() % TIMER_MAX_DELAY);
+}
+
+static void bench_timers(void)
+{
+    Timer* timers = calloc(TIMER_ACTIVE, sizeof(Timer));
+    HeapTimer* heap_timers = calloc(TIMER_ACTIVE, sizeof(HeapTimer));
+    TimerHeap heap = { malloc(TIMER_ACTIVE * sizeof(HeapTimer*)), 0 };
+    ENFORCE(timers && heap_timers && heap.items);
+
+    // wheel
+    bench_timer_now = 0;
+    bench_timer_fired = 0;
+    TimerWheelInit(&bench_wheel, 0);
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < TIMER_ACTIVE; i++) {
+        timers[i].callback = wheel_rearm;
+        TimerWheelAdd(&bench_wheel, &timers[i], 1 + rng_next() % TIMER_MAX_DELAY);
+    }
+    const uint64_t wheel_insert = now_ns() - start;
+    start = now_ns();
+    for (uint32_t i = 0; i < TIMER_CHURN; i++) {
+        Timer* timer = &timers[rng_next() % TIMER_ACTIVE];
+        TimerWheelCancel(&bench_wheel, timer);
+        TimerWheelAdd(&bench_wheel, timer, 1 + rng_next() % TIMER_MAX_DELAY);
+    }
+    const uint64_t wheel_churn = now_ns() - start;
+    start = now_ns();
+    for (bench_timer_now = 1; bench_timer_now <= TIMER_RUN_MS; bench_timer_now++) {
+        TimerWheelAdvance(&bench_wheel, bench_timer_now);
+    }
+    const uint64_t wheel_run = now_ns() - start;
+    const uint64_t wheel_fired = bench_timer_fired;
+
+    // heap
+    start = now_ns();
+    for (uint32_t i = 0; i < TIMER_ACTIVE; i++) {
+        heap_add(&heap, &heap_timers[i], 1 + rng_next() % TIMER_MAX_DELAY);
+    }
+    const uint64_t heap_insert = now_ns() - start;
+    start = now_ns();
+    for (uint32_t i = 0; i < TIMER_CHURN; i++) {
+        HeapTimer* timer = &heap_timers[rng_next() % TIMER_ACTIVE];
+        heap_remove(&heap, timer);
+        heap_add(&heap, timer, 1 + rng_next() % TIMER_MAX_DELAY);
+    }
+    const uint64_t heap_churn = now_ns() - start;
+    uint64_t heap_fired = 0;
+    start = now_ns();
+    for (uint64_t now = 1; now <= TIMER_RUN_MS; now++) {
+        while (heap.count && heap.items[0]->expires <= now) {
+            HeapTimer* timer = heap.items[0];
+            heap_remove(&heap, timer);
+            heap_add(&heap, timer, now + 1 + rng_next() % TIMER_MAX_DELAY);
+            heap_fired++;
+        }
+    }
+    const uint64_t heap_run = now_ns() - start;
+
+    printf("timers active=%u wheel: insert=%.1fns cancel+add=%.1fns fire=%.1fns (%llu fired)\n",
+        TIMER_ACTIVE, (double)wheel_insert / TIMER_ACTIVE, (double)wheel_churn / TIMER_CHURN,
+        (double)wheel_run / wheel_fired, (unsigned long long)wheel_fired);
+    printf("timers active=%u heap:  insert=%.1fns cancel+add=%.1fns fire=%.1fns (%llu fired)\n",
+        TIMER_ACTIVE, (double)heap_insert / TIMER_ACTIVE, (double)heap_churn / TIMER_CHURN,
+        (double)heap_run / heap_fired, (unsigned long long)heap_fired);
+    free(timers);
+    free(heap_timers);
+    free(heap.items);
+}
+
+// --------------------------------------------------------------------------------
+// Per-thread UI state
+// --------------------------------------------------------------------------------
+#define UI_THREAD_MAX 16
+#define UI_THREAD_MESSAGES 2000000
+
+// The thread-owned parts of basics.c's UiThread, each simulated message
+// touches all of them the way WndProc would
+typedef struct __attribute__((aligned(64))) {
+    MpscQueue work_queue;
+    unsigned msg_count;
+    HitTestGrid hit_test;
+    TimerWheel timers;
+    Timer timers_storage[64];
+    uint64_t fired;
+    volatile uint32_t* start;
+} BenchUiThread;
+
+static void bench_ui_timer(Timer* timer)
+{
+    (void)timer;
+}
+
+static void* bench_ui_thread(void* arg)
+{
+    BenchUiThread* ui = arg;
+    MpscNode work;
+    while (!__atomic_load_n(ui->start, __ATOMIC_ACQUIRE)) { }
+    for (uint32_t i = 0; i < UI_THREAD_MESSAGES; i++) {
+        ui->msg_count++;
+        int32_t code;
+        if (HitTestLookup(&ui->hit_test, (int32_t)(i % HIT_WIDTH), (int32_t)(i % HIT_HEIGHT), &code)) {
+            ui->fired += (uint64_t)code;
+        }
+        // every message posts to and drains its own queue, and re-arms a
+        // timer on its own wheel
+        MpscQueuePush(&ui->work_queue, &work);
+        for (MpscNode* node = MpscQueueTakeAll(&ui->work_queue); node; node = node->next) {
+            ui->fired++;
+        }
+        Timer* timer = &ui->timers_storage[i & 63];
+        TimerWheelCancel(&ui->timers, timer);
+        TimerWheelAdd(&ui->timers, timer, i + 1 + (i & 1023));
+        ui->fired += TimerWheelAdvance(&ui->timers, i);
+    }
+    return NULL;
+}
+
+static double bench_ui_threads(uint32_t thread_count, double baseline)
+{
+    BenchUiThread* uis = aligned_alloc(64, UI_THREAD_MAX * sizeof(BenchUiThread));
+    ENFORCE(uis);
+    volatile uint32_t start_flag = 0;
+    pthread_t threads[UI_THREAD_MAX];
+    for (uint32_t i = 0; i < thread_count; i++) {
+        BenchUiThread* ui = &uis[i];
+        MpscQueueInit(&ui->work_queue);
+        ui->msg_count = 0;
+        ui->fired = 0;
+        ui->start = &start_flag;
+        HitTestInit(&ui->hit_test);
+        for (uint32_t r = 0; r < 32; r++) {
+            HitRegion region = { (int32_t)r * 50, 0, (int32_t)r * 50 + 40, 30, 0, 2 /* HTCAPTION */ };
+            HitTestAddRegion(&ui->hit_test, &region);
+        }
+        HitTestResize(&ui->hit_test, HIT_WIDTH, HIT_HEIGHT);
+        TimerWheelInit(&ui->timers, 0);
+        for (uint32_t t = 0; t < 64; t++) {
+            ui->timers_storage[t].link.next = NULL;
+            ui->timers_storage[t].callback = bench_ui_timer;
+        }
+        ENFORCE(pthread_create(&threads[i], NULL, bench_ui_thread, ui) == 0);
+    }
+    const uint64_t start = now_ns();
+    __atomic_store_n(&start_flag, 1, __ATOMIC_RELEASE);
+    for (uint32_t i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    const uint64_t elapsed = now_ns() - start;
+    for (uint32_t i = 0; i < thread_count; i++) {
+        ENFORCE(uis[i].msg_count == UI_THREAD_MESSAGES);
+        sink += (int64_t)uis[i].fired;
+        HitTestFree(&uis[i].hit_test);
+    }
+    free(uis);
+
+    const double rate = (double)thread_count * UI_THREAD_MESSAGES / (elapsed / 1e9);
+    printf("ui_threads threads=%-2u %6.2fM msgs/s speedup=%.2f\n",
+        thread_count, rate / 1e6, baseline ? rate / baseline : 1.0);
+    return rate;
+}
+
+// --------------------------------------------------------------------------------
+// MsgSequence
+// --------------------------------------------------------------------------------
+#define SEQ_MESSAGES 10000000
+
+// the same rules basics.c checks every window against
+static const MsgSeqRule SEQ_RULES[] = {
+    { "creation order", "WM_GETMINMAXINFO WM_NCCREATE WM_NCCALCSIZE WM_CREATE [^WM_NCCREATE WM_CREATE]*" },
+    { "never destroyed", "[^WM_DESTROY]*" },
+    { "at most one WM_WINDOWPOSCHANGED per WM_WINDOWPOSCHANGING",
+      "( [^WM_WINDOWPOSCHANGED]"
+      " | WM_WINDOWPOSCHANGING [^WM_WINDOWPOSCHANGING WM_WINDOWPOSCHANGED]* WM_WINDOWPOSCHANGED )*" },
+};
+
+static bool seq_lookup(const char* name, size_t len, uint32_t* msg)
+{
+    for (uint32_t i = 0; i < 0x400; i++) {
+        const char* candidate = GetMsgName(i);
+        if (!strncmp(candidate, name, len) && !candidate[len]) {
+            *msg = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void bench_msg_seq(void)
+{
+    MsgSeqSpec spec;
+    char error[256];
+    const uint64_t compile_start = now_ns();
+    ENFORCE(MsgSeqCompile(&spec, SEQ_RULES, sizeof(SEQ_RULES) / sizeof(SEQ_RULES[0]), seq_lookup, error, sizeof(error)));
+    const uint64_t compile_ns = now_ns() - compile_start;
+
+    // creation, then a random mix of what a window sees while it's used
+    static const uint32_t steady[] = { 512, 132, 32, 15, 275, 0x8001, 70 };
+    uint32_t* stream = malloc(SEQ_MESSAGES * sizeof(uint32_t));
+    ENFORCE(stream);
+    const uint32_t creation[] = { 36, 129, 131, 1 };
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < 4; i++) stream[count++] = creation[i];
+    while (count < SEQ_MESSAGES - 1) {
+        const uint32_t msg = steady[rng_next() % 7];
+        stream[count++] = msg;
+        // WM_WINDOWPOSCHANGING
+        if (msg == 70) stream[count++] = 71;
+    }
+
+    MsgSeqVerifier verifier;
+    MsgSeqVerifierInit(&verifier, &spec);
+    const uint64_t start = now_ns();
+    int32_t violations = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        violations += (MsgSeqStep(&verifier, stream[i]) >= 0);
+    }
+    const uint64_t elapsed = now_ns() - start;
+    ENFORCE(violations == 0);
+    sink += verifier.states[0];
+
+    uint32_t states = 0;
+    for (uint32_t r = 0; r < spec.rule_count; r++) states += spec.dfas[r].state_count;
+    printf("msg_seq rules=%u states=%u classes=%u compile=%.1fus step=%.2fns/msg\n",
+        spec.rule_count, states, spec.class_count, compile_ns / 1e3, (double)elapsed / count);
+    MsgSeqVerifierFree(&verifier);
+    MsgSeqSpecFree(&spec);
+    free(stream);
+}
+
+// --------------------------------------------------------------------------------
+// MsgNameCache
+// --------------------------------------------------------------------------------
+#define NAME_MESSAGES 10000000
+#define NAME_ATOMS 256
+
+// Stands in for the system atom table.  A handful of these show up on every
+// desktop, the rest is what other programs registered.
+static const char* const NAME_COMMON[] = {
+    "MSWHEEL_ROLLMSG", "TaskbarCreated", "ShellHookMessage", "WM_HTML_GETOBJECT",
+    "MSUIM.Msg.Private", "MSUIM.Msg.RpcSendReceive", "MSUIM.Msg.LBUpdate", "MSUIM.Msg.MuiMgrDirtyUpdate",
+};
+#define NAME_COMMON_COUNT (sizeof(NAME_COMMON) / sizeof(NAME_COMMON[0]))
+static char name_atoms[NAME_ATOMS][32];
+static uint64_t name_resolves;
+
+static size_t stub_resolve(void* context, uint32_t msg, char* out, size_t size)
+{
+    (void)context;
+    name_resolves++;
+    const uint32_t atom = msg - MSG_REGISTERED_FIRST;
+    if (atom >= NAME_ATOMS) return 0;
+    const size_t len = strlen(name_atoms[atom]);
+    if (len >= size) return 0;
+    memcpy(out, name_atoms[atom], len + 1);
+    return len;
+}
+
+static void fill_name_atoms(void)
+{
+    for (uint32_t i = 0; i < NAME_ATOMS; i++) {
+        if (i < NAME_COMMON_COUNT) snprintf(name_atoms[i], sizeof(name_atoms[i]), "%s", NAME_COMMON[i]);
+        else snprintf(name_atoms[i], sizeof(name_atoms[i]), "App.Registered.%u", i);
+    }
+}
+
+static void bench_msg_names(void)
+{
+    fill_name_atoms();
+    // Mostly the common ones, some of everything else registered and a few
+    // ids the table doesn't know
+    uint32_t* stream = malloc(NAME_MESSAGES * sizeof(uint32_t));
+    ENFORCE(stream);
+    for (uint32_t i = 0; i < NAME_MESSAGES; i++) {
+        const uint32_t r = rng_next() % 100;
+        uint32_t atom;
+        if (r < 90) atom = rng_next() % NAME_COMMON_COUNT;
+        else if (r < 99) atom = rng_next() % NAME_ATOMS;
+        else atom = NAME_ATOMS + rng_next() % 64;
+        stream[i] = MSG_REGISTERED_FIRST + atom;
+    }
+
+    // every call goes to the backend, what logging did without the cache
+    char buf[256];
+    name_resolves = 0;
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < NAME_MESSAGES; i++) {
+        sink += (int64_t)stub_resolve(NULL, stream[i], buf, sizeof(buf));
+    }
+    const uint64_t uncached_ns = now_ns() - start;
+
+    MsgNameCache cache;
+    MsgNameCacheInit(&cache, stub_resolve, NULL);
+    name_resolves = 0;
+    start = now_ns();
+    for (uint32_t i = 0; i < NAME_MESSAGES; i++) {
+        sink += MsgNameCacheGet(&cache, stream[i])[0];
+    }
+    const uint64_t cached_ns = now_ns() - start;
+    ENFORCE(name_resolves == cache.misses);
+    ENFORCE(!strcmp(MsgNameCacheGet(&cache, MSG_REGISTERED_FIRST + 1), NAME_COMMON[1]));
+    ENFORCE(!strcmp(MsgNameCacheGet(&cache, MSG_REGISTERED_FIRST + NAME_ATOMS), "?"));
+    ENFORCE(!MsgNameCacheGet(&cache, 0x8001));
+
+    printf("msg_names cached=%.2fns/msg stub=%.2fns/msg hits=%.4f%% misses=%llu (%llu unresolved) entries=%u/%u\n",
+        (double)cached_ns / NAME_MESSAGES, (double)uncached_ns / NAME_MESSAGES,
+        100.0 * cache.hits / (cache.hits + cache.misses), (unsigned long long)cache.misses,
+        (unsigned long long)cache.unresolved, cache.count, cache.capacity);
+    MsgNameCacheFree(&cache);
+    free(stream);
+}
+
+// --------------------------------------------------------------------------------
+// FramePacer
+// --------------------------------------------------------------------------------
+#define PACER_INTERVAL_NS ((uint64_t)16000000)
+#define PACER_START_NS ((uint64_t)1000000000)
+
+// The deadline, skip, budget and timeout math on a synthetic clock
+static void check_frame_pacer(void)
+{
+    FramePacer pacer;
+    uint64_t budget;
+    FramePacerInit(&pacer, PACER_INTERVAL_NS, PACER_START_NS);
+    uint64_t t = PACER_START_NS;
+    ENFORCE(FramePacerTimeout(&pacer, t) == PACER_INTERVAL_NS);
+    ENFORCE(!FramePacerFrameDue(&pacer, t + PACER_INTERVAL_NS - 1, &budget));
+    ENFORCE(FramePacerTimeout(&pacer, t + PACER_INTERVAL_NS - 1) == 1);
+
+    // on time, the whole next interval is the budget
+    t += PACER_INTERVAL_NS;
+    ENFORCE(FramePacerTimeout(&pacer, t) == 0);
+    ENFORCE(FramePacerFrameDue(&pacer, t, &budget));
+    ENFORCE(budget == PACER_INTERVAL_NS && pacer.missed_deadlines == 0);
+    // finishing exactly on budget isn't an overrun, one ns later is
+    FramePacerFrameDone(&pacer, t + budget);
+    ENFORCE(pacer.overruns == 0 && pacer.frame_count == 1);
+    ENFORCE(!FramePacerFrameDue(&pacer, t + budget - 1, &budget));
+
+    // two and a half intervals late: two ticks dropped, the schedule
+    // stays aligned and the budget is what's left of the current one
+    const uint64_t deadline = pacer.deadline_ns;
+    t = deadline + 2 * PACER_INTERVAL_NS + PACER_INTERVAL_NS / 2;
+    ENFORCE(FramePacerFrameDue(&pacer, t, &budget));
+    ENFORCE(pacer.missed_deadlines == 2);
+    ENFORCE(pacer.deadline_ns == deadline + 3 * PACER_INTERVAL_NS);
+    ENFORCE(budget == PACER_INTERVAL_NS / 2);
+    FramePacerFrameDone(&pacer, t + budget + 1);
+    ENFORCE(pacer.overruns == 1 && pacer.frame_count == 2);
+    // the overrun frame ended past the deadline, there's no wait
+    ENFORCE(FramePacerTimeout(&pacer, t + budget + 1) == 0);
+
+    // the phases add up to the time since init
+    FramePacerEnterPhase(&pacer, FRAME_PHASE_IDLE, t + 10);
+    FramePacerEnterPhase(&pacer, FRAME_PHASE_WAIT, t + 30);
+    FramePacerEnterPhase(&pacer, FRAME_PHASE_DISPATCH, t + 100);
+    ENFORCE(pacer.phase_ns[FRAME_PHASE_IDLE] == 20 && pacer.phase_ns[FRAME_PHASE_WAIT] == 70);
+    ENFORCE(pacer.phase_ns[FRAME_PHASE_DISPATCH] + 90 == t + 100 - PACER_START_NS);
+}
+
+// frame_loop's structure on a synthetic clock, with a message arriving
+// every arrival_ns that takes cost_ns to dispatch.  Returns the frames run
+// in one simulated second.
+static uint64_t simulate_frame_loop(uint64_t arrival_ns, uint64_t cost_ns, uint64_t frame_ns)
+{
+    FramePacer pacer;
+    uint64_t now = 0, next_arrival = 0;
+    FramePacerInit(&pacer, PACER_INTERVAL_NS, now);
+    while (now < 1000000000) {
+        // dispatch, bounded by the frame deadline like frame_loop
+        while (next_arrival <= now) {
+            next_arrival += arrival_ns;
+            now += cost_ns;
+            if (!FramePacerTimeout(&pacer, now)) break;
+        }
+        uint64_t budget;
+        if (FramePacerFrameDue(&pacer, now, &budget)) {
+            now += frame_ns;
+            FramePacerFrameDone(&pacer, now);
+        }
+        // wait for the next message or the frame, whichever is first
+        const uint64_t timeout = FramePacerTimeout(&pacer, now);
+        const uint64_t wake = (next_arrival < now + timeout) ? next_arrival : now + timeout;
+        if (wake > now) now = wake;
+    }
+    return pacer.frame_count;
+}
+
+static void bench_frame_pacer(void)
+{
+    check_frame_pacer();
+    // a 1 kHz stream that takes all the time there is never drains, the
+    // loop still paints at the frame rate instead of never leaving dispatch
+    const uint64_t busy = simulate_frame_loop(1000000, 1000000, 1000000);
+    const uint64_t idle = simulate_frame_loop(100000000, 100000, 1000000);
+    ENFORCE(busy >= 55 && idle >= 60);
+    printf("frame_pacer frames/s busy=%llu idle=%llu\n", (unsigned long long)busy, (unsigned long long)idle);
+}
+
+// --------------------------------------------------------------------------------
+// StartupProfile
+// --------------------------------------------------------------------------------
+#define STARTUP_RUNS 101
+
+// The platform-neutral part of what wWinMain and ui_thread_init do before
+// the window exists, in the same order.  Creating the window and the first
+// paint need the real thing, basics.exe logs those, so the total here is
+// init only.
+static uint64_t startup_once(StartupProfile* profile, bool profile_handlers)
+{
+    static SessionStats stats;
+    StartupProfileInit(profile, now_ns());
+    MsgSeqSpec spec;
+    char error[256];
+    ENFORCE(MsgSeqCompile(&spec, SEQ_RULES, sizeof(SEQ_RULES) / sizeof(SEQ_RULES[0]), seq_lookup, error, sizeof(error)));
+    StartupProfileMark(profile, "MsgSeqCompile", now_ns());
+    MpscQueue work_queue;
+    MpscQueueInit(&work_queue);
+    MsgSeqVerifier verifier;
+    MsgSeqVerifierInit(&verifier, &spec);
+    MsgNameCache names;
+    MsgNameCacheInit(&names, stub_resolve, NULL);
+    HandlerProfile* handler_profile = profile_handlers ? HandlerProfileCreate() : NULL;
+    SessionStatsInit(&stats, now_ns() / 1000000);
+    HitTestGrid grid;
+    HitTestInit(&grid);
+    Region nc_update, update;
+    RegionInit(&nc_update);
+    RegionInit(&update);
+    TimerWheel wheel;
+    TimerWheelInit(&wheel, now_ns() / 1000000);
+    PointerBatch pointer;
+    PointerBatchInit(&pointer);
+    // one UI thread gets every core, starting the workers is most of the cost
+    const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    TaskScheduler* tasks = TaskSchedulerCreate((cores > 0) ? (uint32_t)cores : 1, 1, now_ns());
+    TextEditor editor;
+    TextEditorInit(&editor, NULL, 0);
+    const uint64_t total = StartupProfileFinish(profile, "ui_thread_init", now_ns());
+
+    TextEditorFree(&editor);
+    TaskSchedulerDestroy(tasks);
+    PointerBatchFree(&pointer);
+    RegionFree(&update);
+    RegionFree(&nc_update);
+    HitTestFree(&grid);
+    if (handler_profile) HandlerProfileDestroy(handler_profile);
+    MsgNameCacheFree(&names);
+    MsgSeqVerifierFree(&verifier);
+    MsgSeqSpecFree(&spec);
+    return total;
+}
+
+static int compare_u64(const void* a, const void* b)
+{
+    const uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void bench_startup(void)
+{
+    // the first run pays for page faults and cold caches like a real start,
+    // the warm runs are steadier for spotting regressions
+    StartupProfile profile;
+    const uint64_t cold = startup_once(&profile, false);
+    char report[STARTUP_MAX_MARKS * 64];
+    StartupProfileFormat(&profile, report, sizeof(report));
+    printf("startup init-only cold=%.1fus\n%s\n", cold / 1e3, report);
+    for (int profile_handlers = 0; profile_handlers < 2; profile_handlers++) {
+        uint64_t totals[STARTUP_RUNS];
+        for (uint32_t i = 0; i < STARTUP_RUNS; i++) totals[i] = startup_once(&profile, profile_handlers);
+        qsort(totals, STARTUP_RUNS, sizeof(uint64_t), compare_u64);
+        printf("startup init-only warm%s median=%.1fus min=%.1fus max=%.1fus\n",
+            profile_handlers ? " PROFILE_HANDLERS" : "",
+            totals[STARTUP_RUNS / 2] / 1e3, totals[0] / 1e3, totals[STARTUP_RUNS - 1] / 1e3);
+    }
+}
+
+// --------------------------------------------------------------------------------
+// HandlerProfile
+// --------------------------------------------------------------------------------
+#define HANDLER_MESSAGES 1000000
+
+// Stands in for a window: each message does what its basics.c handler does
+// with the platform-neutral parts
+typedef struct {
+    HandlerProfile* profile; // NULL to run without
+    HitTestGrid grid;
+    PointerBatch pointer;
+    TextEditor editor;
+    MsgNameCache names;
+    TimerWheel wheel;
+    Region update;
+    Region nc_update;
+    uint64_t now;
+    int32_t width, height; // for WM_WINDOWPOSCHANGED
+    char log[256];
+    uint64_t log_bytes;
+} HandlerWindow;
+
+static HandlerWindow handler_window;
+
+static const char* handler_msg_name(uint32_t msg)
+{
+    const char* name = MsgNameCacheGet(&handler_window.names, msg);
+    return name ? name : GetMsgName(msg);
+}
+
+static void handler_wndproc(HandlerWindow* w, uint32_t msg);
+
+static void handler_dispatch(HandlerWindow* w, uint32_t msg)
+{
+    switch (msg) {
+    case 132: { // WM_NCHITTEST
+        int32_t code;
+        sink += HitTestLookup(&w->grid, rng_range(0, HIT_WIDTH), rng_range(0, HIT_HEIGHT), &code);
+        break;
+    }
+    case 512: // WM_MOUSEMOVE
+        PointerBatchAdd(&w->pointer, rng_range(0, HIT_WIDTH), rng_range(0, HIT_HEIGHT), 0, 0, w->now);
+        if (w->pointer.count == 16) PointerBatchClear(&w->pointer);
+        break;
+    case 258: { // WM_CHAR
+        const TextChar c = (rng_next() % 60) ? 'a' : '\n';
+        TextEditorInsert(&w->editor, &c, 1);
+        break;
+    }
+    case 275: // WM_TIMER
+        w->now += 16;
+        sink += TimerWheelAdvance(&w->wheel, w->now);
+        break;
+    case 15: { // WM_PAINT
+        size_t first, last;
+        RegionClear(&w->update);
+        if (TextEditorTakeDirty(&w->editor, &first, &last)) {
+            if (last > first + 50) last = first + 50;
+            TextChar line[128];
+            for (size_t i = first; i <= last; i++) {
+                const size_t length = TextBufferLineLength(&w->editor.buffer, i);
+                sink += TextBufferCopy(&w->editor.buffer, TextBufferLineStart(&w->editor.buffer, i),
+                    (length < 128) ? length : 128, line);
+                RegionUnionRect(&w->update, 0, (int32_t)i * 16, HIT_WIDTH, (int32_t)(i + 1) * 16);
+            }
+        }
+        // BeginPaint sends WM_ERASEBKGND from inside WM_PAINT
+        handler_wndproc(w, 20);
+        break;
+    }
+    case 20: // WM_ERASEBKGND
+        sink += RegionArea(&w->update);
+        break;
+    case 71: // WM_WINDOWPOSCHANGED, logs twice and resizes the hit test grid
+        w->log_bytes += snprintf(w->log, sizeof(w->log), "WM_WINDOWPOSCHANGED %d,%d %dx%d hwndInsertAfter=0x%p count=%u",
+            0, 0, w->width, w->height, NULL, (unsigned)w->now);
+        w->log_bytes += snprintf(w->log, sizeof(w->log), "  flags=0x%x %s", 0x16, "NOMOVE,NOZORDER,NOACTIVATE");
+        HitTestResize(&w->grid, w->width, w->height);
+        // DefWindowProc sends WM_SIZE, WM_MOVE only for moves
+        handler_wndproc(w, 5);
+        break;
+    case 5: // WM_SIZE, logged
+        w->log_bytes += snprintf(w->log, sizeof(w->log), "WM_SIZE: type=%s (%u), width=%d, height=%d",
+            "RESTORED", 0, w->width, w->height);
+        break;
+    case 131: // WM_NCCALCSIZE, logged
+        w->log_bytes += snprintf(w->log, sizeof(w->log), "WM_NCCALCSIZE(TRUE) (%d,%d)-(%d,%d) %dx%d",
+            0, 0, w->width, w->height, w->width, w->height);
+        break;
+    case 133: { // WM_NCPAINT, the frame's region from GetRegionData
+        const int32_t frame = 8, caption = 31;
+        RegionClear(&w->nc_update);
+        RegionAppendRect(&w->nc_update, 0, 0, w->width, caption);
+        RegionAppendRect(&w->nc_update, 0, caption, frame, w->height - frame);
+        RegionAppendRect(&w->nc_update, w->width - frame, caption, w->width, w->height - frame);
+        RegionAppendRect(&w->nc_update, 0, w->height - frame, w->width, w->height);
+        RegionAppendEnd(&w->nc_update);
+        w->log_bytes += snprintf(w->log, sizeof(w->log), "WM_NCPAINT: region: %u rects area=%lld",
+            RegionRectCount(&w->nc_update), (long long)RegionArea(&w->nc_update));
+        break;
+    }
+    case 70: // WM_WINDOWPOSCHANGING, mostly logging
+        w->log_bytes += snprintf(w->log, sizeof(w->log), "WM_WINDOWPOSCHANGING %d,%d %dx%d flags=0x%x",
+            rng_range(0, 100), rng_range(0, 100), rng_range(100, 2000), rng_range(100, 2000), rng_next());
+        break;
+    case 6: // WM_ACTIVATE, only logged
+        w->log_bytes += snprintf(w->log, sizeof(w->log), "WM_ACTIVATE: state=%u minimized=0", (unsigned)(rng_next() & 1));
+        break;
+    default: // registered messages are only logged
+        w->log_bytes += snprintf(w->log, sizeof(w->log), "String Message %s (0x%x)", handler_msg_name(msg), msg);
+        break;
+    }
+}
+
+static void handler_wndproc(HandlerWindow* w, uint32_t msg)
+{
+    if (!w->profile) {
+        handler_dispatch(w, msg);
+        return;
+    }
+    HandlerSample sample;
+    HandlerProfileBegin(w->profile, &sample);
+    handler_dispatch(w, msg);
+    HandlerProfileEnd(w->profile, &sample, msg);
+}
+
+static void handler_window_init(HandlerProfile* profile)
+{
+    HandlerWindow* w = &handler_window;
+    w->profile = profile;
+    HitTestInit(&w->grid);
+    HitTestResize(&w->grid, HIT_WIDTH, HIT_HEIGHT);
+    for (uint32_t i = 0; i < 100; i++) {
+        HitRegion region = { rng_range(0, HIT_WIDTH), rng_range(0, HIT_HEIGHT), 0, 0, 0, (int32_t)i };
+        region.right = region.left + rng_range(1, 200);
+        region.bottom = region.top + rng_range(1, 200);
+        HitTestAddRegion(&w->grid, &region);
+    }
+    PointerBatchInit(&w->pointer);
+    TextEditorInit(&w->editor, NULL, 0);
+    MsgNameCacheInit(&w->names, stub_resolve, NULL);
+    TimerWheelInit(&w->wheel, 0);
+    RegionInit(&w->update);
+    RegionInit(&w->nc_update);
+    w->now = 0;
+    w->width = HIT_WIDTH;
+    w->height = HIT_HEIGHT;
+    w->log_bytes = 0;
+}
+
+static void handler_window_free(void)
+{
+    HandlerWindow* w = &handler_window;
+    RegionFree(&w->update);
+    RegionFree(&w->nc_update);
+    MsgNameCacheFree(&w->names);
+    TextEditorFree(&w->editor);
+    PointerBatchFree(&w->pointer);
+    HitTestFree(&w->grid);
+}
+
+static uint64_t handler_run(HandlerProfile* profile, const uint32_t* stream)
+{
+    HandlerWindow* w = &handler_window;
+    handler_window_init(profile);
+    const uint64_t start = now_ns();
+    for (uint32_t i = 0; i < HANDLER_MESSAGES; i++) handler_wndproc(w, stream[i]);
+    const uint64_t elapsed = now_ns() - start;
+
+    if (profile) {
+        const size_t len = HandlerProfileReport(profile, handler_msg_name, NULL, 0);
+        char* report = malloc(len + 1);
+        ENFORCE(report);
+        ENFORCE(HandlerProfileReport(profile, handler_msg_name, report, len + 1) == len);
+        printf("%s\n", report);
+        free(report);
+    }
+    handler_window_free();
+    return elapsed;
+}
+
+static void bench_handlers(void)
+{
+    // a typing user moving the mouse, with the odd string message
+    static const uint32_t mix[] = { 512, 512, 512, 512, 132, 132, 258, 258, 15, 275, 70, MSG_REGISTERED_FIRST + 1 };
+    fill_name_atoms();
+    uint32_t* stream = malloc(HANDLER_MESSAGES * sizeof(uint32_t));
+    ENFORCE(stream);
+    for (uint32_t i = 0; i < HANDLER_MESSAGES; i++) stream[i] = mix[rng_next() % (sizeof(mix) / sizeof(mix[0]))];
+
+    const uint64_t plain_ns = handler_run(NULL, stream);
+    HandlerProfile* profile = HandlerProfileCreate();
+    printf("handlers counters=%s\n", (HandlerProfileCounterCount(profile) > 1) ? "perf_event" : "rdtsc");
+    const uint64_t profiled_ns = handler_run(profile, stream);
+    printf("handlers plain=%.1fns/msg profiled=%.1fns/msg\n",
+        (double)plain_ns / HANDLER_MESSAGES, (double)profiled_ns / HANDLER_MESSAGES);
+    HandlerProfileDestroy(profile);
+    free(stream);
+}
+
+// --------------------------------------------------------------------------------
+// Workload
+// --------------------------------------------------------------------------------
+
+// The frame of the stand-in window, in window coordinates
+#define WORKLOAD_FRAME 8
+#define WORKLOAD_CAPTION 32
+
+static void workload_send(HandlerWindow* w, WorkloadStats* stats, uint32_t msg)
+{
+    const uint64_t start = now_ns();
+    handler_wndproc(w, msg);
+    WorkloadStatsAdd(stats, now_ns() - start);
+}
+
+// What run_scenario in basics.c sends for each step, as far as the stand-in
+// window handles it
+static void workload_play(HandlerWindow* w, WorkloadStats* stats, const WorkloadStep* step, int32_t width, int32_t height)
+{
+    switch (step->kind) {
+    case WORKLOAD_STEP_RESIZE:
+        // SetWindowPos with SWP_NOMOVE, then UpdateWindow
+        w->width = step->a;
+        w->height = step->b;
+        workload_send(w, stats, 70); // WM_WINDOWPOSCHANGING
+        workload_send(w, stats, 131); // WM_NCCALCSIZE
+        workload_send(w, stats, 71); // WM_WINDOWPOSCHANGED, WM_SIZE from inside it
+        workload_send(w, stats, 133); // WM_NCPAINT
+        workload_send(w, stats, 15); // WM_PAINT, WM_ERASEBKGND from inside it
+        break;
+    case WORKLOAD_STEP_POINTER:
+        workload_send(w, stats, 132); // WM_NCHITTEST
+        if (step->a >= WORKLOAD_FRAME && step->a < width - WORKLOAD_FRAME &&
+            step->b >= WORKLOAD_CAPTION && step->b < height - WORKLOAD_FRAME) {
+            workload_send(w, stats, 512); // WM_MOUSEMOVE
+        }
+        break;
+    case WORKLOAD_STEP_ACTIVATE:
+        workload_send(w, stats, 6); // WM_ACTIVATE
+        break;
+    case WORKLOAD_STEP_STRING:
+        workload_send(w, stats, MSG_REGISTERED_FIRST + (uint32_t)step->a);
+        break;
+    }
+}
+
+static void workload_run(WorkloadKind kind, HandlerProfile* profile)
+{
+    HandlerWindow* w = &handler_window;
+    handler_window_init(profile);
+    Workload workload;
+    WorkloadInit(&workload, kind, HIT_WIDTH / 2, HIT_HEIGHT / 2);
+    WorkloadStats stats;
+    WorkloadStatsInit(&stats, 1 << 16, now_ns());
+    WorkloadStep step;
+    uint32_t steps = 0;
+    while (WorkloadNext(&workload, &step)) {
+        // the pointer never leaves the window
+        ENFORCE(step.kind != WORKLOAD_STEP_POINTER ||
+            (step.a >= 0 && step.a < workload.width && step.b >= 0 && step.b < workload.height));
+        workload_play(w, &stats, &step, workload.width, workload.height);
+        steps++;
+    }
+    WorkloadStatsFinish(&stats, now_ns());
+    ENFORCE(steps == workload.step_count);
+    stats.log_bytes = w->log_bytes;
+
+    char line[256];
+    char name[32];
+    snprintf(name, sizeof(name), "%s%s", WorkloadName(kind), profile ? "+prof" : "");
+    WorkloadStatsFormat(&stats, name, line, sizeof(line));
+    printf("workload %s\n", line);
+    WorkloadStatsFree(&stats);
+    handler_window_free();
+}
+
+// The scenarios basics.exe runs with SCENARIOS=1, through the stand-in
+// window, with and without the handler profile
+static void bench_workloads(void)
+{
+    fill_name_atoms();
+    for (uint32_t kind = 0; kind < WORKLOAD_COUNT; kind++) {
+        workload_run((WorkloadKind)kind, NULL);
+        HandlerProfile* profile = HandlerProfileCreate();
+        workload_run((WorkloadKind)kind, profile);
+        HandlerProfileDestroy(profile);
+    }
+}
+
+// --------------------------------------------------------------------------------
+// SessionStats
+// --------------------------------------------------------------------------------
+#define STATS_MESSAGES 10000000
+
+static void stats_key_name(StatsHistogramId id, uint32_t key, char* out, size_t size)
+{
+    snprintf(out, size, "%d/%d", (int)id, (int32_t)key);
+}
+
+static void bench_stats(void)
+{
+    // the handler mix again, at 2000 messages a second
+    static const uint32_t mix[] = { 512, 512, 512, 512, 132, 132, 258, 258, 15, 275, 70, 5, 642, MSG_REGISTERED_FIRST + 1 };
+    uint32_t* stream = malloc(STATS_MESSAGES * sizeof(uint32_t));
+    ENFORCE(stream);
+    for (uint32_t i = 0; i < STATS_MESSAGES; i++) stream[i] = mix[rng_next() % (sizeof(mix) / sizeof(mix[0]))];
+
+    static SessionStats stats;
+    SessionStatsInit(&stats, 0);
+    uint64_t hit_tests = 0;
+    const uint64_t start = now_ns();
+    for (uint32_t i = 0; i < STATS_MESSAGES; i++) {
+        const uint32_t msg = stream[i];
+        SessionStatsMessage(&stats, msg, i / 2);
+        // what the handlers add, keys from the message index so the
+        // check below can count them
+        switch (msg) {
+        case 132: SessionStatsAdd(&stats, STATS_HIT_TEST, (uint32_t)(int32_t)(i % 24) - 2); hit_tests++; break;
+        case 70: SessionStatsAdd(&stats, STATS_SWP_FLAGS, (i % 8) * 0x11); break;
+        case 5: SessionStatsAdd(&stats, STATS_SIZE_TYPE, i % 5); break;
+        case 642: SessionStatsAdd(&stats, STATS_IME_NOTIFY, 1 + i % 14); break;
+        default: break;
+        }
+    }
+    const uint64_t elapsed = now_ns() - start;
+    uint64_t counted = 0;
+    for (int32_t code = -2; code < 22; code++) counted += SessionStatsCount(&stats, STATS_HIT_TEST, (uint32_t)code);
+    ENFORCE(counted == hit_tests);
+    ENFORCE(SessionStatsMsgCount(&stats, 132) == hit_tests);
+
+    const StatsNames names = { GetMsgName, stats_key_name };
+    const uint64_t now = STATS_MESSAGES / 2;
+    StatsRates rates;
+    SessionStatsRates(&stats, now, &rates);
+    // exactly 2000 a second the whole way through
+    ENFORCE(rates.last_1s == 2000.0 && rates.last_60s == 2000.0 && rates.peak_1s == 2000.0);
+    FILE* file = tmpfile();
+    ENFORCE(file);
+    const uint64_t csv_start = now_ns();
+    ENFORCE(SessionStatsWriteCsv(&stats, &names, now, file));
+    const uint64_t csv_ns = now_ns() - csv_start;
+    const long csv_bytes = ftell(file);
+    rewind(file);
+    const uint64_t json_start = now_ns();
+    ENFORCE(SessionStatsWriteJson(&stats, &names, now, file));
+    const uint64_t json_ns = now_ns() - json_start;
+    const long json_bytes = ftell(file);
+    fclose(file);
+
+    printf("stats record=%.2fns/msg size=%zuB csv=%ldB in %.1fus json=%ldB in %.1fus\n",
+        (double)elapsed / STATS_MESSAGES, sizeof(stats), csv_bytes, csv_ns / 1e3, json_bytes, json_ns / 1e3);
+    free(stream);
+}
+
+// --------------------------------------------------------------------------------
+// TraceRing
+// --------------------------------------------------------------------------------
+#define TRACE_MESSAGES 20000000
+#define TRACE_CAPACITY (1 << 16)
+
+typedef struct {
+    const char* name;
+    volatile bool done;
+    uint64_t read;
+    uint64_t dropped;
+    uint64_t torn;
+} TraceReader;
+
+static void* trace_reader(void* arg)
+{
+    TraceReader* reader = arg;
+    TraceRing ring;
+    ENFORCE(TraceRingAttach(&ring, reader->name));
+    static TraceRecord batch[4096];
+    for (;;) {
+        const bool done = __atomic_load_n(&reader->done, __ATOMIC_ACQUIRE);
+        const uint32_t count = TraceRingRead(&ring, batch, 4096);
+        for (uint32_t i = 0; i < count; i++) {
+            // every field is derived from the record's index, a mix of two
+            // records would show up here
+            const TraceRecord* r = &batch[i];
+            if (r->time_ns != r->seq || r->duration_ns != r->seq * 3 || r->msg != (uint32_t)(r->seq % 0x400)) {
+                reader->torn++;
+            }
+        }
+        reader->read += count;
+        if (!count) {
+            if (done) break;
+            sched_yield();
+        }
+    }
+    reader->dropped = ring.dropped;
+    TraceRingClose(&ring);
+    return NULL;
+}
+
+static void bench_trace_ring(void)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "bench-%d", (int)getpid());
+    TraceRing ring;
+    ENFORCE(TraceRingCreate(&ring, name, TRACE_CAPACITY, (uint32_t)getpid()));
+
+    // alone first, then with a monitor draining it
+    uint64_t start = now_ns();
+    for (uint64_t n = 0; n < TRACE_MESSAGES; n++) TraceRingPublish(&ring, (uint32_t)(n % 0x400), 0, n, n * 3);
+    const uint64_t alone_ns = now_ns() - start;
+
+    TraceRingClose(&ring);
+    ENFORCE(TraceRingCreate(&ring, name, TRACE_CAPACITY, (uint32_t)getpid()));
+    TraceReader reader = { name, false, 0, 0, 0 };
+    pthread_t thread;
+    ENFORCE(pthread_create(&thread, NULL, trace_reader, &reader) == 0);
+    start = now_ns();
+    for (uint64_t n = 0; n < TRACE_MESSAGES; n++) TraceRingPublish(&ring, (uint32_t)(n % 0x400), 0, n, n * 3);
+    const uint64_t shared_ns = now_ns() - start;
+    __atomic_store_n(&reader.done, true, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+    TraceRingClose(&ring);
+
+    ENFORCE(reader.torn == 0);
+    // the reader attaches after the writer may already have lapped it
+    ENFORCE(reader.read + reader.dropped <= TRACE_MESSAGES);
+    printf("trace_ring publish=%.2fns/msg with reader=%.2fns/msg read=%llu dropped=%llu torn=%llu\n",
+        (double)alone_ns / TRACE_MESSAGES, (double)shared_ns / TRACE_MESSAGES,
+        (unsigned long long)reader.read, (unsigned long long)reader.dropped, (unsigned long long)reader.torn);
+}
+
+// `bench trace [seconds]` publishes the handler stand-in's messages to a
+// ring for monitor to attach to, about 100k messages a second
+static int trace_publisher(uint32_t seconds)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "bench-%d", (int)getpid());
+    TraceRing ring;
+    ENFORCE(TraceRingCreate(&ring, name, TRACE_CAPACITY, (uint32_t)getpid()));
+    printf("publishing to %s for %us, run: out/monitor %s\n", name, seconds, name);
+    fflush(stdout);
+
+    static const uint32_t mix[] = { 512, 512, 512, 512, 132, 132, 258, 258, 15, 275, 70, MSG_REGISTERED_FIRST + 1 };
+    fill_name_atoms();
+    handler_window_init(NULL);
+    HandlerWindow* w = &handler_window;
+    const uint64_t end = now_ns() + (uint64_t)seconds * 1000000000;
+    while (now_ns() < end) {
+        for (uint32_t i = 0; i < 100; i++) {
+            const uint32_t msg = mix[rng_next() % (sizeof(mix) / sizeof(mix[0]))];
+            const uint64_t start = now_ns();
+            handler_dispatch(w, msg);
+            TraceRingPublish(&ring, msg, 0, start, now_ns() - start);
+        }
+        usleep(1000);
+    }
+    handler_window_free();
+    TraceRingClose(&ring);
+    return 0;
+}
+
+// --------------------------------------------------------------------------------
+// TraceDiff
+// --------------------------------------------------------------------------------
+#define DIFF_RECORDS 4000000
+#define DIFF_WINDOW (1 << 16)
+
+typedef struct {
+    const TraceFileRecord* records;
+    uint32_t count;
+    uint32_t next;
+} DiffSource;
+
+static uint32_t diff_read(void* source, TraceFileRecord* out, uint32_t max)
+{
+    DiffSource* s = source;
+    // short reads, like a file's, so windows get topped up in pieces
+    uint32_t count = s->count - s->next;
+    if (count > max) count = max;
+    if (count > 5000) count = 5000;
+    memcpy(out, s->records + s->next, count * sizeof(TraceFileRecord));
+    s->next += count;
+    return count;
+}
+
+typedef struct {
+    const TraceFileRecord* a;
+    const TraceFileRecord* b;
+    uint64_t a_next, b_next; // the first record not checked yet
+} DiffCheck;
+
+static bool same_key(const TraceFileRecord* x, const TraceFileRecord* y)
+{
+    return x->msg == y->msg && x->detail == y->detail;
+}
+
+// Every hunk has to point at the right records and everything between two
+// hunks has to match, then the hunks turn a into b
+static void diff_check_hunk(void* context, const TraceDiffHunk* hunk)
+{
+    DiffCheck* check = context;
+    ENFORCE(hunk->a_index - check->a_next == hunk->b_index - check->b_next);
+    for (uint64_t i = check->a_next, j = check->b_next; i < hunk->a_index; i++, j++) {
+        ENFORCE(same_key(&check->a[i], &check->b[j]));
+    }
+    for (uint32_t i = 0; i < hunk->context_count; i++) {
+        ENFORCE(same_key(&hunk->context[i], &check->a[hunk->a_index - hunk->context_count + i]));
+    }
+    for (uint32_t i = 0; i < hunk->a_count; i++) ENFORCE(same_key(&hunk->a[i], &check->a[hunk->a_index + i]));
+    for (uint32_t i = 0; i < hunk->b_count; i++) ENFORCE(same_key(&hunk->b[i], &check->b[hunk->b_index + i]));
+    check->a_next = hunk->a_index + hunk->a_count;
+    check->b_next = hunk->b_index + hunk->b_count;
+}
+
+static TraceFileRecord diff_random_record(void)
+{
+    static const uint32_t mix[] = { 512, 512, 132, 32, 15, 70, 71, 131, 5, 258 };
+    TraceFileRecord record = { mix[rng_next() % 10], rng_next() % 4, rng_next(), rng_next() };
+    return record;
+}
+
+// b is a with an edit every gap records on average: a record dropped,
+// added or swapped for another
+static void bench_trace_diff(uint32_t gap)
+{
+    TraceFileRecord* a = malloc(DIFF_RECORDS * sizeof(TraceFileRecord));
+    TraceFileRecord* b = malloc(2 * DIFF_RECORDS * sizeof(TraceFileRecord));
+    ENFORCE(a && b);
+    uint32_t a_count = 0, b_count = 0, edits = 0;
+    while (a_count < DIFF_RECORDS) {
+        const TraceFileRecord record = diff_random_record();
+        a[a_count++] = record;
+        if (gap && rng_next() % gap == 0) {
+            edits++;
+            switch (rng_next() % 3) {
+            case 0: break;
+            case 1: b[b_count++] = record; b[b_count++] = diff_random_record(); break;
+            case 2: b[b_count++] = diff_random_record(); edits++; break;
+            }
+        } else {
+            b[b_count++] = record;
+        }
+    }
+
+    DiffSource source_a = { a, a_count, 0 };
+    DiffSource source_b = { b, b_count, 0 };
+    DiffCheck check = { a, b, 0, 0 };
+    TraceDiff diff;
+    TraceDiffInit(&diff, diff_read, &source_a, &source_b, DIFF_WINDOW);
+    const uint64_t start = now_ns();
+    TraceDiffRun(&diff, diff_check_hunk, &check);
+    const uint64_t elapsed = now_ns() - start;
+    ENFORCE(a_count - check.a_next == b_count - check.b_next);
+    for (uint64_t i = check.a_next, j = check.b_next; i < a_count; i++, j++) ENFORCE(same_key(&a[i], &b[j]));
+    // the edits made are one script, the diff's can only be shorter
+    ENFORCE(diff.removed + diff.added <= edits);
+    printf("trace_diff gap=%u records=%u edits=%u found=%llu hunks=%llu %.2fns/record\n",
+        gap, a_count, edits, (unsigned long long)(diff.removed + diff.added), (unsigned long long)diff.hunks,
+        (double)elapsed / (a_count + b_count));
+    TraceDiffFree(&diff);
+    free(a);
+    free(b);
+}
+
+// --------------------------------------------------------------------------------
+// MsgFormat
+// --------------------------------------------------------------------------------
+// Every decoder runs on three input sets: uniform over the values it takes,
+// what a window really sends it, and every bit set, the longest path
+// through the flag formatters.  A sample is one pass over FORMAT_INPUTS
+// inputs, the percentiles are over samples.  The samples are taken in
+// rounds that go through every benchmark in turn, so a slow stretch of
+// the machine is spread over all of them instead of skewing one.
+#define FORMAT_INPUTS 1024
+#define FORMAT_ROUNDS 10
+#define FORMAT_WARMUP 20 // passes before every round's samples
+#define FORMAT_SAMPLES 2000
+// Compared to the baseline on the fastest sample, on a shared machine the
+// percentiles move by tens of percent from run to run while the minimum
+// stays within a few.  Slower by both this fraction and this many ns is a
+// regression.
+#define FORMAT_REGRESSION 0.10
+#define FORMAT_REGRESSION_NS 2.0
+
+typedef enum {
+    FORMAT_UNIFORM,
+    FORMAT_REALISTIC,
+    FORMAT_ADVERSARIAL,
+    FORMAT_INPUT_SETS,
+} FormatInputSet;
+
+static const char* const FORMAT_INPUT_SET_NAMES[FORMAT_INPUT_SETS] = { "uniform", "realistic", "adversarial" };
+
+typedef struct {
+    const char* name;
+    // calls the decoder on every input, the result keeps the calls from
+    // being optimized away
+    uint64_t (*run)(const uint64_t* inputs, uint32_t count);
+    uint64_t (*uniform)(void);
+    const uint64_t* realistic;
+    uint32_t realistic_count;
+} FormatBench;
+
+typedef struct {
+    const char* name;
+    FormatInputSet set;
+    double min, p50, p90, p99, mean; // ns per call
+} FormatResult;
+
+typedef struct {
+    const FormatBench* bench;
+    FormatInputSet set;
+    uint64_t inputs[FORMAT_INPUTS];
+    uint64_t samples[FORMAT_SAMPLES];
+} FormatRun;
+
+static uint64_t run_msg_name(const uint64_t* inputs, uint32_t count)
+{
+    uint64_t result = 0;
+    for (uint32_t i = 0; i < count; i++) result += (uintptr_t)GetMsgName((uint32_t)inputs[i]);
+    return result;
+}
+static uint64_t run_wnd_style(const uint64_t* inputs, uint32_t count)
+{
+    char buf[FORMAT_WND_STYLE_BUF_LEN];
+    uint64_t result = 0;
+    for (uint32_t i = 0; i < count; i++) result += FormatWndStyle(buf, (uint32_t)inputs[i]);
+    return result;
+}
+static uint64_t run_wnd_ex_style(const uint64_t* inputs, uint32_t count)
+{
+    char buf[FORMAT_WND_EX_STYLE_BUF_LEN];
+    uint64_t result = 0;
+    for (uint32_t i = 0; i < count; i++) result += FormatWndExStyle(buf, (uint32_t)inputs[i]);
+    return result;
+}
+static uint64_t run_swp_flags(const uint64_t* inputs, uint32_t count)
+{
+    char buf[FORMAT_SWP_FLAGS_BUF_LEN];
+    uint64_t result = 0;
+    for (uint32_t i = 0; i < count; i++) result += FormatSwpFlags(buf, (uint32_t)inputs[i]);
+    return result;
+}
+static uint64_t run_hit_str(const uint64_t* inputs, uint32_t count)
+{
+    uint64_t result = 0;
+    for (uint32_t i = 0; i < count; i++) result += (uintptr_t)GetHitStr((int64_t)inputs[i]);
+    return result;
+}
+static uint64_t run_ime_notify(const uint64_t* inputs, uint32_t count)
+{
+    uint64_t result = 0;
+    for (uint32_t i = 0; i < count; i++) result += (uintptr_t)ImeNotifyCodeStr(inputs[i]);
+    return result;
+}
+static uint64_t run_showwindow_status(const uint64_t* inputs, uint32_t count)
+{
+    uint64_t result = 0;
+    for (uint32_t i = 0; i < count; i++) result += (uintptr_t)ShowWindowStatusStr(inputs[i]);
+    return result;
+}
+
+// GetMsgName only names the ids below WM_USER
+static uint64_t uniform_msg(void) { return rng_next() % 0x400; }
+static uint64_t uniform_flags(void) { return rng_next(); }
+static uint64_t uniform_hit(void) { return (uint64_t)(int64_t)rng_range(-2, 22); }
+static uint64_t uniform_ime_notify(void) { return rng_next() % 16; }
+static uint64_t uniform_showwindow_status(void) { return rng_next() % 5; }
+
+// From a session of moving, resizing and typing into a window, repeated
+// about as often as they came up
+static const uint64_t REAL_MSGS[] = {
+    512, 512, 512, 512, 132, 132, 132, 32, 32, 32, 15, 20, 70, 71, 131, 3, 5, 275, 256, 257, 258, 134, 6, 28,
+    0xc0a1,
+};
+static const uint64_t REAL_WND_STYLES[] = {
+    0x00cf0000, 0x10cf0000, 0x16cf0000, 0x14cf0000, 0x90000000, 0x50000000, 0x56000000, 0x94c00000,
+};
+static const uint64_t REAL_WND_EX_STYLES[] = {
+    0x00000100, 0x00000000, 0x00040100, 0x00200000, 0x00000088, 0x00080088, 0x00000300, 0x00010101,
+};
+static const uint64_t REAL_SWP_FLAGS[] = {
+    0x0017, 0x0017, 0x0016, 0x0014, 0x0037, 0x0043, 0x0003, 0x1803, 0x1802, 0x8000, 0x0203, 0x0015,
+};
+static const uint64_t REAL_HITS[] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 10, 11, 12, 15, 17, 13, 20, 8, 9, 0, (uint64_t)(int64_t)-2,
+};
+static const uint64_t REAL_IME_NOTIFY[] = { 9, 9, 9, 0xb, 0xb, 8, 6, 6, 5, 3, 3, 3, 4, 0xa, 0xe };
+static const uint64_t REAL_SHOWWINDOW_STATUS[] = { 0, 0, 0, 0, 0, 0, 1, 3 };
+
+#define REAL(table) table, sizeof(table) / sizeof(table[0])
+
+static const FormatBench FORMAT_BENCHES[] = {
+    { "GetMsgName", run_msg_name, uniform_msg, REAL(REAL_MSGS) },
+    { "FormatWndStyle", run_wnd_style, uniform_flags, REAL(REAL_WND_STYLES) },
+    { "FormatWndExStyle", run_wnd_ex_style, uniform_flags, REAL(REAL_WND_EX_STYLES) },
+    { "FormatSwpFlags", run_swp_flags, uniform_flags, REAL(REAL_SWP_FLAGS) },
+    { "GetHitStr", run_hit_str, uniform_hit, REAL(REAL_HITS) },
+    { "ImeNotifyCodeStr", run_ime_notify, uniform_ime_notify, REAL(REAL_IME_NOTIFY) },
+    { "ShowWindowStatusStr", run_showwindow_status, uniform_showwindow_status, REAL(REAL_SHOWWINDOW_STATUS) },
+};
+#define FORMAT_BENCH_COUNT (sizeof(FORMAT_BENCHES) / sizeof(FORMAT_BENCHES[0]))
+
+static void format_inputs(FormatRun* run, const FormatBench* bench, FormatInputSet set)
+{
+    run->bench = bench;
+    run->set = set;
+    for (uint32_t i = 0; i < FORMAT_INPUTS; i++) {
+        switch (set) {
+        case FORMAT_UNIFORM: run->inputs[i] = bench->uniform(); break;
+        case FORMAT_REALISTIC: run->inputs[i] = bench->realistic[rng_next() % bench->realistic_count]; break;
+        case FORMAT_ADVERSARIAL: run->inputs[i] = UINT64_MAX; break;
+        case FORMAT_INPUT_SETS: abort();
+        }
+    }
+}
+
+static void format_round(FormatRun* run, uint32_t round)
+{
+    // the first passes fault in the code and data and train the branch
+    // predictor, the other benchmarks ran in between
+    for (uint32_t i = 0; i < FORMAT_WARMUP; i++) sink += run->bench->run(run->inputs, FORMAT_INPUTS);
+    const uint32_t per_round = FORMAT_SAMPLES / FORMAT_ROUNDS;
+    for (uint32_t s = round * per_round; s < (round + 1) * per_round; s++) {
+        const uint64_t start = now_ns();
+        sink += run->bench->run(run->inputs, FORMAT_INPUTS);
+        run->samples[s] = now_ns() - start;
+    }
+}
+
+static void format_summarize(FormatRun* run, FormatResult* result)
+{
+    uint64_t* samples = run->samples;
+    qsort(samples, FORMAT_SAMPLES, sizeof(uint64_t), compare_u64);
+    uint64_t total = 0;
+    for (uint32_t s = 0; s < FORMAT_SAMPLES; s++) total += samples[s];
+    result->name = run->bench->name;
+    result->set = run->set;
+    result->min = (double)samples[0] / FORMAT_INPUTS;
+    result->p50 = (double)samples[FORMAT_SAMPLES / 2] / FORMAT_INPUTS;
+    result->p90 = (double)samples[FORMAT_SAMPLES * 90 / 100] / FORMAT_INPUTS;
+    result->p99 = (double)samples[FORMAT_SAMPLES * 99 / 100] / FORMAT_INPUTS;
+    result->mean = (double)total / FORMAT_SAMPLES / FORMAT_INPUTS;
+}
+
+// One benchmark per line so a baseline can be read back with sscanf
+static bool format_write_json(const FormatResult* results, uint32_t count, const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (!file) return false;
+    fprintf(file, "{\n  \"unit\": \"ns/op\",\n  \"benchmarks\": [\n");
+    for (uint32_t i = 0; i < count; i++) {
+        const FormatResult* r = &results[i];
+        fprintf(file, "    {\"name\": \"%s\", \"inputs\": \"%s\", \"min\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"mean\": %.3f}%s\n",
+            r->name, FORMAT_INPUT_SET_NAMES[r->set], r->min, r->p50, r->p90, r->p99, r->mean, (i + 1 < count) ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    return fclose(file) == 0;
+}
+
+// Prints the change of every benchmark against the baseline, returns how
+// many regressed or -1 if the baseline can't be read
+static int32_t format_compare(const FormatResult* results, uint32_t count, const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (!file) return -1;
+    int32_t regressions = 0;
+    uint32_t matched = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        char name[64], inputs[16];
+        double min, p50;
+        if (sscanf(line, " {\"name\": \"%63[^\"]\", \"inputs\": \"%15[^\"]\", \"min\": %lf, \"p50\": %lf", name, inputs, &min, &p50) != 4) {
+            continue;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            const FormatResult* r = &results[i];
+            if (strcmp(r->name, name) || strcmp(FORMAT_INPUT_SET_NAMES[r->set], inputs)) continue;
+            const double change = r->min / min - 1;
+            const bool regressed = change > FORMAT_REGRESSION && r->min - min > FORMAT_REGRESSION_NS;
+            printf("format %-20s %-11s min %7.2fns -> %7.2fns %+6.1f%%  p50 %7.2fns -> %7.2fns%s\n",
+                name, inputs, min, r->min, change * 100, p50, r->p50, regressed ? " REGRESSION" : "");
+            regressions += regressed;
+            matched++;
+        }
+    }
+    fclose(file);
+    return matched ? regressions : -1;
+}
+
+// `bench format [--json path] [--baseline path]` runs only these, exits
+// with 1 if anything regressed against the baseline
+static int bench_format(const char* json_path, const char* baseline_path)
+{
+    static FormatRun runs[FORMAT_BENCH_COUNT * FORMAT_INPUT_SETS];
+    static FormatResult results[FORMAT_BENCH_COUNT * FORMAT_INPUT_SETS];
+    uint32_t count = 0;
+    for (uint32_t b = 0; b < FORMAT_BENCH_COUNT; b++) {
+        for (uint32_t set = 0; set < FORMAT_INPUT_SETS; set++) format_inputs(&runs[count++], &FORMAT_BENCHES[b], (FormatInputSet)set);
+    }
+    for (uint32_t round = 0; round < FORMAT_ROUNDS; round++) {
+        for (uint32_t i = 0; i < count; i++) format_round(&runs[i], round);
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        FormatResult* r = &results[i];
+        format_summarize(&runs[i], r);
+        printf("format %-20s %-11s min=%6.2fns p50=%6.2fns p90=%6.2fns p99=%6.2fns mean=%6.2fns\n",
+            r->name, FORMAT_INPUT_SET_NAMES[r->set], r->min, r->p50, r->p90, r->p99, r->mean);
+    }
+    if (json_path && !format_write_json(results, count, json_path)) {
+        fprintf(stderr, "writing %s failed\n", json_path);
+        return 2;
+    }
+    if (!baseline_path) return 0;
+    const int32_t regressions = format_compare(results, count, baseline_path);
+    if (regressions < 0) {
+        fprintf(stderr, "%s isn't a format benchmark baseline\n", baseline_path);
+        return 2;
+    }
+    return regressions ? 1 : 0;
+}
+
+// --------------------------------------------------------------------------------
+// PointerBatch
+// --------------------------------------------------------------------------------
+#define POINTER_EVENTS 10000000
+// a 1000Hz mouse against 60Hz frames
+#define POINTER_RATE_HZ 1000
+#define POINTER_FRAME_HZ 60
+
+typedef struct {
+    int32_t x, y;
+    uint16_t keys;
+} PointerEvent;
+
+static int64_t pointer_path;
+static int32_t pointer_last_x, pointer_last_y;
+
+// What WM_MOUSEMOVE did per event: decode every MK_* bit, then handle it
+__attribute__((noinline)) static void handle_pointer_event(int32_t x, int32_t y, uint16_t keys)
+{
+    const bool left = (keys & POINTER_BUTTON_LEFT) != 0;
+    const bool right = (keys & POINTER_BUTTON_RIGHT) != 0;
+    const bool middle = (keys & POINTER_BUTTON_MIDDLE) != 0;
+    const bool x1 = (keys & POINTER_BUTTON_X1) != 0;
+    const bool x2 = (keys & POINTER_BUTTON_X2) != 0;
+    const bool shift = (keys & POINTER_MOD_SHIFT) != 0;
+    const bool control = (keys & POINTER_MOD_CONTROL) != 0;
+    if (left || right || middle || x1 || x2 || shift || control) {
+        pointer_path += llabs((int64_t)x - pointer_last_x) + llabs((int64_t)y - pointer_last_y);
+    }
+    pointer_last_x = x;
+    pointer_last_y = y;
+}
+
+__attribute__((noinline)) static void handle_pointer_batch(const PointerBatch* batch)
+{
+    int32_t last_x = pointer_last_x, last_y = pointer_last_y;
+    int64_t path = 0;
+    for (uint32_t i = 0; i < batch->count; i++) {
+        if (batch->buttons[i] | batch->modifiers[i]) {
+            path += llabs((int64_t)batch->x[i] - last_x) + llabs((int64_t)batch->y[i] - last_y);
+        }
+        last_x = batch->x[i];
+        last_y = batch->y[i];
+    }
+    pointer_path += path;
+    pointer_last_x = last_x;
+    pointer_last_y = last_y;
+}
+
+static void bench_pointer(void)
+{
+    PointerEvent* events = malloc(POINTER_EVENTS * sizeof(PointerEvent));
+    ENFORCE(events);
+    int32_t x = 960, y = 540;
+    uint16_t keys = 0;
+    for (uint32_t i = 0; i < POINTER_EVENTS; i++) {
+        x += rng_range(-4, 5);
+        y += rng_range(-4, 5);
+        // a button goes down or up about every 200 events
+        if (rng_next() % 200 == 0) keys ^= POINTER_BUTTON_LEFT;
+        if (rng_next() % 500 == 0) keys ^= POINTER_MOD_SHIFT;
+        events[i].x = x;
+        events[i].y = y;
+        events[i].keys = keys;
+    }
+
+    pointer_path = 0;
+    pointer_last_x = pointer_last_y = 0;
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < POINTER_EVENTS; i++) {
+        handle_pointer_event(events[i].x, events[i].y, events[i].keys);
+    }
+    const uint64_t single_ns = now_ns() - start;
+    const int64_t single_path = pointer_path;
+
+    // a frame ends every POINTER_RATE_HZ / POINTER_FRAME_HZ events
+    PointerBatch batch;
+    PointerBatchInit(&batch);
+    pointer_path = 0;
+    pointer_last_x = pointer_last_y = 0;
+    uint64_t frames = 0;
+    uint32_t frame_phase = 0;
+    start = now_ns();
+    for (uint32_t i = 0; i < POINTER_EVENTS; i++) {
+        PointerBatchAdd(&batch, events[i].x, events[i].y,
+            events[i].keys & POINTER_BUTTONS, events[i].keys & POINTER_MODS, i);
+        frame_phase += POINTER_FRAME_HZ;
+        if (frame_phase >= POINTER_RATE_HZ) {
+            frame_phase -= POINTER_RATE_HZ;
+            frames++;
+            handle_pointer_batch(&batch);
+            PointerBatchClear(&batch);
+        }
+    }
+    handle_pointer_batch(&batch);
+    const uint64_t batched_ns = now_ns() - start;
+    ENFORCE(pointer_path == single_path);
+    ENFORCE(batch.state.x == x && batch.state.y == y);
+    PointerBatchFree(&batch);
+    free(events);
+
+    printf("pointer %uHz frames=%uHz per-event=%.2fns batched=%.2fns/event (%.1f events/frame, %.4f%% of a core at %uHz)\n",
+        POINTER_RATE_HZ, POINTER_FRAME_HZ, (double)single_ns / POINTER_EVENTS, (double)batched_ns / POINTER_EVENTS,
+        (double)POINTER_EVENTS / (frames + 1),
+        (double)batched_ns / POINTER_EVENTS * POINTER_RATE_HZ / 1e9 * 100, POINTER_RATE_HZ);
+}
+
+// --------------------------------------------------------------------------------
+// TextEditor
+// --------------------------------------------------------------------------------
+#define TEXT_OPS 100000
+
+// Single operations are short enough that a context switch shows up as the
+// max, the percentiles are what an edit usually costs
+typedef struct {
+    uint32_t ns[TEXT_OPS];
+    uint32_t count;
+} OpTimes;
+
+static void op_time(OpTimes* times, uint64_t start)
+{
+    times->ns[times->count++] = (uint32_t)(now_ns() - start);
+}
+
+static int compare_u32(const void* a, const void* b)
+{
+    const uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void print_op_times(const char* name, OpTimes* times)
+{
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < times->count; i++) total += times->ns[i];
+    qsort(times->ns, times->count, sizeof(uint32_t), compare_u32);
+    printf("text   %-8s mean=%6.0fns p50=%6uns p99=%6uns p99.9=%7.1fus max=%7.1fus\n",
+        name, (double)total / times->count, times->ns[times->count / 2], times->ns[times->count * 99 / 100],
+        times->ns[times->count * 999 / 1000] / 1e3, times->ns[times->count - 1] / 1e3);
+}
+
+static void bench_text(uint32_t megabytes)
+{
+    // lines of 0-120 characters, a document of about megabytes MB of UTF-16
+    const size_t length = (size_t)megabytes * 1024 * 1024 / sizeof(TextChar);
+    TextChar* text = malloc(length * sizeof(TextChar));
+    ENFORCE(text);
+    for (size_t i = 0, line_end = 0; i < length; i++) {
+        if (i == line_end) {
+            text[i] = '\n';
+            line_end = i + 1 + (size_t)rng_range(0, 121);
+        } else {
+            text[i] = (TextChar)('a' + rng_range(0, 26));
+        }
+    }
+
+    TextEditor editor;
+    uint64_t start = now_ns();
+    TextEditorInit(&editor, text, length);
+    const uint64_t load_ns = now_ns() - start;
+    free(text);
+    TextBuffer* buffer = &editor.buffer;
+    printf("text %uMB: %zu lines, load=%.1fms\n", megabytes, TextBufferLineCount(buffer), load_ns / 1e6);
+
+    static OpTimes insert, erase, typing, caret, line;
+    insert.count = erase.count = typing.count = caret.count = line.count = 0;
+    for (uint32_t i = 0; i < TEXT_OPS; i++) {
+        const TextChar c = (i % 16 == 0) ? '\n' : (TextChar)('a' + i % 26);
+        const size_t offset = (size_t)rng_next() * rng_next() % (TextBufferLength(buffer) + 1);
+        start = now_ns();
+        TextBufferInsert(buffer, offset, &c, 1);
+        op_time(&insert, start);
+    }
+    for (uint32_t i = 0; i < TEXT_OPS; i++) {
+        const size_t offset = (size_t)rng_next() * rng_next() % TextBufferLength(buffer);
+        start = now_ns();
+        TextBufferDelete(buffer, offset, (size_t)rng_range(1, 21));
+        op_time(&erase, start);
+    }
+    // a burst of typing in one place mostly grows one piece
+    TextEditorMove(&editor, TEXT_MOVE_DOCUMENT_START);
+    for (uint32_t i = 0; i < 1000; i++) TextEditorMove(&editor, TEXT_MOVE_DOWN);
+    for (uint32_t i = 0; i < TEXT_OPS; i++) {
+        const TextChar c = (i % 60 == 59) ? '\n' : (TextChar)('a' + i % 26);
+        start = now_ns();
+        TextEditorInsert(&editor, &c, 1);
+        op_time(&typing, start);
+    }
+    static const TextMove moves[] = {
+        TEXT_MOVE_LEFT, TEXT_MOVE_RIGHT, TEXT_MOVE_UP, TEXT_MOVE_DOWN, TEXT_MOVE_LINE_START, TEXT_MOVE_LINE_END,
+    };
+    for (uint32_t i = 0; i < TEXT_OPS; i++) {
+        const TextMove move = moves[rng_next() % 6];
+        start = now_ns();
+        TextEditorMove(&editor, move);
+        op_time(&caret, start);
+    }
+    const size_t line_count = TextBufferLineCount(buffer);
+    for (uint32_t i = 0; i < TEXT_OPS; i++) {
+        const size_t target = (size_t)rng_next() * rng_next() % line_count;
+        start = now_ns();
+        const size_t line_start = TextBufferLineStart(buffer, target);
+        sink += (int64_t)TextBufferLineOf(buffer, line_start);
+        op_time(&line, start);
+    }
+    print_op_times("insert", &insert);
+    print_op_times("delete", &erase);
+    print_op_times("typing", &typing);
+    print_op_times("caret", &caret);
+    print_op_times("line", &line);
+    TextEditorFree(&editor);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && !strcmp(argv[1], "trace")) return trace_publisher((argc > 2) ? (uint32_t)atoi(argv[2]) : 60);
+    if (argc > 1 && !strcmp(argv[1], "format")) {
+        const char* json_path = NULL;
+        const char* baseline_path = NULL;
+        for (int i = 2; i < argc; i += 2) {
+            if (i + 1 < argc && !strcmp(argv[i], "--json")) json_path = argv[i + 1];
+            else if (i + 1 < argc && !strcmp(argv[i], "--baseline")) baseline_path = argv[i + 1];
+            else {
+                fprintf(stderr, "usage: %s format [--json path] [--baseline path]\n", argv[0]);
+                return 2;
+            }
+        }
+        return bench_format(json_path, baseline_path);
+    }
+    // first, while the process is still cold
+    bench_startup();
+    bench_hit_test(10);
+    bench_hit_test(100);
+    bench_hit_test(1000);
+    check_region_ops();
+    bench_region(10);
+    bench_region(100);
+    bench_region(1000);
+    for (uint32_t producers = 1; producers <= MPSC_MAX_PRODUCERS; producers *= 2) {
+        bench_mpsc(producers);
+    }
+    for (uint32_t workers = 1; workers <= TASK_MAX_WORKERS; workers *= 2) {
+        bench_tasks(workers);
+    }
+    bench_timers();
+    bench_frame_pacer();
+    bench_msg_seq();
+    bench_msg_names();
+    bench_handlers();
+    bench_workloads();
+    bench_stats();
+    bench_trace_ring();
+    bench_trace_diff(0);
+    bench_trace_diff(1000);
+    bench_trace_diff(10);
+    bench_format(NULL, NULL);
+    bench_pointer();
+    bench_text(4);
+    bench_text(64);
+    // the speedup can only be linear up to the number of cores
+    printf("ui_threads cores=%ld\n", sysconf(_SC_NPROCESSORS_ONLN));
+    const double ui_baseline = bench_ui_threads(1, 0);
+    for (uint32_t threads = 2; threads <= UI_THREAD_MAX; threads *= 2) {
+        bench_ui_threads(threads, ui_baseline);
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+// Live view of a window's message trace: attaches to its TraceRing and
+// every interval shows the busiest messages and the slowest handlers.
+//
+//     monitor <ring name> [rows] [interval ms]
+//
+// The name is logged by the writer, basics-<pid>-<thread> for basics.exe.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "GetMsgName.h"
+#include "TraceRing.h"
+
+#ifdef _WIN32
+#include <windows.h>
+static void sleep_ms(unsigned ms) { Sleep(ms); }
+#else
+#include <time.h>
+static void sleep_ms(unsigned ms)
+{
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000 };
+    nanosleep(&ts, NULL);
+}
+#endif
+
+// everything from WM_NULL to the last registered message, beyond that is
+// one row
+#define MONITOR_MSGS 0x10001
+#define READ_BATCH 4096
+// the ring is drained this often between refreshes so a busy writer
+// doesn't lap it
+#define POLL_MS 10
+
+typedef struct {
+    uint32_t msg;
+    uint32_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+} MsgRow;
+
+static MsgRow rows[MONITOR_MSGS];
+// the rows with a count this interval, so only they are sorted and reset
+static uint32_t touched[MONITOR_MSGS];
+static uint32_t touched_count;
+static const MsgRow* sorted[MONITOR_MSGS];
+
+static const char* row_name(uint32_t msg, char* buf, size_t size)
+{
+    if (msg >= 0xc000 && msg <= 0xffff) {
+        // registered in the writer's process, the name isn't known here
+        snprintf(buf, size, "registered 0x%04x", msg);
+        return buf;
+    }
+    if (msg == MONITOR_MSGS - 1) return "(above 0xffff)";
+    return GetMsgName(msg);
+}
+
+static int by_count(const void* a, const void* b)
+{
+    const uint32_t x = (*(const MsgRow* const*)a)->count, y = (*(const MsgRow* const*)b)->count;
+    return (x < y) - (x > y);
+}
+
+static int by_total(const void* a, const void* b)
+{
+    const uint64_t x = (*(const MsgRow* const*)a)->total_ns, y = (*(const MsgRow* const*)b)->total_ns;
+    return (x < y) - (x > y);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <ring name> [rows] [interval ms]\n", argv[0]);
+        return 2;
+    }
+    const uint32_t top = (argc > 2) ? (uint32_t)atoi(argv[2]) : 15;
+    const unsigned interval_ms = (argc > 3) ? (unsigned)atoi(argv[3]) : 1000;
+    TraceRing ring;
+    if (!TraceRingAttach(&ring, argv[1])) {
+        fprintf(stderr, "no trace ring named %s\n", argv[1]);
+        return 1;
+    }
+    for (uint32_t i = 0; i < MONITOR_MSGS; i++) rows[i].msg = i;
+
+    static TraceRecord batch[READ_BATCH];
+    for (;;) {
+        const uint64_t dropped_before = ring.dropped;
+        uint64_t records = 0;
+        for (unsigned slept = 0; slept < interval_ms; slept += POLL_MS) {
+            sleep_ms(POLL_MS);
+            uint32_t count;
+            while ((count = TraceRingRead(&ring, batch, READ_BATCH)) > 0) {
+                for (uint32_t i = 0; i < count; i++) {
+                    const uint32_t msg = (batch[i].msg < MONITOR_MSGS - 1) ? batch[i].msg : MONITOR_MSGS - 1;
+                    MsgRow* row = &rows[msg];
+                    if (!row->count) touched[touched_count++] = msg;
+                    row->count++;
+                    row->total_ns += batch[i].duration_ns;
+                    if (batch[i].duration_ns > row->max_ns) row->max_ns = batch[i].duration_ns;
+                }
+                records += count;
+            }
+        }
+
+        for (uint32_t i = 0; i < touched_count; i++) sorted[i] = &rows[touched[i]];
+        const double seconds = interval_ms / 1000.0;
+        char buf[32];
+        // clear the terminal and draw from the top
+        printf("\x1b[H\x1b[2J%s (pid %u): %.0f msgs/s, %llu dropped\n\n", argv[1], ring.header->writer_pid,
+            records / seconds, (unsigned long long)(ring.dropped - dropped_before));
+        qsort(sorted, touched_count, sizeof(sorted[0]), by_count);
+        printf("%-28s %10s\n", "busiest", "msgs/s");
+        for (uint32_t i = 0; i < touched_count && i < top; i++) {
+            printf("%-28s %10.0f\n", row_name(sorted[i]->msg, buf, sizeof(buf)), sorted[i]->count / seconds);
+        }
+        qsort(sorted, touched_count, sizeof(sorted[0]), by_total);
+        printf("\n%-28s %8s %10s %10s\n", "slowest handlers", "busy", "mean us", "max us");
+        for (uint32_t i = 0; i < touched_count && i < top; i++) {
+            const MsgRow* row = sorted[i];
+            printf("%-28s %7.2f%% %10.2f %10.2f\n", row_name(row->msg, buf, sizeof(buf)),
+                row->total_ns / (interval_ms * 1e4), row->total_ns / 1e3 / row->count, row->max_ns / 1e3);
+        }
+        fflush(stdout);
+
+        for (uint32_t i = 0; i < touched_count; i++) {
+            MsgRow* row = &rows[touched[i]];
+            row->count = 0;
+            row->total_ns = 0;
+            row->max_ns = 0;
+        }
+        touched_count = 0;
+    }
+}
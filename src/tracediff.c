@@ -0,0 +1,123 @@
+// Compares two recorded message traces, for example from before and after
+// a change, and prints where the message sequences diverge.
+//
+//     tracediff <a> <b> [window]
+//
+// basics.exe records trace-<pid>-<thread>.bin with TRACE_FILE=1.  Records
+// match when the message and its detail are equal, each divergence is
+// printed with a few of the records before it:
+//
+//     @@ a 1203 -1, b 1203 +2 @@
+//       WM_NCCALCSIZE          wparam=0x1 lparam=0x...
+//     - WM_WINDOWPOSCHANGING   NOSIZE,NOMOVE wparam=0x0 lparam=0x...
+//     + WM_WINDOWPOSCHANGING   NOMOVE wparam=0x0 lparam=0x...
+//
+// The window is how many records of each trace are held in memory, 64K by
+// default.  Exits with 0 if the traces match, 1 if they don't and 2 on
+// errors, like diff.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "GetMsgName.h"
+#include "MsgFormat.h"
+#include "TraceDiff.h"
+#include "TraceFile.h"
+
+static const char* msg_name(uint32_t msg, char* buf, size_t size)
+{
+    if (msg >= 0xc000 && msg <= 0xffff) {
+        // registered in the recording process, the name isn't known here
+        snprintf(buf, size, "registered 0x%04x", msg);
+        return buf;
+    }
+    return GetMsgName(msg);
+}
+
+// The detail basics.c records for msg, decoded the way its log does.  See
+// trace_detail there.
+static void format_detail(const TraceFileRecord* record, char* out, size_t size)
+{
+    switch (record->msg) {
+    case 0x0001: // WM_CREATE
+    case 0x0081: { // WM_NCCREATE
+        char buf[FORMAT_WND_STYLE_BUF_LEN];
+        FormatWndStyle(buf, record->detail);
+        snprintf(out, size, "%s ", buf);
+        return;
+    }
+    case 0x0046: // WM_WINDOWPOSCHANGING
+    case 0x0047: { // WM_WINDOWPOSCHANGED
+        char buf[FORMAT_SWP_FLAGS_BUF_LEN];
+        FormatSwpFlags(buf, record->detail);
+        snprintf(out, size, "%s ", buf);
+        return;
+    }
+    case 0x0005: snprintf(out, size, "%s ", SizeTypeStr(record->detail)); return; // WM_SIZE
+    case 0x0018: snprintf(out, size, "%s ", ShowWindowStatusStr(record->detail)); return; // WM_SHOWWINDOW
+    case 0x0020: snprintf(out, size, "%s ", GetHitStr((int16_t)record->detail)); return; // WM_SETCURSOR
+    case 0x0282: snprintf(out, size, "%s ", ImeNotifyCodeStr(record->detail)); return; // WM_IME_NOTIFY
+    default:
+        if (record->detail) snprintf(out, size, "detail=0x%x ", record->detail);
+        else out[0] = 0;
+        return;
+    }
+}
+
+static void print_record(char prefix, const TraceFileRecord* record)
+{
+    char name[32];
+    // the longest detail is a FormatSwpFlags and a space
+    char detail[FORMAT_SWP_FLAGS_BUF_LEN + 1];
+    format_detail(record, detail, sizeof(detail));
+    printf("%c %-22s %swparam=0x%llx lparam=0x%llx\n", prefix, msg_name(record->msg, name, sizeof(name)),
+        detail, (unsigned long long)record->wparam, (unsigned long long)record->lparam);
+}
+
+static void print_hunk(void* context, const TraceDiffHunk* hunk)
+{
+    (void)context;
+    printf("@@ a %llu -%u, b %llu +%u @@\n",
+        (unsigned long long)hunk->a_index, hunk->a_count, (unsigned long long)hunk->b_index, hunk->b_count);
+    for (uint32_t i = 0; i < hunk->context_count; i++) print_record(' ', &hunk->context[i]);
+    for (uint32_t i = 0; i < hunk->a_count; i++) print_record('-', &hunk->a[i]);
+    for (uint32_t i = 0; i < hunk->b_count; i++) print_record('+', &hunk->b[i]);
+}
+
+static uint32_t read_trace(void* source, TraceFileRecord* out, uint32_t max)
+{
+    return TraceFileRead(source, out, max);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <a> <b> [window]\n", argv[0]);
+        return 2;
+    }
+    const uint32_t window = (argc > 3) ? (uint32_t)atoi(argv[3]) : (1 << 16);
+    if (window < 16) {
+        fprintf(stderr, "the window has to be at least 16 records\n");
+        return 2;
+    }
+    TraceFile a, b;
+    if (!TraceFileOpen(&a, argv[1])) {
+        fprintf(stderr, "%s isn't a trace\n", argv[1]);
+        return 2;
+    }
+    if (!TraceFileOpen(&b, argv[2])) {
+        fprintf(stderr, "%s isn't a trace\n", argv[2]);
+        return 2;
+    }
+
+    TraceDiff diff;
+    TraceDiffInit(&diff, read_trace, &a, &b, window);
+    TraceDiffRun(&diff, print_hunk, NULL);
+    printf("%llu records in a, %llu in b: %llu divergences, %llu records only in a, %llu only in b\n",
+        (unsigned long long)a.records, (unsigned long long)b.records, (unsigned long long)diff.hunks,
+        (unsigned long long)diff.removed, (unsigned long long)diff.added);
+    const int status = diff.hunks ? 1 : 0;
+    TraceDiffFree(&diff);
+    TraceFileClose(&a);
+    TraceFileClose(&b);
+    return status;
+}